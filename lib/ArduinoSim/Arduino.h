@@ -0,0 +1,140 @@
+#ifndef ARDUINO_SIM_H
+#define ARDUINO_SIM_H
+
+// Минимальная замена Arduino API для сборки [env:native]. Время
+// виртуальное: оно идёт только в simAdvance()/delayMicroseconds(), поэтому
+// прогон детерминирован и быстрее реального. Все изменения выходов
+// записываются в трассу для проверки в тестах.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+
+// Число имитируемых пинов (D0-D13, A0-A7)
+#define SIM_PIN_COUNT 22
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+unsigned long micros();
+unsigned long millis();
+void delayMicroseconds(unsigned int us);
+void delay(unsigned long ms);
+
+void noInterrupts();
+void interrupts();
+
+// Вывод как у Arduino Print
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    size_t write(const uint8_t* buffer, size_t size);
+
+    size_t print(const char* s);
+    size_t print(const __FlashStringHelper* s);
+    size_t print(char c);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(int n, int base = DEC) { return print((long)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(double n, int digits = 2);
+
+    size_t println();
+    template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+    template <typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+// Serial: входные байты подаёт тест через simSerialInput(),
+// всё выведенное прошивкой копится для simSerialOutput()
+class SimSerial : public Print {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    int available();
+    int availableForWrite();
+    int peek();
+    int read();
+    void flush() {}
+    size_t write(uint8_t c);
+    using Print::write;
+    operator bool() { return true; }
+};
+
+extern SimSerial Serial;
+
+// --- Управление имитацией из тестов ---
+
+// Изменение уровня пина
+struct SimEdge {
+    uint64_t time_ns;
+    uint8_t pin;
+    uint8_t level;
+};
+
+// Сброс времени, пинов, таймера, Serial и трассы
+void simReset();
+
+// Текущее виртуальное время
+uint64_t simNanos();
+
+// Продвинуть время, выполняя прерывания таймера, чей срок наступил
+void simAdvance(uint32_t us);
+
+// Прогон loop(): вызов fn, затем loop_us виртуального времени, пока не
+// пройдёт duration_us или until() не вернёт true
+void simRun(void (*fn)(), uint32_t duration_us, uint32_t loop_us = 10, bool (*until)() = NULL);
+
+// Таймер шагового движка: обработчик вызывается каждые period_ns
+void simTimerAttach(void (*isr)(), uint32_t period_ns);
+void simTimerEnable(bool enable);
+
+// Прерывание по изменению уровня входа (вызывается из simSetInput())
+void simPinChangeAttach(void (*isr)());
+
+// Внешний уровень на входе (концевик); -1 - вход не подключён
+void simSetInput(uint8_t pin, int level);
+
+// Текущий уровень пина
+int simPinLevel(uint8_t pin);
+
+// Трасса изменений выходов
+const std::vector<SimEdge>& simTrace();
+void simClearTrace();
+
+// Serial
+void simSerialInput(const char* text);
+void simSerialInput(const uint8_t* data, size_t size);
+std::string simSerialOutput();
+void simSerialClearOutput();
+// Свободное место в буфере передачи для availableForWrite(): каждый
+// выведенный байт его уменьшает (по умолчанию места всегда 63 байта)
+void simSerialSetTxSpace(int bytes);
+
+#endif
@@ -0,0 +1,246 @@
+#include "Arduino.h"
+#include <stdio.h>
+
+SimSerial Serial;
+
+static uint64_t sim_now_ns = 0;
+static uint8_t sim_mode[SIM_PIN_COUNT];
+static uint8_t sim_output[SIM_PIN_COUNT];
+static int sim_input[SIM_PIN_COUNT];
+static std::vector<SimEdge> sim_trace;
+
+static void (*sim_timer_isr)() = NULL;
+static uint32_t sim_timer_period_ns = 0;
+static bool sim_timer_enabled = false;
+static uint64_t sim_timer_next_ns = 0;
+static bool sim_irq_enabled = true;
+static bool sim_in_isr = false;
+static void (*sim_pin_change_isr)() = NULL;
+
+static std::string sim_rx;
+static size_t sim_rx_pos = 0;
+static std::string sim_tx;
+static int sim_tx_space = -1; // -1 - буфер передачи не заполняется
+
+void simReset() {
+    sim_now_ns = 0;
+    for (uint8_t i = 0; i < SIM_PIN_COUNT; i++) {
+        sim_mode[i] = INPUT;
+        sim_output[i] = LOW;
+        sim_input[i] = -1;
+    }
+    sim_trace.clear();
+    sim_timer_enabled = false;
+    sim_irq_enabled = true;
+    sim_in_isr = false;
+    sim_rx.clear();
+    sim_rx_pos = 0;
+    sim_tx.clear();
+    sim_tx_space = -1;
+}
+
+uint64_t simNanos() {
+    return sim_now_ns;
+}
+
+void simAdvance(uint32_t us) {
+    uint64_t end = sim_now_ns + (uint64_t)us * 1000;
+    while (sim_timer_enabled && sim_irq_enabled && sim_timer_isr != NULL && sim_timer_next_ns <= end) {
+        if (sim_timer_next_ns > sim_now_ns) sim_now_ns = sim_timer_next_ns;
+        sim_timer_next_ns += sim_timer_period_ns;
+        // Обработчик выполняется с запрещёнными прерываниями, как на МК
+        sim_in_isr = true;
+        sim_irq_enabled = false;
+        sim_timer_isr();
+        sim_irq_enabled = true;
+        sim_in_isr = false;
+    }
+    if (end > sim_now_ns) sim_now_ns = end;
+}
+
+void simRun(void (*fn)(), uint32_t duration_us, uint32_t loop_us, bool (*until)()) {
+    uint64_t end = sim_now_ns + (uint64_t)duration_us * 1000;
+    while (sim_now_ns < end) {
+        fn();
+        if (until != NULL && until()) break;
+        simAdvance(loop_us);
+    }
+}
+
+void simTimerAttach(void (*isr)(), uint32_t period_ns) {
+    sim_timer_isr = isr;
+    sim_timer_period_ns = period_ns;
+}
+
+void simTimerEnable(bool enable) {
+    if (enable && !sim_timer_enabled) {
+        // Как при сбросе счётчика: первое прерывание через период
+        sim_timer_next_ns = sim_now_ns + sim_timer_period_ns;
+    }
+    sim_timer_enabled = enable;
+}
+
+void simPinChangeAttach(void (*isr)()) {
+    sim_pin_change_isr = isr;
+}
+
+void simSetInput(uint8_t pin, int level) {
+    if (pin >= SIM_PIN_COUNT) return;
+    int before = digitalRead(pin);
+    sim_input[pin] = level;
+    // Прерывание по изменению уровня, как PCINT на AVR
+    if (digitalRead(pin) != before && sim_pin_change_isr != NULL && sim_irq_enabled && !sim_in_isr) {
+        sim_in_isr = true;
+        sim_pin_change_isr();
+        sim_in_isr = false;
+    }
+}
+
+int simPinLevel(uint8_t pin) {
+    return pin < SIM_PIN_COUNT ? digitalRead(pin) : LOW;
+}
+
+const std::vector<SimEdge>& simTrace() {
+    return sim_trace;
+}
+
+void simClearTrace() {
+    sim_trace.clear();
+}
+
+void simSerialInput(const char* text) {
+    sim_rx.append(text);
+}
+
+void simSerialInput(const uint8_t* data, size_t size) {
+    sim_rx.append((const char*)data, size);
+}
+
+std::string simSerialOutput() {
+    return sim_tx;
+}
+
+void simSerialClearOutput() {
+    sim_tx.clear();
+}
+
+void simSerialSetTxSpace(int bytes) {
+    sim_tx_space = bytes;
+}
+
+// --- Arduino API ---
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin < SIM_PIN_COUNT) sim_mode[pin] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin >= SIM_PIN_COUNT) return;
+    value = value ? HIGH : LOW;
+    if (sim_output[pin] != value) {
+        SimEdge edge = { sim_now_ns, pin, value };
+        sim_trace.push_back(edge);
+    }
+    sim_output[pin] = value;
+}
+
+int digitalRead(uint8_t pin) {
+    if (pin >= SIM_PIN_COUNT) return LOW;
+    if (sim_mode[pin] == OUTPUT) return sim_output[pin];
+    if (sim_input[pin] >= 0) return sim_input[pin] ? HIGH : LOW;
+    return sim_mode[pin] == INPUT_PULLUP ? HIGH : LOW;
+}
+
+unsigned long micros() {
+    return (unsigned long)(sim_now_ns / 1000);
+}
+
+unsigned long millis() {
+    return (unsigned long)(sim_now_ns / 1000000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    if (sim_in_isr || !sim_irq_enabled) {
+        sim_now_ns += (uint64_t)us * 1000;
+    } else {
+        simAdvance(us);
+    }
+}
+
+void delay(unsigned long ms) {
+    while (ms-- > 0) delayMicroseconds(1000);
+}
+
+void noInterrupts() {
+    if (!sim_in_isr) sim_irq_enabled = false;
+}
+
+void interrupts() {
+    if (!sim_in_isr) sim_irq_enabled = true;
+}
+
+// --- Print ---
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    for (size_t i = 0; i < size; i++) write(buffer[i]);
+    return size;
+}
+
+size_t Print::print(const char* s) {
+    return write((const uint8_t*)s, strlen(s));
+}
+
+size_t Print::print(const __FlashStringHelper* s) {
+    return print(reinterpret_cast<const char*>(s));
+}
+
+size_t Print::print(char c) {
+    return write((uint8_t)c);
+}
+
+size_t Print::print(long n, int base) {
+    char buf[34];
+    if (base == HEX) snprintf(buf, sizeof(buf), "%lX", (unsigned long)n);
+    else snprintf(buf, sizeof(buf), "%ld", n);
+    return print(buf);
+}
+
+size_t Print::print(unsigned long n, int base) {
+    char buf[34];
+    snprintf(buf, sizeof(buf), base == HEX ? "%lX" : "%lu", n);
+    return print(buf);
+}
+
+size_t Print::print(double n, int digits) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", digits, n);
+    return print(buf);
+}
+
+size_t Print::println() {
+    return print("\r\n");
+}
+
+// --- Serial ---
+
+int SimSerial::available() {
+    return (int)(sim_rx.size() - sim_rx_pos);
+}
+
+int SimSerial::availableForWrite() {
+    return sim_tx_space >= 0 ? sim_tx_space : 63;
+}
+
+int SimSerial::peek() {
+    return sim_rx_pos < sim_rx.size() ? (uint8_t)sim_rx[sim_rx_pos] : -1;
+}
+
+int SimSerial::read() {
+    return sim_rx_pos < sim_rx.size() ? (uint8_t)sim_rx[sim_rx_pos++] : -1;
+}
+
+size_t SimSerial::write(uint8_t c) {
+    sim_tx.push_back((char)c);
+    if (sim_tx_space > 0) sim_tx_space--;
+    return 1;
+}
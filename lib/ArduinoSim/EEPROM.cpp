@@ -0,0 +1,50 @@
+#include "EEPROM.h"
+#include <string.h>
+
+EEPROMClass EEPROM;
+
+static uint8_t sim_eeprom[SIM_EEPROM_SIZE];
+static uint32_t sim_eeprom_writes[SIM_EEPROM_SIZE];
+static bool sim_eeprom_ready = false;
+
+static void simEepromInit() {
+    if (!sim_eeprom_ready) {
+        simEepromErase();
+    }
+}
+
+void simEepromErase() {
+    memset(sim_eeprom, 0xFF, sizeof(sim_eeprom));
+    memset(sim_eeprom_writes, 0, sizeof(sim_eeprom_writes));
+    sim_eeprom_ready = true;
+}
+
+uint32_t simEepromWrites(int idx) {
+    simEepromInit();
+    if (idx >= 0) {
+        return idx < SIM_EEPROM_SIZE ? sim_eeprom_writes[idx] : 0;
+    }
+    uint32_t total = 0;
+    for (int i = 0; i < SIM_EEPROM_SIZE; i++) {
+        total += sim_eeprom_writes[i];
+    }
+    return total;
+}
+
+uint8_t EEPROMClass::read(int idx) {
+    simEepromInit();
+    return idx >= 0 && idx < SIM_EEPROM_SIZE ? sim_eeprom[idx] : 0xFF;
+}
+
+void EEPROMClass::write(int idx, uint8_t value) {
+    simEepromInit();
+    if (idx < 0 || idx >= SIM_EEPROM_SIZE) return;
+    sim_eeprom[idx] = value;
+    sim_eeprom_writes[idx]++;
+}
+
+void EEPROMClass::update(int idx, uint8_t value) {
+    if (read(idx) != value) {
+        write(idx, value);
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef ARDUINO_SIM_EEPROM_H
+#define ARDUINO_SIM_EEPROM_H
+
+// EEPROM для сборки [env:native]: 1 КБ, как у ATmega328P. Содержимое
+// переживает simReset() - так тест имитирует перезагрузку платы.
+
+#include <stdint.h>
+
+#define SIM_EEPROM_SIZE 1024
+#define E2END (SIM_EEPROM_SIZE - 1)
+
+class EEPROMClass {
+public:
+    uint8_t read(int idx);
+    void write(int idx, uint8_t value);
+    // Запись, только если значение отличается (как у Arduino)
+    void update(int idx, uint8_t value);
+    uint16_t length() { return SIM_EEPROM_SIZE; }
+};
+
+extern EEPROMClass EEPROM;
+
+// Стирание: все байты 0xFF, счётчики записей обнуляются
+void simEepromErase();
+
+// Число записей в байт idx с последнего стирания (-1 - всего)
+uint32_t simEepromWrites(int idx = -1);
+
+#endif
@@ -0,0 +1,148 @@
+#include "Arc.h"
+#include "Planner.h"
+#include "Log.h"
+
+uint8_t Arc::_axis[2];
+float Arc::_scale[2];
+float Arc::_center[2];
+float Arc::_offset[2];
+float Arc::_radius_vec[2];
+float Arc::_cos_t = 1;
+float Arc::_sin_t = 0;
+float Arc::_theta = 0;
+long Arc::_target[2];
+uint16_t Arc::_segments = 0;
+uint16_t Arc::_segment = 0;
+uint8_t Arc::_correction = 0;
+long Arc::_feed = 0;
+bool Arc::_feed_mm = false;
+
+bool Arc::radiusOffset(uint8_t axis0, uint8_t axis1, const float scale[2], const long target[2],
+    float radius, bool clockwise, float offset[2]) {
+    if (!Planner::isBusy()) {
+        Planner::syncPosition();
+    }
+    float x = (target[0] - Planner::getPosition(axis0)) / scale[0];
+    float y = (target[1] - Planner::getPosition(axis1)) / scale[1];
+    float chord = sqrt(x * x + y * y);
+    // Расстояние от середины хорды до центра, отнесённое к длине хорды
+    float h = 4.0 * radius * radius - x * x - y * y;
+    if (chord == 0 || h < 0) {
+        return false;
+    }
+    h = sqrt(h) / chord;
+    // Центр справа от хорды для G2 с малой дугой, слева - для G3
+    if (clockwise) h = -h;
+    if (radius < 0) h = -h;
+    offset[0] = 0.5 * (x - y * h);
+    offset[1] = 0.5 * (y + x * h);
+    return true;
+}
+
+bool Arc::start(uint8_t axis0, uint8_t axis1, const float scale[2], const long target[2],
+    const float offset[2], bool clockwise, long feed, bool feed_mm) {
+    if (!Planner::isBusy()) {
+        Planner::syncPosition();
+    }
+    _axis[0] = axis0;
+    _axis[1] = axis1;
+    for (uint8_t i = 0; i < 2; i++) {
+        _scale[i] = scale[i];
+        _target[i] = target[i];
+        _center[i] = Planner::getPosition(_axis[i]) / scale[i] + offset[i];
+        _offset[i] = -offset[i];
+        _radius_vec[i] = _offset[i];
+    }
+    float radius = sqrt(offset[0] * offset[0] + offset[1] * offset[1]);
+    if (radius == 0) {
+        return false;
+    }
+
+    // Угол дуги со знаком: G2 - по часовой (отрицательный), G3 - против.
+    // Совпадающие начало и конец дают полную окружность.
+    float end0 = target[0] / scale[0] - _center[0];
+    float end1 = target[1] / scale[1] - _center[1];
+    float travel = atan2(_offset[0] * end1 - _offset[1] * end0, _offset[0] * end0 + _offset[1] * end1);
+    if (clockwise) {
+        if (travel >= -1e-6) travel -= 2 * M_PI;
+    } else {
+        if (travel <= 1e-6) travel += 2 * M_PI;
+    }
+
+    // Число хорд по допуску: стрелка хорды не больше ARC_TOLERANCE_STEPS
+    float min_scale = scale[0] < scale[1] ? scale[0] : scale[1];
+    float tolerance = ARC_TOLERANCE_STEPS / min_scale;
+    float segments = 1;
+    if (radius > tolerance) {
+        segments = floor(fabs(0.5 * travel * radius) / sqrt(tolerance * (2 * radius - tolerance)));
+    }
+    if (segments < 1) segments = 1;
+    if (segments > 65535) segments = 65535;
+    _segments = (uint16_t)segments;
+    _segment = 0;
+    _correction = 0;
+    _theta = travel / _segments;
+
+    // Поворот на малый угол: cos ~ 1 - t^2/2, sin ~ t - t^3/6
+    _cos_t = 2.0 - _theta * _theta;
+    _sin_t = _theta * 0.16666667 * (_cos_t + 4.0);
+    _cos_t *= 0.5;
+
+    _feed = feed;
+    _feed_mm = feed_mm;
+    return queueSegment();
+}
+
+bool Arc::queueSegment() {
+    long target[STEP_ENGINE_MAX_AXES];
+    for (uint8_t i = 0; i < STEP_ENGINE_MAX_AXES; i++) {
+        target[i] = Planner::getPosition(i);
+    }
+
+    _segment++;
+    if (_segment >= _segments) {
+        // Последняя хорда - точно в конечную точку команды
+        target[_axis[0]] = _target[0];
+        target[_axis[1]] = _target[1];
+    } else {
+        if (_correction < ARC_CORRECTION_SEGMENTS) {
+            float r0 = _radius_vec[0] * _cos_t - _radius_vec[1] * _sin_t;
+            _radius_vec[1] = _radius_vec[0] * _sin_t + _radius_vec[1] * _cos_t;
+            _radius_vec[0] = r0;
+            _correction++;
+        } else {
+            float cos_i = cos(_segment * _theta);
+            float sin_i = sin(_segment * _theta);
+            _radius_vec[0] = _offset[0] * cos_i - _offset[1] * sin_i;
+            _radius_vec[1] = _offset[0] * sin_i + _offset[1] * cos_i;
+            _correction = 0;
+        }
+        for (uint8_t i = 0; i < 2; i++) {
+            float pos = (_center[i] + _radius_vec[i]) * _scale[i];
+            target[_axis[i]] = (long)(pos < 0 ? pos - 0.5 : pos + 0.5);
+        }
+    }
+
+    if (!Planner::line(target, _feed, _feed_mm)) {
+        _segments = 0;
+        _segment = 0;
+        return false;
+    }
+    return true;
+}
+
+void Arc::update() {
+    while (isBusy() && !Planner::isFull()) {
+        if (!queueSegment()) {
+            Log::event(LOG_ARC_ABORTED);
+        }
+    }
+}
+
+bool Arc::isBusy() {
+    return _segment < _segments;
+}
+
+void Arc::abort() {
+    _segment = _segments;
+}
@@ -0,0 +1,62 @@
+#ifndef ARC_H
+#define ARC_H
+
+#include <Arduino.h>
+#include "StepEngine.h"
+
+// Допустимое отклонение хорды сегмента от дуги в шагах
+#define ARC_TOLERANCE_STEPS 0.5
+
+// Через столько сегментов поворот радиус-вектора пересчитывается
+// точно (sin/cos), чтобы не накапливалась ошибка приближения
+#define ARC_CORRECTION_SEGMENTS 12
+
+// Дуга G2/G3 в плоскости двух осей движка. Дуга разбивается на хорды,
+// которые ставятся в очередь Planner по мере освобождения места.
+// Точки хорд получаются поворотом радиус-вектора на постоянный малый
+// угол (приближение sin/cos по Тейлору) - без sin/cos на каждую точку.
+// Геометрия считается в единицах координат команды; scale - шагов на
+// единицу для каждой оси (1 для координат в шагах).
+class Arc {
+public:
+    // Начало дуги из текущей позиции Planner в target (в шагах осей
+    // axis0/axis1), offset - центр относительно начала (I/J, в единицах).
+    // Первая хорда ставится в очередь сразу: очередь не должна быть полной.
+    // Возвращает false, если дугу построить нельзя или хорда не принята.
+    static bool start(uint8_t axis0, uint8_t axis1, const float scale[2], const long target[2],
+        const float offset[2], bool clockwise, long feed, bool feed_mm);
+
+    // Центр дуги по радиусу (форма R): при R < 0 строится дуга больше
+    // полуокружности. Возвращает false, если точка дальше 2R от начала.
+    static bool radiusOffset(uint8_t axis0, uint8_t axis1, const float scale[2], const long target[2],
+        float radius, bool clockwise, float offset[2]);
+
+    // Постановка следующих хорд в очередь - должно вызываться в loop()
+    static void update();
+
+    // Остались ли хорды, ещё не поставленные в очередь
+    static bool isBusy();
+
+    // Отказ от оставшихся хорд (сброс)
+    static void abort();
+
+private:
+    static bool queueSegment();
+
+    static uint8_t _axis[2];
+    static float _scale[2];
+    static float _center[2];    // Центр дуги (в единицах)
+    static float _offset[2];    // Начало дуги относительно центра
+    static float _radius_vec[2]; // Текущая точка относительно центра
+    static float _cos_t;        // Поворот на один сегмент
+    static float _sin_t;
+    static float _theta;        // Угол одного сегмента
+    static long _target[2];     // Конечная точка в шагах
+    static uint16_t _segments;  // Всего сегментов
+    static uint16_t _segment;   // Сегментов поставлено в очередь
+    static uint8_t _correction; // Сегментов с последней точной поправки
+    static long _feed;
+    static bool _feed_mm;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "AxisGroup.h"
+#include "Planner.h"
+
+AxisGroup::Axis AxisGroup::_axes[STEP_ENGINE_MAX_AXES];
+uint8_t AxisGroup::_count = 0;
+
+bool AxisGroup::add(char letter, StepperMotor* motor, uint8_t pin_endstop, long max_steps) {
+    if (_count >= STEP_ENGINE_MAX_AXES || find(letter) >= 0) {
+        return false;
+    }
+    Axis& axis = _axes[_count++];
+    axis.letter = letter;
+    axis.motor = motor;
+    axis.pin_endstop = pin_endstop;
+    axis.max_steps = max_steps;
+    return true;
+}
+
+void AxisGroup::begin() {
+    for (uint8_t i = 0; i < _count; i++) {
+        _axes[i].motor->begin();
+    }
+}
+
+void AxisGroup::update() {
+    for (uint8_t i = 0; i < _count; i++) {
+        _axes[i].motor->update();
+    }
+}
+
+uint8_t AxisGroup::count() {
+    return _count;
+}
+
+long AxisGroup::maxSteps(uint8_t index) {
+    return index < _count ? _axes[index].max_steps : 0;
+}
+
+void AxisGroup::setMaxSteps(uint8_t index, long max_steps) {
+    if (index < _count) {
+        _axes[index].max_steps = max_steps;
+    }
+}
+
+StepperMotor* AxisGroup::motor(uint8_t index) {
+    return index < _count ? _axes[index].motor : NULL;
+}
+
+char AxisGroup::letter(uint8_t index) {
+    return index < _count ? _axes[index].letter : 0;
+}
+
+int8_t AxisGroup::find(char letter) {
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_axes[i].letter == letter) return i;
+    }
+    return -1;
+}
+
+bool AxisGroup::drivesPin(uint8_t pin) {
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_axes[i].motor->drivesPin(pin)) return true;
+    }
+    return false;
+}
+
+uint8_t AxisGroup::mask(const GCodeCommand& cmd) {
+    uint8_t bits = 0;
+    for (uint8_t i = 0; i < _count; i++) {
+        if (cmd.has(_axes[i].letter)) bits |= 1 << i;
+    }
+    return bits;
+}
+
+bool AxisGroup::isBusy(uint8_t mask) {
+    for (uint8_t i = 0; i < _count; i++) {
+        if ((mask & (1 << i)) && _axes[i].motor->isBusy()) return true;
+    }
+    return false;
+}
+
+bool AxisGroup::isCalibrating() {
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_axes[i].motor->isCalibrating()) return true;
+    }
+    return false;
+}
+
+void AxisGroup::startCalibration(uint8_t mask) {
+    for (uint8_t i = 0; i < _count; i++) {
+        if (mask & (1 << i)) {
+            _axes[i].motor->startCalibration(_axes[i].pin_endstop, _axes[i].max_steps);
+        }
+    }
+}
+
+void AxisGroup::target(const GCodeCommand& cmd, bool units_mm, long target[STEP_ENGINE_MAX_AXES]) {
+    // Пустая очередь: позиция могла измениться калибровкой
+    if (!Planner::isBusy()) {
+        Planner::syncPosition();
+    }
+    for (uint8_t i = 0; i < STEP_ENGINE_MAX_AXES; i++) {
+        target[i] = Planner::getPosition(i);
+    }
+    for (uint8_t i = 0; i < _count; i++) {
+        Axis& axis = _axes[i];
+        if (!cmd.has(axis.letter) || axis.motor->getAxis() < 0) continue;
+        // Миллиметры переводятся в шаги от абсолютной координаты,
+        // поэтому ошибка округления не накапливается
+        target[axis.motor->getAxis()] = units_mm ? axis.motor->mmToSteps(cmd.value(axis.letter))
+            : cmd.integer(axis.letter);
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef AXIS_GROUP_H
+#define AXIS_GROUP_H
+
+#include <Arduino.h>
+#include "StepperMotor.h"
+#include "GCodeParser.h"
+
+// Все оси
+#define AXIS_GROUP_ALL 0xFF
+
+// Группа осей станка: таблица "буква G-code - двигатель - концевик".
+// Команды обходят таблицу вместо отдельных веток для каждой оси.
+// Шаги всех осей выдаёт один такт StepEngine: фронты осей на одном
+// порту пишутся одной записью, поэтому отдельного планирования шагов
+// по осям нет - здесь только обслуживание из loop().
+class AxisGroup {
+public:
+    // Добавление оси с буквой G-code, концевиком и длиной рейки в шагах.
+    // Номер оси в группе совпадает с номером в движке, если оси
+    // добавлены до begin() и других двигателей нет.
+    static bool add(char letter, StepperMotor* motor, uint8_t pin_endstop, long max_steps);
+
+    // Инициализация всех двигателей
+    static void begin();
+
+    // Обновление состояния всех двигателей - должно вызываться в loop()
+    static void update();
+
+    // Число осей, двигатель, буква и номер оси по букве (-1 - нет такой)
+    static uint8_t count();
+    static StepperMotor* motor(uint8_t index);
+    static char letter(uint8_t index);
+    static int8_t find(char letter);
+
+    // Длина рейки оси в шагах; новая длина действует со следующей
+    // калибровки
+    static long maxSteps(uint8_t index);
+    static void setMaxSteps(uint8_t index, long max_steps);
+
+    // Занят ли пин выходом драйвера одной из осей (ENA, DIR, PUL)
+    static bool drivesPin(uint8_t pin);
+
+    // Биты осей, буквы которых есть в команде
+    static uint8_t mask(const GCodeCommand& cmd);
+
+    // Заняты ли оси из маски
+    static bool isBusy(uint8_t mask = AXIS_GROUP_ALL);
+
+    // Выполняется ли калибровка хотя бы одной оси
+    static bool isCalibrating();
+
+    // Калибровка осей из маски (все одновременно)
+    static void startCalibration(uint8_t mask);
+
+    // Цель перемещения в шагах по номерам осей движка: оси из команды -
+    // в мм (units_mm) или шагах, остальные - конец очереди Planner
+    static void target(const GCodeCommand& cmd, bool units_mm, long target[STEP_ENGINE_MAX_AXES]);
+
+private:
+    struct Axis {
+        char letter;
+        StepperMotor* motor;
+        uint8_t pin_endstop;
+        long max_steps;
+    };
+
+    static Axis _axes[STEP_ENGINE_MAX_AXES];
+    static uint8_t _count;
+};
+
+#endif
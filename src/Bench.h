@@ -0,0 +1,46 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#if defined(BENCH) && defined(__AVR__)
+#include <avr/io.h>
+#endif
+
+// Метки для подсчёта тактов процессора под simavr (tools/bench).
+// Включаются флагом сборки -D BENCH (окружение [env:bench]); без него
+// методы пустые и исчезают при компиляции.
+//
+// Метка - одна команда out в регистр общего назначения, запись которого
+// отслеживает стенд:
+//   GPIOR0 - точка: стенд считает период между точками одного номера
+//   GPIOR1 - начало участка
+//   GPIOR2 - конец участка. Номер берётся при выходе, поэтому участок
+//            может закончиться с разными номерами (такт с шагом и без).
+// Участки вкладываются: такты прерывания внутри участка loop()
+// вычитаются из его длительности.
+enum BenchMark {
+    BENCH_LOOP = 1,        // Начало итерации loop() (точка)
+    BENCH_TICK,            // Такт StepEngine без шагов
+    BENCH_TICK_STEP,       // Такт StepEngine, выдавший шаги
+    BENCH_MOTOR_UPDATE,    // StepperMotor::update()
+    BENCH_PLANNER_UPDATE,  // Planner::update()
+    BENCH_PARSE_BYTE,      // GCodeParser::feed() внутри строки
+    BENCH_PARSE_LINE,      // GCodeParser::feed() на конце строки
+    BENCH_EXECUTE,         // Выполнение разобранной строки G-code
+    BENCH_MARK_COUNT
+};
+
+class Bench {
+public:
+#if defined(BENCH) && defined(__AVR__)
+    static inline void mark(uint8_t id) { GPIOR0 = id; }
+    static inline void begin(uint8_t id) { GPIOR1 = id; }
+    static inline void end(uint8_t id) { GPIOR2 = id; }
+#else
+    static inline void mark(uint8_t) {}
+    static inline void begin(uint8_t) {}
+    static inline void end(uint8_t) {}
+#endif
+};
+
+#endif
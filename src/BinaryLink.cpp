@@ -0,0 +1,181 @@
+#include "BinaryLink.h"
+#if defined(__AVR__)
+#include <util/crc16.h>
+#endif
+
+BinaryLink::BinaryLink(GCodeCommand& command) : _command(command) {
+    reset();
+}
+
+void BinaryLink::reset() {
+    _command.clear();
+    _length = 0;
+    _status = BINARY_OK;
+    _expected_seq = 0;
+    _reply_seq = 0;
+    _accepted = false;
+}
+
+uint16_t BinaryLink::crcUpdate(uint16_t crc, uint8_t data) {
+#if defined(__AVR__)
+    return _crc_xmodem_update(crc, data);
+#else
+    crc ^= (uint16_t)data << 8;
+    for (uint8_t i = 0; i < 8; i++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+#endif
+}
+
+uint8_t BinaryLink::status() {
+    return _status;
+}
+
+uint8_t BinaryLink::type() {
+    return _frame[2];
+}
+
+const GCodeCommand& BinaryLink::command() {
+    return _command;
+}
+
+const BinarySegment& BinaryLink::segment() {
+    return _segment;
+}
+
+uint16_t BinaryLink::payloadWord(uint8_t offset) {
+    const uint8_t* p = &_frame[3 + offset];
+    return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+int32_t BinaryLink::payloadLong(uint8_t offset) {
+    const uint8_t* p = &_frame[3 + offset];
+    return (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+        ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+bool BinaryLink::feed(uint8_t c) {
+    // Оборванный кадр: хост уже не досылает его байты
+    uint16_t now = (uint16_t)millis();
+    if (_length > 0 && (uint16_t)(now - _byte_ms) > BINARY_FRAME_TIMEOUT_MS) {
+        _length = 0;
+    }
+    _byte_ms = now;
+    // Байты вне кадра пропускаются до синхробайта
+    if (_length == 0 && c != BINARY_SYNC_HOST) {
+        return false;
+    }
+    _frame[_length++] = c;
+    if (_length < BINARY_FRAME_SIZE) {
+        return false;
+    }
+    _length = 0;
+    decode();
+    if (_status == BINARY_ERROR_CRC) {
+        resync();
+    }
+    return true;
+}
+
+// Начало следующего кадра внутри отвергнутого: байты с ближайшего
+// синхробайта становятся началом приёма
+void BinaryLink::resync() {
+    for (uint8_t start = 1; start < BINARY_FRAME_SIZE; start++) {
+        if (_frame[start] != BINARY_SYNC_HOST) continue;
+        _length = BINARY_FRAME_SIZE - start;
+        memmove(_frame, &_frame[start], _length);
+        return;
+    }
+}
+
+// Проверка кадра и перевод в команду G-code или отрезок
+void BinaryLink::decode() {
+    _command.clear();
+
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 1; i < BINARY_FRAME_SIZE - 2; i++) {
+        crc = crcUpdate(crc, _frame[i]);
+    }
+    uint16_t received = _frame[BINARY_FRAME_SIZE - 2] | ((uint16_t)_frame[BINARY_FRAME_SIZE - 1] << 8);
+    uint8_t seq = _frame[1];
+    if (crc != received) {
+        _status = BINARY_ERROR_CRC;
+        _reply_seq = _expected_seq;
+        return;
+    }
+    if (_accepted && seq == (uint8_t)(_expected_seq - 1)) {
+        _status = BINARY_DUPLICATE;
+        _reply_seq = seq;
+        return;
+    }
+    if (seq != _expected_seq) {
+        _status = BINARY_ERROR_SEQUENCE;
+        _reply_seq = _expected_seq;
+        return;
+    }
+    _status = BINARY_OK;
+    _reply_seq = seq;
+    _expected_seq++;
+    _accepted = true;
+
+    _command.clear();
+    uint8_t flags = _frame[3];
+    if (type() == BINARY_MOVE) {
+        _command.set('G', 1 * GCODE_SCALE);
+        const char letters[3] = { 'X', 'Y', 'F' };
+        for (uint8_t i = 0; i < 3; i++) {
+            if (flags & (1 << i)) {
+                _command.set(letters[i], payloadLong(1 + i * 4));
+            }
+        }
+    } else if (type() == BINARY_HOME) {
+        _command.set('G', 28 * GCODE_SCALE);
+        if (flags & 0x01) {
+            _command.set('X', 0);
+        }
+        if (flags & 0x02) {
+            _command.set('Y', 0);
+        }
+    } else if (type() == BINARY_SEGMENT) {
+        _segment.flags = flags;
+        _segment.x = (int16_t)payloadWord(1);
+        _segment.y = (int16_t)payloadWord(3);
+        _segment.start_hz = payloadWord(5);
+        _segment.end_hz = payloadWord(7);
+        _segment.accel = (uint32_t)payloadLong(9);
+    }
+}
+
+void BinaryLink::sendReply(uint8_t type, const uint8_t* data, uint8_t size) {
+    uint8_t frame[BINARY_STATUS_SIZE + 5];
+    frame[0] = BINARY_SYNC_DEVICE;
+    frame[1] = _reply_seq;
+    frame[2] = type;
+    uint16_t crc = 0xFFFF;
+    crc = crcUpdate(crc, frame[1]);
+    crc = crcUpdate(crc, frame[2]);
+    for (uint8_t i = 0; i < size; i++) {
+        frame[3 + i] = data[i];
+        crc = crcUpdate(crc, data[i]);
+    }
+    frame[3 + size] = crc & 0xFF;
+    frame[4 + size] = crc >> 8;
+    Serial.write(frame, size + 5);
+}
+
+void BinaryLink::sendAck(uint8_t code) {
+    sendReply(BINARY_ACK, &code, 1);
+}
+
+void BinaryLink::sendStatus(long x, long y, uint8_t state, uint8_t queue_free, uint8_t rx_free) {
+    uint8_t data[BINARY_STATUS_SIZE];
+    for (uint8_t i = 0; i < 4; i++) {
+        data[i] = (uint32_t)x >> (i * 8);
+        data[4 + i] = (uint32_t)y >> (i * 8);
+    }
+    data[8] = state;
+    data[9] = queue_free;
+    data[10] = rx_free;
+    sendReply(BINARY_STATUS, data, BINARY_STATUS_SIZE);
+}
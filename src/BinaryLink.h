@@ -0,0 +1,142 @@
+#ifndef BINARY_LINK_H
+#define BINARY_LINK_H
+
+#include <Arduino.h>
+#include "GCodeParser.h"
+
+// Двоичный протокол - альтернатива текстовому G-code (включается M870).
+//
+// Кадр хоста, всегда BINARY_FRAME_SIZE байт:
+//   0xA5 | seq | тип | данные (13 байт) | CRC16 (младший байт первым)
+// Ответ контроллера:
+//   0x5A | seq | тип | данные (1 байт для ACK, 11 для STATUS) | CRC16
+// CRC16-CCITT (полином 0x1021, начальное значение 0xFFFF) считается
+// по seq, типу и данным. Числа - int32, младший байт первым.
+//
+// Номер seq у каждого следующего кадра на 1 больше. ACK несёт номер
+// подтверждаемого кадра, а при ошибке CRC или номера - номер кадра,
+// с которого хост должен повторить передачу. Повтор уже принятого
+// кадра подтверждается без повторного выполнения.
+//
+// Синхронизация: кадр, между байтами которого прошло больше
+// BINARY_FRAME_TIMEOUT_MS, отбрасывается без ответа. После кадра с
+// неверной CRC начало следующего ищется среди его же байтов: с
+// потерянным байтом кадр захватывает начало следующего, и тот не
+// пропадает вслед за испорченным.
+
+#define BINARY_SYNC_HOST 0xA5
+#define BINARY_SYNC_DEVICE 0x5A
+#define BINARY_PAYLOAD_SIZE 13
+#define BINARY_FRAME_SIZE (BINARY_PAYLOAD_SIZE + 5)
+#define BINARY_STATUS_SIZE 11
+
+// Пауза внутри кадра, после которой принятые байты отбрасываются. Кадр
+// передаётся за 1,6 мс (115200 бод); запас - на долгие итерации loop().
+#define BINARY_FRAME_TIMEOUT_MS 50
+
+// Оси в полях кадров по порядку: первое поле - X, второе - Y.
+// Ось группы с другой буквой в кадры не попадает.
+#define BINARY_AXES "XY"
+#define BINARY_AXIS_COUNT 2
+
+// Типы кадров хоста
+enum BinaryPacketType {
+    // Перемещение G1. Данные: флаги (бит 0 - X, 1 - Y, 2 - F),
+    // X, Y, F в единицах 1/GCODE_SCALE текущих единиц (G21/G22)
+    BINARY_MOVE = 1,
+    // Калибровка G28. Данные: флаги (бит 0 - X, 1 - Y)
+    BINARY_HOME = 2,
+    // Запрос состояния, ответ BINARY_STATUS
+    BINARY_QUERY = 3,
+    // Возврат в текстовый режим после подтверждения
+    BINARY_TEXT_MODE = 4,
+    // Отрезок, рассчитанный на ПК (tools/segc). Данные: флаги (бит 0 -
+    // последний отрезок программы), X, Y (int16, шаги), скорости в начале
+    // и в конце (uint16, Гц), ускорение (uint32, формат движка)
+    BINARY_SEGMENT = 5
+};
+
+// Флаги кадра BINARY_SEGMENT
+#define BINARY_SEGMENT_LAST 0x01
+
+// Данные кадра BINARY_SEGMENT
+struct BinarySegment {
+    int16_t x;
+    int16_t y;
+    uint16_t start_hz;
+    uint16_t end_hz;
+    uint32_t accel;
+    uint8_t flags;
+};
+
+// Типы ответов контроллера
+enum BinaryReplyType {
+    // Данные: 0 или код ошибки, как в текстовом "error:N"
+    BINARY_ACK = 0x80,
+    // Данные: X, Y (int32, шаги), флаги (BinaryState), свободно блоков
+    // очереди, свободно байт приёмного буфера
+    BINARY_STATUS = 0x81
+};
+
+// Флаги состояния в ответе BINARY_STATUS
+enum BinaryState {
+    BINARY_STATE_MOVING = 0x01,
+    BINARY_STATE_X_CALIBRATED = 0x02,
+    BINARY_STATE_Y_CALIBRATED = 0x04,
+    BINARY_STATE_CALIBRATING = 0x08
+};
+
+// Результат приёма кадра. Коды ошибок продолжают коды "error:N".
+enum BinaryStatus {
+    BINARY_OK = 0,
+    BINARY_ERROR_CRC = 22,      // Кадр повреждён
+    BINARY_ERROR_SEQUENCE = 23, // Пропущен кадр
+    BINARY_DUPLICATE = 255      // Повтор уже принятого кадра
+};
+
+// Приём кадров по одному байту и отправка ответов. Кадры перемещения
+// переводятся в GCodeCommand и выполняются тем же кодом, что и текст;
+// команда общая с GCodeParser.
+class BinaryLink {
+public:
+    explicit BinaryLink(GCodeCommand& command);
+
+    // Обработка одного байта. Возвращает true, когда кадр принят
+    // и результат можно взять через type()/command()/status().
+    bool feed(uint8_t c);
+
+    // Результат последнего принятого кадра
+    uint8_t status();
+    uint8_t type();
+    const GCodeCommand& command();
+    const BinarySegment& segment();
+
+    // Ответы на последний принятый кадр
+    void sendAck(uint8_t code);
+    void sendStatus(long x, long y, uint8_t state, uint8_t queue_free, uint8_t rx_free);
+
+    // Сброс приёма и нумерации кадров (при входе в двоичный режим)
+    void reset();
+
+    // CRC16-CCITT одного байта
+    static uint16_t crcUpdate(uint16_t crc, uint8_t data);
+
+private:
+    void decode();
+    void resync();
+    void sendReply(uint8_t type, const uint8_t* data, uint8_t size);
+    int32_t payloadLong(uint8_t offset);
+    uint16_t payloadWord(uint8_t offset);
+
+    GCodeCommand& _command;
+    BinarySegment _segment;
+    uint8_t _frame[BINARY_FRAME_SIZE];
+    uint8_t _length;       // Принято байт текущего кадра (0 - ждём 0xA5)
+    uint16_t _byte_ms;     // Время последнего байта (младшие биты millis())
+    uint8_t _status;
+    uint8_t _expected_seq; // Номер следующего нового кадра
+    uint8_t _reply_seq;    // Номер для ответа на последний кадр
+    bool _accepted;        // Был принят хотя бы один кадр
+};
+
+#endif
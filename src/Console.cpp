@@ -0,0 +1,24 @@
+#include "Console.h"
+#include "Log.h"
+
+ConsoleOutput Console;
+
+ConsoleOutput::ConsoleOutput() : _muted(false) {
+}
+
+size_t ConsoleOutput::write(uint8_t c) {
+    if (_muted) {
+        return 1;
+    }
+    // Начатое сообщение очереди дописывается раньше, чтобы строки не смешались
+    Log::finishMessage();
+    return Serial.write(c);
+}
+
+void ConsoleOutput::setMuted(bool muted) {
+    _muted = muted;
+}
+
+bool ConsoleOutput::isMuted() {
+    return _muted;
+}
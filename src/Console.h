@@ -0,0 +1,24 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <Arduino.h>
+
+// Текстовые сообщения прошивки. Пишут в Serial, пока вывод не отключён:
+// в двоичном режиме текст смешался бы с кадрами протокола.
+class ConsoleOutput : public Print {
+public:
+    ConsoleOutput();
+
+    size_t write(uint8_t c);
+
+    // Отключение и включение текстового вывода
+    void setMuted(bool muted);
+    bool isMuted();
+
+private:
+    bool _muted;
+};
+
+extern ConsoleOutput Console;
+
+#endif
@@ -0,0 +1,56 @@
+#include "Endstops.h"
+#include "StepperMotor.h"
+#include "Probe.h"
+
+StepperMotor* Endstops::_motors[ENDSTOPS_MAX];
+uint8_t Endstops::_count = 0;
+
+void Endstops::attach(StepperMotor* motor, uint8_t pin) {
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_motors[i] == motor) return;
+    }
+    if (_count >= ENDSTOPS_MAX) {
+        return;
+    }
+    _motors[_count++] = motor;
+    watch(pin);
+}
+
+void Endstops::watch(uint8_t pin) {
+#if defined(__AVR__)
+    noInterrupts();
+    *digitalPinToPCMSK(pin) |= 1 << digitalPinToPCMSKbit(pin);
+    *digitalPinToPCICR(pin) |= 1 << digitalPinToPCICRbit(pin);
+    interrupts();
+#elif defined(ARDUINO_SIM)
+    (void)pin;
+    simPinChangeAttach(handleChange);
+#else
+    (void)pin;
+#endif
+}
+
+// Прерывание общее на порт: проверяем все взведённые концевики и щуп
+void Endstops::handleChange() {
+    for (uint8_t i = 0; i < _count; i++) {
+        StepperMotor* motor = _motors[i];
+        if (motor->_endstop_armed && motor->readEndstop()) {
+            motor->latchEndstop();
+        }
+    }
+    Probe::handleChange();
+}
+
+#if defined(__AVR__)
+ISR(PCINT0_vect) {
+    Endstops::handleChange();
+}
+
+ISR(PCINT1_vect) {
+    Endstops::handleChange();
+}
+
+ISR(PCINT2_vect) {
+    Endstops::handleChange();
+}
+#endif
@@ -0,0 +1,32 @@
+#ifndef ENDSTOPS_H
+#define ENDSTOPS_H
+
+#include <Arduino.h>
+
+class StepperMotor;
+
+// Максимальное число концевиков
+#define ENDSTOPS_MAX 4
+
+// Концевики на прерываниях по изменению пина (PCINT). При срабатывании
+// взведённого концевика шаги двигателя останавливаются прямо в
+// прерывании, а позиция запоминается - перебег не зависит от loop().
+// Прерывания PCINT0..2 заняты этим модулем целиком; щуп (Probe)
+// обслуживается тем же прерыванием.
+class Endstops {
+public:
+    // Регистрация концевика двигателя и включение прерывания его пина
+    static void attach(StepperMotor* motor, uint8_t pin);
+
+    // Включение прерывания по изменению пина без двигателя (щуп)
+    static void watch(uint8_t pin);
+
+    // Обработка изменения пинов - вызывается из прерывания
+    static void handleChange();
+
+private:
+    static StepperMotor* _motors[ENDSTOPS_MAX];
+    static uint8_t _count;
+};
+
+#endif
@@ -0,0 +1,167 @@
+#include "GCodeParser.h"
+
+GCodeParser::GCodeParser(GCodeCommand& command) : _command(command) {
+    reset();
+}
+
+void GCodeParser::reset() {
+    _command.clear();
+    _length = 0;
+    _line[0] = '\0';
+    _state = STATE_WORD;
+    _status = GCODE_OK;
+    _letter = 0;
+}
+
+const GCodeCommand& GCodeParser::command() {
+    return _command;
+}
+
+uint8_t GCodeParser::status() {
+    return _status;
+}
+
+const char* GCodeParser::line() {
+    return _line;
+}
+
+void GCodeParser::fail(uint8_t status) {
+    if (_status == GCODE_OK) {
+        _status = status;
+    }
+    _state = STATE_SKIP;
+}
+
+// Слово завершено: сохраняем значение. Буква без числа ("G28 X")
+// означает слово со значением 0.
+void GCodeParser::finishWord() {
+    if (_letter == 0) {
+        return;
+    }
+    if ((_state == STATE_INTEGER || _state == STATE_FRACTION) && !_has_digits) {
+        fail(GCODE_ERROR_NUMBER);
+        _letter = 0;
+        return;
+    }
+    int32_t value = _integer * GCODE_SCALE + _fraction;
+    if (!_command.set(_letter, _negative ? -value : value)) {
+        fail(GCODE_ERROR_LENGTH);
+    }
+    _letter = 0;
+}
+
+bool GCodeParser::feed(char c) {
+    if (c == '\n' || c == '\r') {
+        // Пустые строки (в том числе между \r и \n) не считаются командами
+        if (_length == 0) {
+            return false;
+        }
+        if (_state == STATE_SIGN || _state == STATE_INTEGER || _state == STATE_FRACTION) {
+            finishWord();
+        }
+        _line[_length] = '\0';
+        _length = 0;
+        _state = STATE_WORD;
+        _letter = 0;
+        if (_status != GCODE_OK) {
+            _command.clear();
+        }
+        return true;
+    }
+
+    // Первый байт новой строки - очищаем результат прошлой
+    if (_length == 0) {
+        _command.clear();
+        _status = GCODE_OK;
+    }
+
+    if (_length < GCODE_LINE_SIZE) {
+        _line[_length++] = c;
+    } else {
+        fail(GCODE_ERROR_LENGTH);
+        return false;
+    }
+    if ((uint8_t)c == GCODE_LINE_LOST) {
+        fail(GCODE_ERROR_LENGTH);
+        return false;
+    }
+
+    switch (_state) {
+        case STATE_COMMENT:
+            if (c == ')') _state = STATE_WORD;
+            return false;
+
+        case STATE_SKIP:
+            return false;
+
+        case STATE_SIGN:
+            if (c == '-' || c == '+') {
+                _negative = c == '-';
+                _state = STATE_INTEGER;
+                return false;
+            }
+            if (isdigit(c) || c == '.') {
+                _state = STATE_INTEGER;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    if (_state == STATE_INTEGER || _state == STATE_FRACTION) {
+        if (isdigit(c)) {
+            _has_digits = true;
+            if (_state == STATE_INTEGER) {
+                _integer = _integer * 10 + (c - '0');
+                if (_integer > GCODE_MAX_INTEGER) fail(GCODE_ERROR_OVERFLOW);
+            } else if (_frac_scale > 0) {
+                _fraction += (c - '0') * _frac_scale;
+                _frac_scale /= 10;
+            }
+            return false;
+        }
+        if (c == '.' && _state == STATE_INTEGER) {
+            _state = STATE_FRACTION;
+            return false;
+        }
+        if (c == '.' || c == '-' || c == '+') {
+            fail(GCODE_ERROR_NUMBER);
+            return false;
+        }
+    }
+
+    // Конец числа или слова без числа
+    if (_state != STATE_WORD) {
+        finishWord();
+        if (_state == STATE_SKIP) return false;
+        _state = STATE_WORD;
+    }
+
+    if (c == ' ' || c == '\t') {
+        return false;
+    }
+    if (c == '(') {
+        _state = STATE_COMMENT;
+        return false;
+    }
+    if (c == ';') {
+        _state = STATE_SKIP;
+        return false;
+    }
+    if (c >= 'a' && c <= 'z') {
+        c -= 'a' - 'A';
+    }
+    if ((c >= 'A' && c <= 'Z') || c == '$' || c == '=') {
+        _letter = c;
+        _negative = false;
+        _has_digits = false;
+        _integer = 0;
+        _fraction = 0;
+        _frac_scale = GCODE_SCALE / 10;
+        _state = STATE_SIGN;
+        return false;
+    }
+    fail(GCODE_ERROR_CHAR);
+    return false;
+}
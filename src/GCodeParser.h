@@ -0,0 +1,154 @@
+#ifndef GCODE_PARSER_H
+#define GCODE_PARSER_H
+
+#include <Arduino.h>
+
+// Максимальная длина строки G-code без перевода строки
+#define GCODE_LINE_SIZE 64
+
+// Байт на месте потерянного конца строки (переполнение приёма): строка
+// завершается ошибкой GCODE_ERROR_LENGTH, а не выполняется обрезанной
+#define GCODE_LINE_LOST 0x7F
+
+// Числа хранятся в фиксированной точке с тремя знаками после запятой:
+// X10.5 -> 10500
+#define GCODE_SCALE 1000L
+
+// Предел целой части числа, чтобы значение помещалось в int32_t
+#define GCODE_MAX_INTEGER 2000000L
+
+// Кроме букв A-Z, строка может содержать слова '$' (номер настройки)
+// и '=' (её значение): "$110=6400" - два слова, как "G1 X100"
+
+// Разных слов в одной строке: самой длинной команде прошивки -
+// "M882 L X Y I J" или "G2 X Y I J F" - нужно 6. Строка с большим числом
+// слов - ошибка GCODE_ERROR_LENGTH. Каждое место - 5 байт ОЗУ в каждой
+// GCodeCommand (в прошивке их две: принятая строка и строка программы).
+#ifndef GCODE_MAX_WORDS
+#define GCODE_MAX_WORDS 8
+#endif
+
+// Результат разбора строки
+enum GCodeStatus {
+    GCODE_OK,
+    GCODE_ERROR_CHAR,     // Недопустимый символ
+    GCODE_ERROR_NUMBER,   // Ошибка в записи числа
+    GCODE_ERROR_OVERFLOW, // Число вне диапазона
+    GCODE_ERROR_LENGTH    // Строка длиннее GCODE_LINE_SIZE или слов больше GCODE_MAX_WORDS
+};
+
+// Разобранная строка: набор слов "буква-число" в любом порядке. Значения
+// лежат подряд в порядке появления слов, а не по месту на каждую букву
+// из 28: 45 байт вместо 116.
+struct GCodeCommand {
+    uint32_t words;     // Биты присутствующих слов (A - бит 0, '$' - 26, '=' - 27)
+    uint8_t count;      // Занято значений
+    uint8_t indexes[GCODE_MAX_WORDS]; // Номер слова каждого значения
+    int32_t values[GCODE_MAX_WORDS];  // Значения в единицах 1/GCODE_SCALE
+
+    // Номер слова: буквы A-Z, затем '$' и '='
+    static uint8_t index(char letter) {
+        return letter == '$' ? 26 : letter == '=' ? 27 : letter - 'A';
+    }
+
+    void clear() {
+        words = 0;
+        count = 0;
+    }
+
+    bool has(char letter) const {
+        return words & (1UL << index(letter));
+    }
+
+    // Запись значения слова. false - слово новое, а места нет.
+    bool set(char letter, int32_t value) {
+        uint8_t i = slot(index(letter));
+        if (i == count) {
+            if (count == GCODE_MAX_WORDS) return false;
+            indexes[count++] = index(letter);
+            words |= 1UL << index(letter);
+        }
+        values[i] = value;
+        return true;
+    }
+
+    // Значение в фиксированной точке (0, если слова нет)
+    int32_t value(char letter) const {
+        return has(letter) ? values[slot(index(letter))] : 0;
+    }
+
+    // Значение, округлённое до целого
+    long integer(char letter) const {
+        int32_t v = value(letter);
+        return v >= 0 ? (v + GCODE_SCALE / 2) / GCODE_SCALE : -((-v + GCODE_SCALE / 2) / GCODE_SCALE);
+    }
+
+    // Проверка номера команды, например isCode('G', 28)
+    bool isCode(char letter, long code) const {
+        return has(letter) && value(letter) == code * GCODE_SCALE;
+    }
+
+    // Номер с подкомандой после точки, например isCode('G', 38, 2)
+    bool isCode(char letter, long code, uint8_t sub) const {
+        return has(letter) && value(letter) == code * GCODE_SCALE + sub * (GCODE_SCALE / 10);
+    }
+
+    // Место значения слова с номером index, count - слова нет
+    uint8_t slot(uint8_t index) const {
+        uint8_t i = 0;
+        while (i < count && indexes[i] != index) i++;
+        return i;
+    }
+};
+
+// Потоковый разбор G-code: принимает по одному байту, без выделения
+// памяти и с постоянным временем на байт. Строка разбирается по мере
+// поступления, к концу строки команда уже готова.
+//
+// Команда хранится вне разборщика: в прошивке одна GCodeCommand на
+// текст и двоичные кадры (BinaryLink), выполняется всегда только одна.
+class GCodeParser {
+public:
+    explicit GCodeParser(GCodeCommand& command);
+
+    // Обработка одного байта. Возвращает true, когда строка завершена
+    // и результат можно взять через command()/status().
+    bool feed(char c);
+
+    // Результат последней завершённой строки
+    const GCodeCommand& command();
+    uint8_t status();
+
+    // Текст последней завершённой строки
+    const char* line();
+
+    // Сброс незавершённой строки
+    void reset();
+
+private:
+    enum State {
+        STATE_WORD,      // Ожидание буквы
+        STATE_SIGN,      // После буквы: знак или цифра
+        STATE_INTEGER,   // Целая часть
+        STATE_FRACTION,  // Дробная часть
+        STATE_COMMENT,   // Комментарий в скобках
+        STATE_SKIP       // Комментарий ';' или ошибка - до конца строки
+    };
+
+    void finishWord();
+    void fail(uint8_t status);
+
+    GCodeCommand& _command;
+    char _line[GCODE_LINE_SIZE + 1];
+    uint8_t _length;
+    uint8_t _state;
+    uint8_t _status;
+    char _letter;        // Буква текущего слова
+    bool _negative;      // Знак текущего числа
+    bool _has_digits;    // В числе была хотя бы одна цифра
+    int32_t _integer;    // Целая часть
+    int32_t _fraction;   // Дробная часть в единицах 1/GCODE_SCALE
+    int32_t _frac_scale; // Вес следующей цифры дробной части
+};
+
+#endif
@@ -0,0 +1,127 @@
+#include "InputShaper.h"
+
+InputShaper::InputShaper() {
+    _impulses = 0;
+    _span = 0;
+    reset();
+}
+
+bool InputShaper::configure(uint8_t type, float freq_hz, float damping) {
+    if (type >= SHAPER_TYPE_COUNT || damping < 0 || damping >= 1) {
+        return false;
+    }
+    uint8_t impulses = 0;
+    uint8_t delay[SHAPER_MAX_IMPULSES];
+    int16_t weight[SHAPER_MAX_IMPULSES];
+    int16_t weight_next[SHAPER_MAX_IMPULSES];
+    if (type != SHAPER_NONE) {
+        if (freq_hz <= 0) {
+            return false;
+        }
+        // Амплитуды и моменты импульсов в долях периода затухающих колебаний
+        float root = sqrt(1 - damping * damping);
+        float k = exp(-damping * M_PI / root);
+        float amplitude[SHAPER_MAX_IMPULSES];
+        float time[SHAPER_MAX_IMPULSES];
+        if (type == SHAPER_ZV) {
+            impulses = 2;
+            amplitude[0] = 1;
+            amplitude[1] = k;
+            time[0] = 0;
+            time[1] = 0.5;
+        } else if (type == SHAPER_MZV) {
+            k = exp(-0.75 * damping * M_PI / root);
+            impulses = 3;
+            amplitude[0] = 1 - 1 / sqrt(2.0);
+            amplitude[1] = (sqrt(2.0) - 1) * k;
+            amplitude[2] = amplitude[0] * k * k;
+            time[0] = 0;
+            time[1] = 0.375;
+            time[2] = 0.75;
+        } else {
+            impulses = 3;
+            amplitude[0] = 0.25 * (1 + SHAPER_EI_TOLERANCE);
+            amplitude[1] = 0.5 * (1 - SHAPER_EI_TOLERANCE) * k;
+            amplitude[2] = amplitude[0] * k * k;
+            time[0] = 0;
+            time[1] = 0.5;
+            time[2] = 1;
+        }
+        float sum = 0;
+        for (uint8_t i = 0; i < impulses; i++) {
+            sum += amplitude[i];
+        }
+        // Период в выборках
+        float period = (float)STEP_ENGINE_TICK_HZ / SHAPER_SAMPLE_TICKS / (freq_hz * root);
+        long total = 0;
+        for (uint8_t i = 0; i < impulses; i++) {
+            float d = time[i] * period;
+            if (d >= SHAPER_HISTORY - 1) {
+                return false;
+            }
+            delay[i] = (uint8_t)d;
+            float fraction = d - delay[i];
+            float a = amplitude[i] / sum * SHAPER_ONE;
+            weight[i] = (int16_t)(a * (1 - fraction) + 0.5);
+            weight_next[i] = (int16_t)(a * fraction + 0.5);
+            total += weight[i] + weight_next[i];
+        }
+        // Остаток округления - первому импульсу: сумма весов ровно SHAPER_ONE
+        weight[0] += SHAPER_ONE - total;
+    }
+
+    noInterrupts();
+    _impulses = impulses;
+    for (uint8_t i = 0; i < impulses; i++) {
+        _delay[i] = delay[i];
+        _weight[i] = weight[i];
+        _weight_next[i] = weight_next[i];
+    }
+    _span = impulses != 0 ? delay[impulses - 1] + 1 : 0;
+    interrupts();
+    reset();
+    return true;
+}
+
+void InputShaper::reset() {
+    noInterrupts();
+    for (uint8_t i = 0; i < SHAPER_HISTORY; i++) {
+        _history[i] = 0;
+    }
+    _head = 0;
+    _quiet = 0;
+    _count = 0;
+    _command_dir = 1;
+    _dir = 0;
+    _velocity = 0;
+    _error = 0;
+    _active = false;
+    interrupts();
+}
+
+// Конец выборки: заданные шаги - в историю, выходная скорость на
+// следующую выборку - взвешенная сумма задержанных выборок
+void InputShaper::sample() {
+    _head = (_head + 1) & (SHAPER_HISTORY - 1);
+    _history[_head] = _count;
+    if (_count != 0) {
+        _quiet = 0;
+    } else if (_quiet < 0xFF) {
+        _quiet++;
+    }
+    _count = 0;
+    int32_t velocity = 0;
+    for (uint8_t i = 0; i < _impulses; i++) {
+        uint8_t index = (_head - _delay[i]) & (SHAPER_HISTORY - 1);
+        velocity += (int32_t)_weight[i] * _history[index];
+        velocity += (int32_t)_weight_next[i] * _history[(index - 1) & (SHAPER_HISTORY - 1)];
+    }
+    _velocity = velocity;
+    // Все выборки в пределах задержки пусты и шаг не отложен сменой
+    // направления - выход догнал форму, ошибка равна нулю
+    if (_quiet > _span && _error <= SHAPER_ONE * SHAPER_SAMPLE_TICKS / 2 &&
+            _error >= -SHAPER_ONE * SHAPER_SAMPLE_TICKS / 2) {
+        _dir = 0; // Пин DIR мог смениться другим заданием
+        _active = false;
+    }
+}
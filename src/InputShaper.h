@@ -0,0 +1,132 @@
+#ifndef INPUT_SHAPER_H
+#define INPUT_SHAPER_H
+
+#include <Arduino.h>
+#include "StepEngine.h"
+
+// Подавление резонанса (input shaping) координированного движения оси.
+//
+// Шаги, которые Брезенхем StepEngine выдал бы оси, не идут на пин, а
+// считаются по выборкам из SHAPER_SAMPLE_TICKS тактов. Выходная позиция -
+// сумма копий заданной, задержанных на доли периода резонанса и взятых с
+// весами (импульсы ZV/MZV/EI): колебания, возбуждённые копиями, гасят друг
+// друга. Дробная задержка - линейной интерполяцией соседних выборок.
+//
+// В прерывании только целые числа: раз в выборку - сумма
+// SHAPER_MAX_IMPULSES * 2 произведений "вес * шаги выборки", на каждом
+// такте - сложение и два сравнения, как у накопителей движка. Сумма весов
+// равна SHAPER_ONE точно, поэтому выходных шагов ровно столько же, сколько
+// заданных, и движение заканчивается точно в цели - позже заданного на
+// наибольшую задержку.
+
+// Длина выборки в тактах движка (1 мс). Заданных шагов за выборку не
+// больше SHAPER_SAMPLE_TICKS - помещаются в int8_t.
+#define SHAPER_SAMPLE_TICKS 40
+
+// Линия задержки: выборок в истории (степень двойки). Наибольшая задержка
+// - меньше SHAPER_HISTORY - 1 выборки (63 мс): ZV от 8 Гц, MZV от 12 Гц,
+// EI от 16 Гц (с затуханием - чуть выше).
+#define SHAPER_HISTORY 64
+
+#define SHAPER_MAX_IMPULSES 3
+
+// Единица весов (Q14)
+#define SHAPER_ONE 16384L
+
+// Допуск EI по остаточной вибрации
+#define SHAPER_EI_TOLERANCE 0.05
+
+enum ShaperType {
+    SHAPER_NONE,
+    SHAPER_ZV,  // Два импульса, полпериода: быстрый, чувствителен к ошибке частоты
+    SHAPER_MZV, // Три импульса, 3/4 периода
+    SHAPER_EI,  // Три импульса, период: терпит ошибку частоты около 20%
+    SHAPER_TYPE_COUNT
+};
+
+// Результат такта
+enum ShaperTick {
+    SHAPER_IDLE, // Шага нет
+    SHAPER_STEP, // Шаг в направлении direction() на следующем такте
+    SHAPER_TURN  // Сменилось направление: пин DIR - после импульса, шаг позже
+};
+
+class InputShaper {
+public:
+    InputShaper();
+
+    // Настройка из основного цикла на неподвижной оси. damping - доля
+    // критического затухания (0...1). false - тип неизвестен или задержка
+    // не помещается в историю.
+    bool configure(uint8_t type, float freq_hz, float damping);
+
+    bool isEnabled() const { return _impulses != 0; }
+
+    // Есть ли невыданные шаги (ось ещё движется)
+    bool isActive() const { return _active; }
+
+    // Направление заданных шагов блока (+1/-1) - при загрузке блока
+    inline void setCommandDir(int8_t dir) { _command_dir = dir; }
+
+    // Заданный шаг - из прерывания вместо выдачи на пин
+    inline void command() {
+        _count += _command_dir;
+        _active = true;
+    }
+
+    // Такт движка для активного формирователя - из прерывания.
+    // sample_end - последний такт выборки: раз в SHAPER_SAMPLE_TICKS
+    // тактов, у осей на разных тактах, чтобы расчёт выборок не сходился
+    // в одном прерывании.
+    inline uint8_t tick(bool sample_end) {
+        if (sample_end) {
+            sample();
+        }
+        // Ошибка - отставание выхода от формы в единицах SHAPER_ONE * такт:
+        // шаг выдаётся, когда она больше половины шага
+        _error += _velocity;
+        int8_t dir;
+        if (_error > SHAPER_ONE * SHAPER_SAMPLE_TICKS / 2) {
+            dir = 1;
+        } else if (_error < -SHAPER_ONE * SHAPER_SAMPLE_TICKS / 2) {
+            dir = -1;
+        } else {
+            return SHAPER_IDLE;
+        }
+        if (dir != _dir) {
+            _dir = dir;
+            return SHAPER_TURN;
+        }
+        _error -= dir * (SHAPER_ONE * SHAPER_SAMPLE_TICKS);
+        return SHAPER_STEP;
+    }
+
+    // Направление выходных шагов
+    int8_t direction() const { return _dir; }
+
+    // Сброс невыданных шагов (StepEngine::abort())
+    void reset();
+
+private:
+    void sample();
+
+    // Настройка
+    uint8_t _impulses;                     // 0 - формирование выключено
+    uint8_t _delay[SHAPER_MAX_IMPULSES];   // Целая часть задержки, выборки
+    int16_t _weight[SHAPER_MAX_IMPULSES];  // Вес выборки с этой задержкой (Q14)
+    int16_t _weight_next[SHAPER_MAX_IMPULSES]; // Вес выборки на одну старше
+    uint8_t _span;                         // Через столько пустых выборок выход стоит
+
+    // Состояние (общее с прерыванием)
+    int8_t _history[SHAPER_HISTORY]; // Заданные шаги по выборкам
+    uint8_t _head;                   // Последняя выборка в истории
+    uint8_t _quiet;                  // Выборок подряд без заданных шагов
+    int8_t _count;                   // Заданные шаги текущей выборки
+    int8_t _command_dir;
+    int8_t _dir;                     // Направление на пине DIR, 0 - не задано
+    int32_t _velocity;               // Выходные шаги за выборку (Q14)
+    int32_t _error;
+    volatile bool _active;
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include "Log.h"
+#include "Console.h"
+
+// Шаг вывода: сообщение закончено
+#define LOG_STEP_DONE 0xFF
+
+LogRecord Log::_records[LOG_BUFFER_SIZE];
+uint8_t Log::_head = 0;
+uint8_t Log::_tail = 0;
+uint8_t Log::_dropped = 0;
+uint8_t Log::_level = LOG_DEFAULT_LEVEL;
+bool Log::_codes_only = false;
+bool Log::_writing = false;
+LogRecord Log::_current;
+const char* Log::_text = NULL;
+uint8_t Log::_step = 0;
+char Log::_number[13];
+uint8_t Log::_number_pos = 0;
+uint8_t Log::_arg = 0;
+
+// Тексты сообщений: % - число, ^ - буква из следующего числа события
+const char* Log::text(uint8_t code) {
+#if defined(LOG_CODES_ONLY)
+    (void)code;
+    return NULL;
+#else
+    switch (code) {
+        case LOG_MOTOR_BUSY: return PSTR("Ошибка: Двигатель занят.");
+        case LOG_NOT_CALIBRATED: return PSTR("Ошибка: Двигатель не откалиброван. Выполните калибровку.");
+        case LOG_ARC_ABORTED: return PSTR("Ошибка: Дуга прервана");
+        case LOG_ENDSTOP_STUCK: return PSTR("Ошибка: Концевик не отпущен после отхода.");
+        case LOG_AXES_BUSY: return PSTR("Ошибка: Двигатели заняты");
+        case LOG_EXECUTION_FAILED: return PSTR("Ошибка выполнения команды");
+        case LOG_NO_XY: return PSTR("Ошибка: Нет осей X и Y");
+        case LOG_ARC_RADIUS: return PSTR("Ошибка: Радиус меньше половины расстояния до цели");
+        case LOG_ARC_CENTER: return PSTR("Ошибка: Для дуги нужен центр I/J или радиус R");
+        case LOG_UNKNOWN_COMMAND: return PSTR("Неизвестная команда");
+        case LOG_PARSE_CHAR: return PSTR("Ошибка: Недопустимый символ");
+        case LOG_PARSE_NUMBER: return PSTR("Ошибка: Неверное число");
+        case LOG_PARSE_OVERFLOW: return PSTR("Ошибка: Число вне диапазона");
+        case LOG_PARSE_LENGTH: return PSTR("Ошибка: Слишком длинная строка");
+        case LOG_DROPPED: return PSTR("Потеряно сообщений: %");
+        case LOG_SETTING_UNKNOWN: return PSTR("Ошибка: Нет настройки $%");
+        case LOG_SETTING_INVALID: return PSTR("Ошибка: Недопустимое значение $%");
+        case LOG_NOTHING_TO_PARK: return PSTR("Ошибка: Нет откалиброванных осей, позиция не сохранена");
+        case LOG_PROBE_ACTIVE: return PSTR("Ошибка: Щуп уже замкнут");
+        case LOG_PROBE_FAILED: return PSTR("Ошибка: Щуп не сработал до конечной точки");
+        case LOG_PROGRAM_UNSUPPORTED: return PSTR("Ошибка: Строка не сохраняется в программе");
+        case LOG_PROGRAM_FULL: return PSTR("Ошибка: Программа не помещается в EEPROM (% байт)");
+        case LOG_PROGRAM_MISSING: return PSTR("Ошибка: Нет сохранённой программы");
+        case LOG_PROGRAM_STOPPED: return PSTR("Ошибка: Программа остановлена на строке %, ошибка %");
+        case LOG_CALIBRATION_START: return PSTR("Ось %: начало калибровки, движение к концевику. Максимальное расстояние: % шагов.");
+        case LOG_HOME_FOUND: return PSTR("Ось %: начальная точка найдена, установлена позиция 0. Длина рейки: % шагов.");
+        case LOG_CALIBRATION_DONE: return PSTR("Ось %: калибровка завершена.");
+        case LOG_HOMING_AXES: return PSTR("Калибровка осей (маска %)...");
+        case LOG_SETTINGS_DEFAULTS: return PSTR("Настройки по умолчанию: в EEPROM нет записи");
+        case LOG_POSITION_RESTORED: return PSTR("Позиция восстановлена после парковки (маска %), G28 не нужна");
+        case LOG_POSITION_SAVED: return PSTR("Позиция сохранена (маска %), драйверы держат оси. Можно выключать.");
+        case LOG_PROGRAM_RECORDING: return PSTR("Запись программы: строки G сохраняются до M881");
+        case LOG_PROGRAM_STORED: return PSTR("Программа сохранена: строк %, байт %");
+        case LOG_PROGRAM_DONE: return PSTR("Программа выполнена, повторов: %");
+        case LOG_COMMAND: return PSTR("Получена команда: ^%");
+        case LOG_MOVE_TO: return PSTR("Перемещение в: % %");
+        case LOG_ARC_TO: return PSTR("Дуга в: % %");
+    }
+    return NULL; // Неизвестный код выводится числом
+#endif
+}
+
+void Log::event(uint8_t code) {
+    push(code, 0, 0, 0);
+}
+
+void Log::event(uint8_t code, int32_t a) {
+    push(code, 1, a, 0);
+}
+
+void Log::event(uint8_t code, int32_t a, int32_t b) {
+    push(code, 2, a, b);
+}
+
+void Log::setLevel(uint8_t level) {
+    _level = level;
+}
+
+void Log::setCodesOnly(bool codes_only) {
+    _codes_only = codes_only;
+}
+
+void Log::push(uint8_t code, uint8_t count, int32_t a, int32_t b) {
+    uint8_t level = code < 32 ? LOG_ERROR : code < 64 ? LOG_INFO : LOG_DEBUG;
+    // В двоичном режиме текст не выводится, ошибки идут в ACK
+    if (level > _level || Console.isMuted()) {
+        return;
+    }
+    uint8_t used = _head >= _tail ? _head - _tail : _head + LOG_BUFFER_SIZE - _tail;
+    uint8_t free = LOG_BUFFER_SIZE - 1 - used;
+    // О потерях сообщаем до следующего события, для этого нужно два места
+    if (free < (_dropped != 0 ? 2 : 1)) {
+        if (_dropped < 0xFF) _dropped++;
+        return;
+    }
+    if (_dropped != 0) {
+        LogRecord& lost = _records[_head];
+        lost.code = LOG_DROPPED;
+        lost.count = 1;
+        lost.args[0] = _dropped;
+        _head = _head + 1 < LOG_BUFFER_SIZE ? _head + 1 : 0;
+        _dropped = 0;
+    }
+    LogRecord& record = _records[_head];
+    record.code = code;
+    record.count = count;
+    record.args[0] = a;
+    record.args[1] = b;
+    _head = _head + 1 < LOG_BUFFER_SIZE ? _head + 1 : 0;
+}
+
+// Число в _number, с пробелом перед ним в режиме кодов
+void Log::setNumber(int32_t value, bool space) {
+    char digits[10];
+    uint8_t count = 0;
+    uint32_t v = value < 0 ? 0UL - (uint32_t)value : (uint32_t)value;
+    do {
+        digits[count++] = '0' + v % 10;
+        v /= 10;
+    } while (v != 0);
+    uint8_t length = 0;
+    if (space) _number[length++] = ' ';
+    if (value < 0) _number[length++] = '-';
+    while (count > 0) {
+        _number[length++] = digits[--count];
+    }
+    _number[length] = '\0';
+    _number_pos = 0;
+}
+
+// Следующий символ отправляемого сообщения; false - сообщение закончено
+bool Log::nextChar(char& c) {
+    while (_number[_number_pos] == '\0') {
+        _number[0] = '\0';
+        _number_pos = 0;
+        if (_step == LOG_STEP_DONE) {
+            return false;
+        }
+        if (_text != NULL) {
+            char t = pgm_read_byte(_text);
+            if (t == '\0') {
+                strcpy_P(_number, PSTR("\r\n"));
+                _step = LOG_STEP_DONE;
+                continue;
+            }
+            _text++;
+            if (t == '%' && _arg < _current.count) {
+                setNumber(_current.args[_arg++], false);
+                continue;
+            }
+            if (t == '^' && _arg < _current.count) {
+                t = (char)_current.args[_arg++];
+            }
+            c = t;
+            return true;
+        }
+        // Режим кодов: [MSG:<код> <число> <число>]
+        if (_step == 0) {
+            strcpy_P(_number, PSTR("[MSG:"));
+            _step = 1;
+        } else if (_step == 1) {
+            setNumber(_current.code, false);
+            _step = 2;
+        } else if (_arg < _current.count) {
+            setNumber(_current.args[_arg++], true);
+        } else {
+            strcpy_P(_number, PSTR("]\r\n"));
+            _step = LOG_STEP_DONE;
+        }
+    }
+    c = _number[_number_pos++];
+    return true;
+}
+
+void Log::drain() {
+    if (Console.isMuted()) {
+        return;
+    }
+    while (Serial.availableForWrite() > 0) {
+        if (!_writing) {
+            if (_head == _tail) {
+                return;
+            }
+            _current = _records[_tail];
+            _tail = _tail + 1 < LOG_BUFFER_SIZE ? _tail + 1 : 0;
+            _text = _codes_only ? NULL : text(_current.code);
+            _step = 0;
+            _arg = 0;
+            _number[0] = '\0';
+            _number_pos = 0;
+            _writing = true;
+        }
+        char c;
+        if (nextChar(c)) {
+            Serial.write(c);
+        } else {
+            _writing = false;
+        }
+    }
+}
+
+void Log::finishMessage() {
+    char c;
+    while (_writing) {
+        if (nextChar(c)) {
+            Serial.write(c);
+        } else {
+            _writing = false;
+        }
+    }
+}
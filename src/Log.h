@@ -0,0 +1,126 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+
+// Очередь сообщений: событие - код и до двух чисел, текст подставляется
+// только при отправке. Отправка - из loop(), сколько помещается в буфер
+// передачи Serial, поэтому сообщение никогда не ждёт порта.
+//
+// Вывод - текстом ("Калибровка завершена.") или, для хоста со своей
+// таблицей текстов, кодами: [MSG:<код> <число> <число>]. Сборка с
+// -D LOG_CODES_ONLY убирает тексты из прошивки, остаются только коды.
+
+// Мест в очереди сообщений (по 10 байт ОЗУ). Не поместившиеся события
+// не ждут, а считаются и выводятся одним сообщением LOG_DROPPED.
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE 8
+#endif
+
+// Уровень подробности по умолчанию (меняется M872 S<уровень>)
+#ifndef LOG_DEFAULT_LEVEL
+#define LOG_DEFAULT_LEVEL LOG_INFO
+#endif
+
+// Уровни подробности: сообщение выводится, если его уровень не выше
+// заданного. Уровень сообщения задаётся диапазоном кода.
+enum LogLevel {
+    LOG_OFF = 0,
+    LOG_ERROR = 1, // Коды 1-31
+    LOG_INFO = 2,  // Коды 32-63
+    LOG_DEBUG = 3  // Коды 64-
+};
+
+// Коды сообщений. Номера не меняются: по ним хост находит текст.
+enum LogCode {
+    LOG_MOTOR_BUSY = 1,        // Двигатель занят
+    LOG_NOT_CALIBRATED = 2,    // Двигатель не откалиброван
+    LOG_ARC_ABORTED = 3,       // Дуга прервана
+    LOG_ENDSTOP_STUCK = 4,     // Концевик не отпущен после отхода
+    LOG_AXES_BUSY = 5,         // Двигатели заняты (G28)
+    LOG_EXECUTION_FAILED = 6,  // Ошибка выполнения команды
+    LOG_NO_XY = 7,             // Нет осей X и Y для дуги
+    LOG_ARC_RADIUS = 8,        // Радиус меньше половины хорды
+    LOG_ARC_CENTER = 9,        // Нет центра I/J или радиуса R
+    LOG_UNKNOWN_COMMAND = 10,  // Неизвестная команда
+    LOG_PARSE_CHAR = 11,       // Недопустимый символ
+    LOG_PARSE_NUMBER = 12,     // Неверное число
+    LOG_PARSE_OVERFLOW = 13,   // Число вне диапазона
+    LOG_PARSE_LENGTH = 14,     // Слишком длинная строка
+    LOG_DROPPED = 15,          // Потеряно сообщений: число
+    LOG_SETTING_UNKNOWN = 16,  // Нет настройки: номер
+    LOG_SETTING_INVALID = 17,  // Недопустимое значение настройки: номер
+    LOG_NOTHING_TO_PARK = 18,  // Парковка: нет откалиброванных осей
+    LOG_PROBE_ACTIVE = 19,     // Щуп замкнут до начала G38
+    LOG_PROBE_FAILED = 20,     // G38.2: щуп не сработал до конечной точки
+    LOG_PROGRAM_UNSUPPORTED = 21, // Строка не сохраняется в программе
+    LOG_PROGRAM_FULL = 22,     // Программа не помещается: байт в EEPROM
+    LOG_PROGRAM_MISSING = 23,  // Нет сохранённой программы
+    LOG_PROGRAM_STOPPED = 24,  // Программа остановлена: строка, код ошибки
+
+    LOG_CALIBRATION_START = 32, // Начало калибровки: ось, длина рейки
+    LOG_HOME_FOUND = 33,        // Ноль найден: ось, длина рейки
+    LOG_CALIBRATION_DONE = 34,  // Калибровка завершена: ось
+    LOG_HOMING_AXES = 35,       // Калибровка осей: маска осей группы
+    LOG_SETTINGS_DEFAULTS = 36, // В EEPROM нет настроек, действуют заводские
+    LOG_POSITION_RESTORED = 37, // Позиция восстановлена без G28: маска осей
+    LOG_POSITION_SAVED = 38,    // Парковка: позиция сохранена, маска осей
+    LOG_PROGRAM_RECORDING = 39, // M880: строки G сохраняются до M881
+    LOG_PROGRAM_STORED = 40,    // Программа сохранена: строк, байт
+    LOG_PROGRAM_DONE = 41,      // Программа выполнена: повторов
+
+    LOG_COMMAND = 64,           // Получена команда: буква, номер
+    LOG_MOVE_TO = 65,           // Перемещение: цель первых двух осей
+    LOG_ARC_TO = 66             // Дуга: цель первых двух осей
+};
+
+// Событие в очереди
+struct LogRecord {
+    uint8_t code;
+    uint8_t count; // Чисел в args
+    int32_t args[2];
+};
+
+class Log {
+public:
+    // Постановка события. Если очередь заполнена, событие теряется,
+    // а число потерь выводится следующим сообщением LOG_DROPPED.
+    static void event(uint8_t code);
+    static void event(uint8_t code, int32_t a);
+    static void event(uint8_t code, int32_t a, int32_t b);
+
+    // Отправка очереди, сколько помещается в буфер Serial - в loop()
+    static void drain();
+
+    // Дописать начатое сообщение целиком (перед другим выводом в Serial,
+    // чтобы строки не перемешались)
+    static void finishMessage();
+
+    // Уровень подробности (LogLevel) и вывод только кодов
+    static void setLevel(uint8_t level);
+    static void setCodesOnly(bool codes_only);
+
+private:
+    static void push(uint8_t code, uint8_t count, int32_t a, int32_t b);
+    static bool nextChar(char& c);
+    static void setNumber(int32_t value, bool space);
+    static const char* text(uint8_t code);
+
+    static LogRecord _records[LOG_BUFFER_SIZE];
+    static uint8_t _head;
+    static uint8_t _tail;
+    static uint8_t _dropped;
+    static uint8_t _level;
+    static bool _codes_only;
+
+    // Сообщение, которое сейчас отправляется
+    static bool _writing;
+    static LogRecord _current;
+    static const char* _text;   // Позиция в тексте (PROGMEM), NULL - коды
+    static uint8_t _step;       // Шаг вывода в режиме кодов
+    static char _number[13];    // Число, подставляемое в текст
+    static uint8_t _number_pos;
+    static uint8_t _arg;        // Следующее число события
+};
+
+#endif
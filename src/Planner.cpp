@@ -0,0 +1,364 @@
+#include "Planner.h"
+#include "StepperMotor.h"
+#include "Log.h"
+
+PlannerBlock Planner::_blocks[PLANNER_BUFFER_SIZE];
+volatile uint8_t Planner::_head = 0;
+volatile uint8_t Planner::_tail = 0;
+volatile bool Planner::_tail_running = false;
+long Planner::_position[STEP_ENGINE_MAX_AXES];
+float Planner::_prev_unit[STEP_ENGINE_MAX_AXES];
+float Planner::_prev_nominal_sqr = 0;
+uint32_t Planner::_last_append = 0;
+uint8_t Planner::_enabled_axes = 0;
+
+uint8_t Planner::nextIndex(uint8_t index) {
+    return index + 1 < PLANNER_BUFFER_SIZE ? index + 1 : 0;
+}
+
+uint8_t Planner::prevIndex(uint8_t index) {
+    return index > 0 ? index - 1 : PLANNER_BUFFER_SIZE - 1;
+}
+
+bool Planner::line(const long target[STEP_ENGINE_MAX_AXES], long feed, bool feed_mm) {
+    bool idle = !isBusy();
+    if (idle) {
+        syncPosition();
+    }
+
+    long delta[STEP_ENGINE_MAX_AXES];
+    uint8_t count = StepEngine::axisCount();
+    for (uint8_t i = 0; i < count; i++) {
+        StepperMotor* motor = StepEngine::motor(i);
+        long pos = target[i];
+        delta[i] = 0;
+        if (pos == _position[i]) continue;
+        // Пока очередь не пуста, ось занята только её блоками
+        if (idle && motor->isBusy()) {
+            Log::event(LOG_MOTOR_BUSY);
+            return false;
+        }
+        if (!motor->isCalibrated()) {
+            Log::event(LOG_NOT_CALIBRATED);
+            return false;
+        }
+        // Ограничиваем движение пределами рейки
+        if (pos < 0) pos = 0;
+        if (pos > motor->getMaxPosition()) pos = motor->getMaxPosition();
+        delta[i] = pos - _position[i];
+    }
+    for (uint8_t i = count; i < STEP_ENGINE_MAX_AXES; i++) {
+        delta[i] = 0;
+    }
+
+    // Очередь заполнена - ждём, пока движок освободит блок
+    while (isFull()) {
+        update();
+    }
+
+    PlannerBlock& block = _blocks[_head];
+    if (!planBlock(block, delta, feed, feed_mm)) {
+        return true; // Перемещение нулевой длины
+    }
+
+    // Скорость на стыке с предыдущим блоком по допуску отклонения:
+    // v^2 = a * d * sin(q/2) / (1 - sin(q/2)), q - угол между направлениями
+    float unit[STEP_ENGINE_MAX_AXES];
+    float cos_theta = 0;
+    for (uint8_t i = 0; i < STEP_ENGINE_MAX_AXES; i++) {
+        unit[i] = delta[i] / block.length;
+        cos_theta -= _prev_unit[i] * unit[i];
+    }
+    float junction_sqr = 0;
+    if (_head != _tail && cos_theta < 0.999999) {
+        if (cos_theta > -0.999999) {
+            float sin_half = sqrt(0.5 * (1.0 - cos_theta));
+            junction_sqr = block.acceleration * PLANNER_JUNCTION_DEVIATION * sin_half / (1.0 - sin_half);
+        } else {
+            junction_sqr = block.nominal_speed_sqr; // Продолжение по прямой
+        }
+        if (junction_sqr > block.nominal_speed_sqr) junction_sqr = block.nominal_speed_sqr;
+        if (junction_sqr > _prev_nominal_sqr) junction_sqr = _prev_nominal_sqr;
+    }
+    block.max_entry_speed_sqr = junction_sqr;
+    block.entry_speed_sqr = 0;
+
+    // Новый блок заканчивается остановкой, пока за ним ничего нет
+    float entry_rate, exit_rate;
+    uint32_t decel_steps;
+    blockRates(block, 0, 0, entry_rate, exit_rate, decel_steps);
+    block.motion.entry_rate = StepEngine::rateFromHz((long)entry_rate);
+    block.motion.exit_rate = StepEngine::rateFromHz((long)exit_rate);
+    block.motion.decel_steps = decel_steps;
+
+    for (uint8_t i = 0; i < STEP_ENGINE_MAX_AXES; i++) {
+        _prev_unit[i] = unit[i];
+    }
+    _prev_nominal_sqr = block.nominal_speed_sqr;
+    for (uint8_t i = 0; i < count; i++) {
+        if (block.motion.steps[i] == 0) continue;
+        if (!(_enabled_axes & (1 << i))) {
+            StepEngine::motor(i)->enable();
+            _enabled_axes |= (1 << i);
+        }
+        _position[i] += delta[i];
+    }
+    _last_append = millis();
+
+    // Блок готов - публикуем его для движка и пересчитываем стыки
+    _head = nextIndex(_head);
+    recalculate();
+    return true;
+}
+
+// Расчёт блока: скорость и ускорение подбираются так, чтобы
+// ни одна ось не превысила свои setSpeed()/setAcceleration()
+bool Planner::planBlock(PlannerBlock& block, const long delta[STEP_ENGINE_MAX_AXES], long feed, bool feed_mm) {
+    MotionBlock& motion = block.motion;
+    uint32_t events = 0;
+    float length_sq = 0;
+    motion.dir_negative = 0;
+    for (uint8_t i = 0; i < STEP_ENGINE_MAX_AXES; i++) {
+        motion.steps[i] = labs(delta[i]);
+        if (delta[i] < 0) motion.dir_negative |= (1 << i);
+        if (motion.steps[i] > events) events = motion.steps[i];
+        length_sq += (float)delta[i] * delta[i];
+    }
+    if (events == 0) {
+        return false;
+    }
+    motion.step_event_count = events;
+    block.length = sqrt(length_sq);
+    float k = events / block.length;
+
+    // Подача в мм/мин пересчитывается по длине пути в мм: у осей может
+    // быть разное число шагов на мм
+    float feed_length = block.length;
+    if (feed_mm) {
+        float length_mm_sq = 0;
+        for (uint8_t i = 0; i < StepEngine::axisCount(); i++) {
+            float mm = delta[i] / StepEngine::motor(i)->getStepsPerMM();
+            length_mm_sq += mm * mm;
+        }
+        feed_length = sqrt(length_mm_sq);
+    }
+
+    // Ограничения осей переводятся на ведущую ось
+    float speed = feed > 0 ? feed / 60.0 * events / feed_length : 1e9;
+    float accel = 1e9;
+    for (uint8_t i = 0; i < StepEngine::axisCount(); i++) {
+        if (motion.steps[i] == 0) continue;
+        StepperMotor* motor = StepEngine::motor(i);
+        float scale = (float)events / motion.steps[i];
+        float axis_speed = motor->getSpeed() * scale;
+        float axis_accel = motor->getAcceleration() * scale;
+        if (axis_speed < speed) speed = axis_speed;
+        if (axis_accel < accel) accel = axis_accel;
+    }
+    if (speed < 1) speed = 1;
+
+    motion.cruise_rate = StepEngine::rateFromHz((long)speed);
+    motion.accel = (uint32_t)(accel * STEP_ACCEL_PER_HZ_S);
+    speed /= k;
+    block.nominal_speed_sqr = speed * speed;
+    // Блок без разгона проходится на постоянной скорости: для планировщика
+    // это бесконечное ускорение
+    block.acceleration = motion.accel != 0 ? accel / k : 1e9;
+    return true;
+}
+
+// Скорости блока в шагах ведущей оси по квадратам скоростей входа и выхода
+// вдоль траектории. Скорости не опускаются ниже sqrt(2a) - скорости,
+// набираемой за первый шаг, иначе движок не сдвинется с места.
+void Planner::blockRates(const PlannerBlock& block, float entry_sqr, float exit_sqr,
+    float& entry_rate, float& exit_rate, uint32_t& decel_steps) {
+    float k = block.motion.step_event_count / block.length;
+    float accel = block.acceleration;
+    float cruise = sqrt(block.nominal_speed_sqr) * k;
+    float floor_rate = sqrt(2.0 * accel * k);
+    if (floor_rate > cruise) floor_rate = cruise;
+
+    entry_rate = sqrt(entry_sqr) * k;
+    exit_rate = sqrt(exit_sqr) * k;
+    if (entry_rate < floor_rate) entry_rate = floor_rate;
+    if (exit_rate < floor_rate) exit_rate = floor_rate;
+
+    // Путь торможения; если разгон и торможение не помещаются в блок -
+    // треугольный профиль с точкой перехода посередине по энергии
+    float decel = (block.nominal_speed_sqr - exit_sqr) / (2.0 * accel);
+    float accel_len = (block.nominal_speed_sqr - entry_sqr) / (2.0 * accel);
+    if (accel_len + decel > block.length) {
+        decel = (2.0 * accel * block.length + entry_sqr - exit_sqr) / (4.0 * accel);
+        if (decel < 0) decel = 0;
+        if (decel > block.length) decel = block.length;
+    }
+    decel_steps = (uint32_t)(decel * k);
+    if (decel_steps > block.motion.step_event_count) {
+        decel_steps = block.motion.step_event_count;
+    }
+}
+
+// Согласование скоростей на стыках: проход назад от последнего блока
+// (он заканчивается остановкой), затем вперёд от первого изменяемого.
+// Скорость входа не может превышать достижимую на длине блока.
+void Planner::recalculate() {
+    uint8_t first;
+    noInterrupts();
+    // Вход выполняемого блока и блока сразу за ним уже зафиксирован
+    first = nextIndex(_tail);
+    if (_tail_running && first != _head) first = nextIndex(first);
+    interrupts();
+    if (first == _head) {
+        return;
+    }
+
+    uint8_t index = prevIndex(_head);
+    float next_entry_sqr = 0;
+    while (true) {
+        PlannerBlock& block = _blocks[index];
+        float entry_sqr = next_entry_sqr + 2.0 * block.acceleration * block.length;
+        if (entry_sqr > block.max_entry_speed_sqr) entry_sqr = block.max_entry_speed_sqr;
+        block.entry_speed_sqr = entry_sqr;
+        next_entry_sqr = entry_sqr;
+        if (index == first) break;
+        index = prevIndex(index);
+    }
+
+    for (index = first; index != _head; index = nextIndex(index)) {
+        PlannerBlock& prev = _blocks[prevIndex(index)];
+        float reachable_sqr = prev.entry_speed_sqr + 2.0 * prev.acceleration * prev.length;
+        if (_blocks[index].entry_speed_sqr > reachable_sqr) {
+            _blocks[index].entry_speed_sqr = reachable_sqr;
+        }
+    }
+
+    for (index = first; index != _head; index = nextIndex(index)) {
+        writeJunction(index);
+    }
+}
+
+// Запись скоростей на стыке блока index с предыдущим: выход предыдущего
+// блока, его точка торможения, вход блока и его точка торможения (с
+// выходом в остановку, пока следующий стык её не перепишет) меняются
+// вместе, и только если движок ещё не взял предыдущий блок
+void Planner::writeJunction(uint8_t index) {
+    PlannerBlock& prev = _blocks[prevIndex(index)];
+    PlannerBlock& block = _blocks[index];
+    float junction_sqr = block.entry_speed_sqr;
+    float prev_entry, prev_exit, entry, exit;
+    uint32_t prev_decel, decel;
+    blockRates(prev, prev.entry_speed_sqr, junction_sqr, prev_entry, prev_exit, prev_decel);
+    blockRates(block, junction_sqr, 0, entry, exit, decel);
+    uint32_t prev_exit_rate = StepEngine::rateFromHz((long)prev_exit);
+    uint32_t entry_rate = StepEngine::rateFromHz((long)entry);
+
+    noInterrupts();
+    if (isPending(prevIndex(index))) {
+        prev.motion.exit_rate = prev_exit_rate;
+        prev.motion.decel_steps = prev_decel;
+        block.motion.entry_rate = entry_rate;
+        block.motion.decel_steps = decel;
+    }
+    interrupts();
+}
+
+// Блок в очереди и ещё не взят движком
+bool Planner::isPending(uint8_t index) {
+    uint8_t offset = (index + PLANNER_BUFFER_SIZE - _tail) % PLANNER_BUFFER_SIZE;
+    uint8_t used = (_head + PLANNER_BUFFER_SIZE - _tail) % PLANNER_BUFFER_SIZE;
+    if (offset >= used) return false;
+    return !(offset == 0 && _tail_running);
+}
+
+const MotionBlock* Planner::nextBlock() {
+    if (_tail_running) {
+        _tail = nextIndex(_tail);
+        _tail_running = false;
+    }
+    if (_tail == _head) {
+        return NULL;
+    }
+    _tail_running = true;
+    return &_blocks[_tail].motion;
+}
+
+MotionBlock& Planner::sharedBlock(uint8_t index) {
+    return _blocks[index].motion;
+}
+
+bool Planner::isBusy() {
+    // Выполняемый блок остаётся в очереди до конца, а движок может быть
+    // занят отрезками SegmentReplay
+    return _head != _tail;
+}
+
+bool Planner::isFull() {
+    return nextIndex(_head) == _tail;
+}
+
+uint8_t Planner::freeBlocks() {
+    uint8_t used = (_head + PLANNER_BUFFER_SIZE - _tail) % PLANNER_BUFFER_SIZE;
+    return PLANNER_BUFFER_SIZE - 1 - used;
+}
+
+void Planner::synchronize() {
+    while (isBusy()) {
+        update();
+    }
+}
+
+void Planner::update() {
+    // При удержании подачи следующий блок ждёт resume()
+    if (StepEngine::lineBusy() || StepEngine::holdState() != HOLD_NONE) {
+        return;
+    }
+
+    if (_head != _tail) {
+        // Запуск очереди: сразу, если она заполнена, иначе после паузы
+        if (!isFull() && millis() - _last_append < PLANNER_START_DELAY_MS) {
+            return;
+        }
+        noInterrupts();
+        const MotionBlock* block = nextBlock();
+        interrupts();
+        if (block != NULL) {
+            StepEngine::startLine(block);
+        }
+        return;
+    }
+
+    if (_enabled_axes == 0) {
+        return;
+    }
+    // Очередь выполнена - выключаем драйверы, как после move()
+    for (uint8_t i = 0; i < StepEngine::axisCount(); i++) {
+        if (_enabled_axes & (1 << i)) {
+            StepperMotor* motor = StepEngine::motor(i);
+            if (!motor->isBusy()) motor->disable();
+        }
+    }
+    _enabled_axes = 0;
+}
+
+void Planner::reset() {
+    noInterrupts();
+    _tail = _head;
+    _tail_running = false;
+    interrupts();
+    _enabled_axes = 0;
+    _prev_nominal_sqr = 0;
+    for (uint8_t i = 0; i < STEP_ENGINE_MAX_AXES; i++) {
+        _prev_unit[i] = 0;
+    }
+    syncPosition();
+}
+
+void Planner::syncPosition() {
+    for (uint8_t i = 0; i < StepEngine::axisCount(); i++) {
+        _position[i] = StepEngine::motor(i)->getCurrentPosition();
+    }
+}
+
+long Planner::getPosition(uint8_t axis) {
+    return axis < STEP_ENGINE_MAX_AXES ? _position[axis] : 0;
+}
@@ -0,0 +1,102 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <Arduino.h>
+#include "StepEngine.h"
+
+// Размер очереди блоков движения (с двумя осями блок - 53 байта ОЗУ).
+// Скорость на коротких строках ограничена путём торможения по очереди:
+// строки по 1 мм при 200 мм/с^2 идут до 53 мм/с, с 6 блоками - до 45.
+// Сборка для Nano берёт 6 (platformio.ini): 8 блоков не оставляют запаса
+// под стек.
+#ifndef PLANNER_BUFFER_SIZE
+#define PLANNER_BUFFER_SIZE 8
+#endif
+
+// Допуск отклонения от траектории на стыке блоков в шагах: определяет
+// скорость, с которой проходится угол
+#define PLANNER_JUNCTION_DEVIATION 2.0
+
+// Если очередь не заполнена, движение начинается через эту паузу после
+// последней команды, чтобы успели прийти следующие блоки
+#define PLANNER_START_DELAY_MS 20
+
+// Блок в очереди планировщика. Скорости - вдоль траектории в шагах/с,
+// квадраты скоростей хранятся для расчёта без извлечения корня. Шагов
+// ведущей оси на шаг траектории не хранится: это step_event_count / length.
+struct PlannerBlock {
+    MotionBlock motion;        // Задание для шагового движка
+    float length;              // Длина траектории в шагах
+    float acceleration;        // Ускорение вдоль траектории
+    float nominal_speed_sqr;   // Квадрат заданной скорости
+    float entry_speed_sqr;     // Квадрат скорости входа в блок
+    float max_entry_speed_sqr; // Ограничение скорости входа (угол, скорости блоков)
+};
+
+// Планировщик координированных перемещений: ставит блоки в кольцевую
+// очередь и согласует скорости на стыках (проход назад и вперёд по
+// очереди), чтобы последовательные G1 не останавливались между собой.
+// Вся арифметика с плавающей точкой выполняется здесь, в основном цикле.
+class Planner {
+public:
+    // Линейное перемещение в абсолютную позицию (в шагах по каждой оси
+    // движка) с подачей feed вдоль траектории: в шагах/мин или, если
+    // feed_mm, в мм/мин (0 - максимальная скорость осей). Если очередь
+    // заполнена, ждёт освобождения места.
+    static bool line(const long target[STEP_ENGINE_MAX_AXES], long feed, bool feed_mm = false);
+
+    // Есть ли в очереди невыполненные блоки
+    static bool isBusy();
+
+    // Заполнена ли очередь
+    static bool isFull();
+
+    // Число свободных мест в очереди
+    static uint8_t freeBlocks();
+
+    // Ожидание выполнения всех блоков
+    static void synchronize();
+
+    // Обновление состояния - должно вызываться в loop()
+    static void update();
+
+    // Взять текущие позиции двигателей за исходную точку
+    static void syncPosition();
+
+    // Очистка очереди после StepEngine::abort()
+    static void reset();
+
+    // Позиция, в которой закончится последнее перемещение
+    static long getPosition(uint8_t axis);
+
+    // Следующий блок для движка - вызывается из прерывания по окончании
+    // текущего блока. Возвращает NULL, если очередь пуста.
+    static const MotionBlock* nextBlock();
+
+    // Место index очереди под блок другого источника (SegmentReplay).
+    // Источники не работают одновременно: пока место занято, очередь
+    // планировщика пуста.
+    static MotionBlock& sharedBlock(uint8_t index);
+
+private:
+    static bool planBlock(PlannerBlock& block, const long delta[STEP_ENGINE_MAX_AXES], long feed, bool feed_mm);
+    static void recalculate();
+    static void blockRates(const PlannerBlock& block, float entry_sqr, float exit_sqr,
+        float& entry_rate, float& exit_rate, uint32_t& decel_steps);
+    static void writeJunction(uint8_t index);
+    static bool isPending(uint8_t index);
+    static uint8_t nextIndex(uint8_t index);
+    static uint8_t prevIndex(uint8_t index);
+
+    static PlannerBlock _blocks[PLANNER_BUFFER_SIZE];
+    static volatile uint8_t _head;        // Куда будет записан следующий блок
+    static volatile uint8_t _tail;        // Самый старый блок
+    static volatile bool _tail_running;   // Самый старый блок выполняется движком
+    static long _position[STEP_ENGINE_MAX_AXES];
+    static float _prev_unit[STEP_ENGINE_MAX_AXES]; // Направление последнего блока
+    static float _prev_nominal_sqr;
+    static uint32_t _last_append;   // Время постановки последнего блока (мс)
+    static uint8_t _enabled_axes;   // Оси, драйверы которых включены планировщиком
+};
+
+#endif
@@ -0,0 +1,153 @@
+#include "Probe.h"
+#include "StepperMotor.h"
+#include "Endstops.h"
+#include "Planner.h"
+#include "AxisGroup.h"
+#include "Console.h"
+#include "Log.h"
+
+uint8_t Probe::_pin = 0xFF;
+#if defined(__AVR__)
+volatile uint8_t* Probe::_in = NULL;
+uint8_t Probe::_mask = 0;
+#endif
+bool Probe::_busy = false;
+bool Probe::_require_contact = false;
+volatile bool Probe::_armed = false;
+volatile bool Probe::_triggered = false;
+volatile int32_t Probe::_position[STEP_ENGINE_MAX_AXES];
+
+bool Probe::setPin(uint8_t pin) {
+#if defined(__AVR__)
+    if (pin < 2 || pin >= NUM_DIGITAL_PINS || digitalPinToPCICR(pin) == 0) return false;
+#elif defined(ARDUINO_SIM)
+    if (pin < 2 || pin >= SIM_PIN_COUNT) return false;
+#else
+    if (pin < 2) return false;
+#endif
+    // Подтяжка на ENA/DIR/PUL сбила бы драйвер оси
+    if (AxisGroup::drivesPin(pin)) return false;
+    pinMode(pin, INPUT_PULLUP);
+    noInterrupts();
+    _pin = pin;
+#if defined(__AVR__)
+    _in = portInputRegister(digitalPinToPort(pin));
+    _mask = digitalPinToBitMask(pin);
+#endif
+    interrupts();
+    // Прерывание прежнего пина остаётся включённым - щуп на нём не взведён
+    Endstops::watch(pin);
+    return true;
+}
+
+bool Probe::read() {
+    if (_pin == 0xFF) return false;
+#if defined(__AVR__)
+    return !(*_in & _mask);
+#else
+    return digitalRead(_pin) == LOW;
+#endif
+}
+
+bool Probe::start(const long target[STEP_ENGINE_MAX_AXES], long feed, bool feed_mm, bool require_contact) {
+    if (_busy || _pin == 0xFF) {
+        return false;
+    }
+    // Взводим до постановки блока: касание на первом же шаге не теряется
+    noInterrupts();
+    bool active = read();
+    _triggered = false;
+    _armed = !active;
+    interrupts();
+    if (active) {
+        Log::event(LOG_PROBE_ACTIVE);
+        return false;
+    }
+    if (!Planner::line(target, feed, feed_mm)) {
+        _armed = false;
+        return false;
+    }
+    _busy = true;
+    _require_contact = require_contact;
+    return true;
+}
+
+// Вызывается из прерывания PCINT: позиции - на момент касания, шаг,
+// подготовленный на следующий такт, уже после касания и в них не входит
+void Probe::handleChange() {
+    if (!_armed || !read()) {
+        return;
+    }
+    for (uint8_t i = 0; i < StepEngine::axisCount(); i++) {
+        _position[i] = StepEngine::motor(i)->_current_pos;
+    }
+    _armed = false;
+    _triggered = true;
+    StepEngine::stopLine();
+}
+
+void Probe::update() {
+    if (!_busy) {
+        return;
+    }
+    if (!_triggered) {
+        if (Planner::isBusy() || StepEngine::lineBusy()) {
+            return;
+        }
+        noInterrupts();
+        _armed = false;
+        bool contact = _triggered;
+        interrupts();
+        // Конечная точка достигнута без касания
+        if (!contact) {
+            finish(false);
+            return;
+        }
+    }
+    if (StepEngine::lineBusy()) {
+        // Касание до запуска блока: движок не начал торможение сам
+        if (StepEngine::holdState() == HOLD_NONE) {
+            StepEngine::feedHold();
+        }
+        if (StepEngine::holdState() != HOLD_STOPPED) {
+            return;
+        }
+    }
+    // Оси линии стоят: остаток блока отбрасывается без потери калибровки,
+    // остальные двигатели продолжают своё
+    StepEngine::cancelLine();
+    Planner::reset();
+    finish(true);
+}
+
+void Probe::finish(bool contact) {
+    _busy = false;
+    Console.print(F("[PRB:"));
+    for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+        if (i > 0) Console.print(',');
+        StepperMotor* motor = AxisGroup::motor(i);
+        Console.print(contact ? (long)_position[motor->getAxis()] : motor->getCurrentPosition());
+    }
+    Console.print(':');
+    Console.print(contact ? 1 : 0);
+    Console.println(']');
+    if (!contact && _require_contact) {
+        Log::event(LOG_PROBE_FAILED);
+    }
+}
+
+bool Probe::isBusy() {
+    return _busy;
+}
+
+bool Probe::isTriggered() {
+    return _busy && _triggered;
+}
+
+void Probe::reset() {
+    noInterrupts();
+    _armed = false;
+    _triggered = false;
+    interrupts();
+    _busy = false;
+}
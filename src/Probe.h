@@ -0,0 +1,66 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <Arduino.h>
+#include "StepEngine.h"
+
+// Щуп (G38.2/G38.3): координированное перемещение до касания.
+//
+// Вход щупа обслуживается прерыванием PCINT концевиков (Endstops): в
+// момент касания прерывание запоминает позиции всех осей и начинает
+// торможение с ускорением блока (StepEngine::stopLine()). Запомненная
+// позиция отстаёт от касания не больше чем на шаг и не зависит ни от
+// скорости подхода, ни от loop(). Остаток перемещения отбрасывается в
+// update() после остановки (StepEngine::cancelLine()); двигатели вне
+// перемещения щупа не останавливаются и не выключаются.
+//
+// Активный уровень - LOW, как у концевиков: щуп можно подключить и к
+// пину концевика оси.
+class Probe {
+public:
+    // Вход щупа ($6). Пин с прерыванием PCINT, кроме 0 и 1 (Serial) и
+    // выходов драйверов осей AxisGroup. false - пин не годится.
+    static bool setPin(uint8_t pin);
+
+    // Перемещение в target (шаги по осям движка) с подачей как у
+    // Planner::line() до касания. require_contact (G38.2) - отсутствие
+    // касания считается ошибкой. false - щуп уже замкнут или перемещение
+    // не встало в очередь. Очередь Planner должна быть пуста.
+    static bool start(const long target[STEP_ENGINE_MAX_AXES], long feed, bool feed_mm, bool require_contact);
+
+    // Обслуживание - должно вызываться в loop() после Planner::update().
+    // По окончании выводит [PRB:x,y:1] (позиция касания) или [PRB:...:0].
+    static void update();
+
+    // Выполняется ли перемещение со щупом
+    static bool isBusy();
+
+    // Было ли касание в текущем перемещении: удержание, начатое
+    // касанием, нельзя продолжить
+    static bool isTriggered();
+
+    // Отмена без отчёта (сброс Ctrl-X)
+    static void reset();
+
+    // Замкнут ли щуп
+    static bool read();
+
+    // Обработка изменения пинов - вызывается из прерывания Endstops
+    static void handleChange();
+
+private:
+    static void finish(bool contact);
+
+    static uint8_t _pin;
+#if defined(__AVR__)
+    static volatile uint8_t* _in; // Регистр входа пина щупа
+    static uint8_t _mask;
+#endif
+    static bool _busy;
+    static bool _require_contact;
+    static volatile bool _armed;     // Касание остановит движение
+    static volatile bool _triggered; // Касание было, позиция запомнена
+    static volatile int32_t _position[STEP_ENGINE_MAX_AXES]; // Позиции осей движка при касании
+};
+
+#endif
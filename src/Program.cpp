@@ -0,0 +1,320 @@
+#include "Program.h"
+#include <EEPROM.h>
+#include "AxisGroup.h"
+#include "Arc.h"
+#include "BinaryLink.h"
+#include "Console.h"
+#include "Log.h"
+#include "Planner.h"
+
+#if defined(E2END)
+static_assert(PROGRAM_BODY_START + PROGRAM_RECORD_SIZE <= E2END + 1,
+    "Для программы не осталось места в EEPROM");
+#endif
+
+// Предел значения со смещением - как у числа из строки
+#define PROGRAM_VALUE_LIMIT ((int64_t)GCODE_MAX_INTEGER * GCODE_SCALE)
+
+uint8_t Program::_state = PROGRAM_IDLE;
+uint16_t Program::_bytes = 0;
+uint16_t Program::_lines = 0;
+uint16_t Program::_crc = 0xFFFF;
+uint16_t Program::_addr = 0;
+uint16_t Program::_line_number = 0;
+bool Program::_failed = false;
+uint32_t Program::_loop = 0;
+uint32_t Program::_loops = 0;
+int32_t Program::_offset[2] = { 0, 0 };
+int32_t Program::_step[2] = { 0, 0 };
+GCodeCommand Program::_command;
+
+static const char WORDS[] PROGMEM = PROGRAM_WORDS;
+
+static char programWord(uint8_t i) {
+    return pgm_read_byte(&WORDS[i]);
+}
+
+static uint16_t readWord(uint16_t addr) {
+    return EEPROM.read(addr) | (EEPROM.read(addr + 1) << 8);
+}
+
+// Значение переменной длины с адреса addr (от начала строк), addr - за ним
+static int32_t readValue(uint16_t& addr, uint8_t mask) {
+    uint32_t v = 0;
+    uint8_t shift = 0;
+    uint8_t c;
+    do {
+        c = EEPROM.read(PROGRAM_BODY_START + addr++);
+        v |= (uint32_t)(c & 0x7F) << shift;
+        shift += 7;
+    } while (c & 0x80);
+    int32_t value = (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+    return (mask & PROGRAM_WHOLE) ? value * GCODE_SCALE : value;
+}
+
+// CRC заголовка без самой CRC - после CRC строк
+static uint16_t headerCrc(uint16_t crc, uint16_t bytes, uint16_t lines) {
+    uint8_t header[5] = { PROGRAM_VERSION, (uint8_t)bytes, (uint8_t)(bytes >> 8),
+        (uint8_t)lines, (uint8_t)(lines >> 8) };
+    for (uint8_t i = 0; i < 5; i++) {
+        crc = BinaryLink::crcUpdate(crc, header[i]);
+    }
+    return crc;
+}
+
+// Команды, которые имеют смысл без ПК: перемещения, единицы, калибровка
+static bool storable(const GCodeCommand& cmd) {
+    return cmd.isCode('G', 1) || cmd.isCode('G', 2) || cmd.isCode('G', 3) ||
+        cmd.isCode('G', 21) || cmd.isCode('G', 22) || cmd.isCode('G', 28);
+}
+
+uint16_t Program::capacity() {
+    return E2END + 1 - PROGRAM_BODY_START;
+}
+
+void Program::begin() {
+    _state = PROGRAM_IDLE;
+    _bytes = 0;
+    _lines = 0;
+    if (EEPROM.read(PROGRAM_EEPROM_START) != PROGRAM_VERSION) {
+        return;
+    }
+    uint16_t bytes = readWord(PROGRAM_EEPROM_START + 1);
+    uint16_t lines = readWord(PROGRAM_EEPROM_START + 3);
+    if (bytes == 0 || bytes > capacity()) {
+        return;
+    }
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 0; i < bytes; i++) {
+        crc = BinaryLink::crcUpdate(crc, EEPROM.read(PROGRAM_BODY_START + i));
+    }
+    if (headerCrc(crc, bytes, lines) != readWord(PROGRAM_EEPROM_START + 5)) {
+        return;
+    }
+    _bytes = bytes;
+    _lines = lines;
+}
+
+bool Program::record() {
+    if (isRunning()) {
+        return false;
+    }
+    // Версия стирается первой: новые строки ложатся на место прежних
+    EEPROM.update(PROGRAM_EEPROM_START, 0xFF);
+    _bytes = 0;
+    _lines = 0;
+    _addr = 0;
+    _crc = 0xFFFF;
+    _failed = false;
+    _state = PROGRAM_RECORDING;
+    Log::event(LOG_PROGRAM_RECORDING);
+    return true;
+}
+
+bool Program::isRecording() {
+    return _state == PROGRAM_RECORDING;
+}
+
+bool Program::append(const GCodeCommand& cmd) {
+    if (_state != PROGRAM_RECORDING) {
+        return false;
+    }
+    uint32_t allowed = 1UL << GCodeCommand::index('G');
+    uint8_t mask = PROGRAM_WHOLE;
+    for (uint8_t i = 0; i < PROGRAM_WORD_COUNT; i++) {
+        if (!cmd.has(programWord(i))) continue;
+        allowed |= 1UL << GCodeCommand::index(programWord(i));
+        mask |= 1 << i;
+        if (cmd.value(programWord(i)) % GCODE_SCALE != 0) mask &= ~PROGRAM_WHOLE;
+    }
+    // Строка с другими словами выполнялась бы иначе, чем записана
+    if (!storable(cmd) || (cmd.words & ~allowed) != 0) {
+        Log::event(LOG_PROGRAM_UNSUPPORTED);
+        _failed = true;
+        return false;
+    }
+
+    uint8_t record[PROGRAM_RECORD_SIZE];
+    uint8_t size = 0;
+    record[size++] = cmd.integer('G');
+    record[size++] = mask;
+    for (uint8_t i = 0; i < PROGRAM_WORD_COUNT; i++) {
+        if (!(mask & (1 << i))) continue;
+        int32_t value = cmd.value(programWord(i));
+        if (mask & PROGRAM_WHOLE) value /= GCODE_SCALE;
+        // Знак - в младшем бите, малые числа любого знака - в одном байте
+        uint32_t v = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+        while (v >= 0x80) {
+            record[size++] = (uint8_t)v | 0x80;
+            v >>= 7;
+        }
+        record[size++] = (uint8_t)v;
+    }
+    if (_addr + size > capacity()) {
+        Log::event(LOG_PROGRAM_FULL, capacity());
+        _failed = true;
+        return false;
+    }
+    for (uint8_t i = 0; i < size; i++) {
+        EEPROM.update(PROGRAM_BODY_START + _addr + i, record[i]);
+        _crc = BinaryLink::crcUpdate(_crc, record[i]);
+    }
+    _addr += size;
+    _lines++;
+    return true;
+}
+
+bool Program::finish() {
+    if (_state != PROGRAM_RECORDING) {
+        return false;
+    }
+    _state = PROGRAM_IDLE;
+    // Программа с пропущенными строками не сохраняется
+    if (_failed || _lines == 0) {
+        Log::event(LOG_PROGRAM_MISSING);
+        return false;
+    }
+    uint16_t crc = headerCrc(_crc, _addr, _lines);
+    EEPROM.update(PROGRAM_EEPROM_START + 1, (uint8_t)_addr);
+    EEPROM.update(PROGRAM_EEPROM_START + 2, (uint8_t)(_addr >> 8));
+    EEPROM.update(PROGRAM_EEPROM_START + 3, (uint8_t)_lines);
+    EEPROM.update(PROGRAM_EEPROM_START + 4, (uint8_t)(_lines >> 8));
+    EEPROM.update(PROGRAM_EEPROM_START + 5, crc & 0xFF);
+    EEPROM.update(PROGRAM_EEPROM_START + 6, crc >> 8);
+    // Версия - последней: до неё программа недействительна
+    EEPROM.update(PROGRAM_EEPROM_START, PROGRAM_VERSION);
+    _bytes = _addr;
+    Log::event(LOG_PROGRAM_STORED, _lines, _bytes);
+    return true;
+}
+
+bool Program::start(uint32_t loops, const int32_t offset[2], const int32_t step[2]) {
+    if (_bytes == 0 || _state != PROGRAM_IDLE) {
+        Log::event(LOG_PROGRAM_MISSING);
+        return false;
+    }
+    _loops = loops;
+    _loop = 0;
+    _addr = 0;
+    _line_number = 0;
+    for (uint8_t i = 0; i < 2; i++) {
+        _offset[i] = offset[i];
+        _step[i] = step[i];
+    }
+    _state = PROGRAM_RUNNING;
+    return load();
+}
+
+bool Program::isRunning() {
+    return _state == PROGRAM_RUNNING || _state == PROGRAM_FINISHING;
+}
+
+bool Program::hasLine() {
+    return _state == PROGRAM_RUNNING;
+}
+
+const GCodeCommand& Program::line() {
+    return _command;
+}
+
+void Program::next(uint8_t error) {
+    if (_state != PROGRAM_RUNNING) {
+        return;
+    }
+    if (error != 0) {
+        Log::event(LOG_PROGRAM_STOPPED, _line_number, error);
+        _state = PROGRAM_IDLE;
+        return;
+    }
+    if (_addr >= _bytes) {
+        _addr = 0;
+        _line_number = 0;
+        if (++_loop >= _loops) {
+            _state = PROGRAM_FINISHING;
+            return;
+        }
+    }
+    load();
+}
+
+void Program::update() {
+    if (_state != PROGRAM_FINISHING) {
+        return;
+    }
+    if (Planner::isBusy() || Arc::isBusy() || StepEngine::lineBusy() || AxisGroup::isBusy()) {
+        return;
+    }
+    _state = PROGRAM_IDLE;
+    Log::event(LOG_PROGRAM_DONE, _loops);
+}
+
+void Program::reset() {
+    // Прерванная запись оставляет программу недействительной
+    _state = PROGRAM_IDLE;
+}
+
+// Строка с адреса addr (от начала строк) - в cmd. Возвращает её длину.
+uint16_t Program::decode(uint16_t addr, GCodeCommand& cmd) {
+    uint16_t start = addr;
+    uint8_t code = EEPROM.read(PROGRAM_BODY_START + addr++);
+    uint8_t mask = EEPROM.read(PROGRAM_BODY_START + addr++);
+    cmd.clear();
+    cmd.set('G', code * GCODE_SCALE);
+    for (uint8_t i = 0; i < PROGRAM_WORD_COUNT; i++) {
+        if (!(mask & (1 << i))) continue;
+        cmd.set(programWord(i), readValue(addr, mask));
+    }
+    return addr - start;
+}
+
+// Следующая строка со смещением текущего повтора - один раз, до next()
+bool Program::load() {
+    _addr += decode(_addr, _command);
+    _line_number++;
+    if (!(_command.isCode('G', 1) || _command.isCode('G', 2) || _command.isCode('G', 3))) {
+        return true;
+    }
+    const char letters[2] = { 'X', 'Y' };
+    for (uint8_t i = 0; i < 2; i++) {
+        if (!_command.has(letters[i])) continue;
+        int64_t value = (int64_t)_command.value(letters[i]) + _offset[i] + (int64_t)_step[i] * _loop;
+        if (value > PROGRAM_VALUE_LIMIT || value < -PROGRAM_VALUE_LIMIT) {
+            Log::event(LOG_PROGRAM_STOPPED, _line_number, GCODE_ERROR_OVERFLOW);
+            _state = PROGRAM_IDLE;
+            return false;
+        }
+        _command.set(letters[i], (int32_t)value);
+    }
+    return true;
+}
+
+// Число в фиксированной точке: дробная часть - без нулей в конце
+static void printValue(int32_t value) {
+    uint32_t v = value < 0 ? 0UL - (uint32_t)value : (uint32_t)value;
+    if (value < 0) Console.print('-');
+    Console.print(v / GCODE_SCALE);
+    uint16_t fraction = v % GCODE_SCALE;
+    if (fraction == 0) return;
+    Console.print('.');
+    for (uint16_t digit = GCODE_SCALE / 10; digit > 0 && fraction > 0; digit /= 10) {
+        Console.print((char)('0' + fraction / digit));
+        fraction %= digit;
+    }
+}
+
+// Текст - прямо из EEPROM, без GCodeCommand на стеке
+void Program::list() {
+    for (uint16_t addr = 0; addr < _bytes; ) {
+        uint8_t code = EEPROM.read(PROGRAM_BODY_START + addr++);
+        uint8_t mask = EEPROM.read(PROGRAM_BODY_START + addr++);
+        Console.print('G');
+        Console.print(code);
+        for (uint8_t i = 0; i < PROGRAM_WORD_COUNT; i++) {
+            if (!(mask & (1 << i))) continue;
+            Console.print(' ');
+            Console.print(programWord(i));
+            printValue(readValue(addr, mask));
+        }
+        Console.println();
+    }
+}
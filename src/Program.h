@@ -0,0 +1,121 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <Arduino.h>
+#include "GCodeParser.h"
+#include "Settings.h"
+
+// Сохранённая программа: короткая повторяющаяся работа записывается в
+// EEPROM один раз и выполняется контроллером сам, без ПК.
+//
+// Строки G между M880 и M881 не выполняются, а сохраняются уже
+// разобранными: номер G, байт слов и значения переменной длины (zigzag,
+// по 7 бит в байте). "G1 X3000 Y1500 F6000" занимает 8 байт вместо 21.
+// При выполнении (M882) запись превращается обратно в GCodeCommand и идёт
+// тем же путём, что и строки с ПК, но без разбора текста и без обмена
+// с хостом на каждую строку: время цикла не зависит от связи. Текущая
+// строка разбирается из EEPROM один раз, в свою команду программы: строка
+// хоста в общей команде GCodeParser и BinaryLink её ждёт не мешая.
+//
+// Подстановка параметров - смещение X/Y всех G1/G2/G3 программы,
+// растущее на заданный шаг с каждым повтором (ряд одинаковых деталей).
+//
+// Заголовок пишется последним, при M881: прерванная или сброшенная
+// запись не оставляет в EEPROM испорченной программы, но прежняя при
+// этом теряется - её место занято новыми строками.
+
+// Версия формата: программы другой версии не загружаются
+#define PROGRAM_VERSION 1
+
+// Программа лежит сразу за кольцами настроек
+#define PROGRAM_EEPROM_START SETTINGS_EEPROM_END
+
+// Заголовок: версия, байт строк (2), строк (2), CRC16 (2)
+#define PROGRAM_HEADER_SIZE 7
+
+// Строки - до конца EEPROM: на Nano 1024 - 636 - 7 = 381 байт,
+// 47 строк вида "G1 X3000 Y1500 F6000"
+#define PROGRAM_BODY_START (PROGRAM_EEPROM_START + PROGRAM_HEADER_SIZE)
+
+// Слова, которые сохраняются в строке, - по биту в байте слов
+#define PROGRAM_WORDS "XYFIJR"
+#define PROGRAM_WORD_COUNT 6
+
+// Бит байта слов: все значения целые и хранятся без множителя GCODE_SCALE
+#define PROGRAM_WHOLE 0x80
+
+// Наибольшая запись: номер G, байт слов, по 5 байт на значение
+#define PROGRAM_RECORD_SIZE (2 + PROGRAM_WORD_COUNT * 5)
+
+class Program {
+public:
+    // Проверка программы в EEPROM - после Settings::begin()
+    static void begin();
+
+    // M880: следующие строки G сохраняются вместо выполнения.
+    // Прежняя программа перестаёт быть действительной.
+    static bool record();
+
+    // Идёт ли запись
+    static bool isRecording();
+
+    // Сохранение строки во время записи. false - команда не сохраняется
+    // (G1/G2/G3/G21/G22/G28 со словами PROGRAM_WORDS) или не помещается.
+    static bool append(const GCodeCommand& cmd);
+
+    // M881: конец записи, программа становится действительной
+    static bool finish();
+
+    // M882: выполнение loops раз. offset - смещение X/Y (в единицах
+    // 1/GCODE_SCALE единиц программы), step - его приращение на повтор.
+    // false - нет программы.
+    static bool start(uint32_t loops, const int32_t offset[2], const int32_t step[2]);
+
+    // Выполняется ли программа (до остановки последнего перемещения)
+    static bool isRunning();
+
+    // Есть ли строка, ожидающая выполнения
+    static bool hasLine();
+
+    // Строка, ожидающая выполнения, со смещением
+    static const GCodeCommand& line();
+
+    // Строка выполнена: error - 0 или код ошибки, останавливающий программу
+    static void next(uint8_t error);
+
+    // Завершение программы после последнего перемещения - в loop()
+    static void update();
+
+    // Отмена записи или выполнения (сброс Ctrl-X)
+    static void reset();
+
+    // M883: текст сохранённой программы
+    static void list();
+
+private:
+    enum State {
+        PROGRAM_IDLE,
+        PROGRAM_RECORDING,
+        PROGRAM_RUNNING,   // Строки ставятся в очередь
+        PROGRAM_FINISHING  // Все строки поставлены, ждём остановки
+    };
+
+    static uint16_t decode(uint16_t addr, GCodeCommand& cmd);
+    static bool load();
+    static uint16_t capacity();
+
+    static uint8_t _state;
+    static uint16_t _bytes;       // Длина действительной программы, 0 - нет
+    static uint16_t _lines;
+    static uint16_t _crc;         // CRC записываемых строк
+    static uint16_t _addr;        // Следующая строка (от начала строк)
+    static uint16_t _line_number; // Номер строки для сообщений, с 1
+    static bool _failed;          // При записи была отвергнута строка
+    static uint32_t _loop;        // Текущий повтор, с 0
+    static uint32_t _loops;
+    static int32_t _offset[2];
+    static int32_t _step[2];
+    static GCodeCommand _command; // Текущая строка, уже со смещением
+};
+
+#endif
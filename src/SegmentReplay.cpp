@@ -0,0 +1,147 @@
+#include "SegmentReplay.h"
+#include "StepperMotor.h"
+#include "Planner.h"
+#include "Log.h"
+
+volatile uint8_t SegmentReplay::_head = 0;
+volatile uint8_t SegmentReplay::_tail = 0;
+volatile bool SegmentReplay::_tail_running = false;
+bool SegmentReplay::_running = false;
+bool SegmentReplay::_flush = false;
+uint32_t SegmentReplay::_last_append = 0;
+uint8_t SegmentReplay::_enabled_axes = 0;
+
+static_assert(REPLAY_BUFFER_SIZE <= PLANNER_BUFFER_SIZE, "Очередь отрезков - в местах очереди Planner");
+
+uint8_t SegmentReplay::nextIndex(uint8_t index) {
+    return index + 1 < REPLAY_BUFFER_SIZE ? index + 1 : 0;
+}
+
+bool SegmentReplay::push(const ReplaySegment& segment) {
+    uint8_t count = StepEngine::axisCount();
+    uint32_t events = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (segment.steps[i] == 0) continue;
+        StepperMotor* motor = StepEngine::motor(i);
+        if (!motor->isCalibrated()) {
+            Log::event(LOG_NOT_CALIBRATED);
+            return false;
+        }
+        uint32_t steps = labs(segment.steps[i]);
+        if (steps > events) events = steps;
+    }
+    if (events == 0) {
+        return false;
+    }
+
+    while (isFull()) {
+        update();
+    }
+
+    // Одна фаза профиля: разгон до end_hz, торможение с первого шага
+    // до end_hz или равномерное движение
+    MotionBlock& block = Planner::sharedBlock(_head);
+    block.dir_negative = 0;
+    for (uint8_t i = 0; i < STEP_ENGINE_MAX_AXES; i++) {
+        long steps = i < count ? segment.steps[i] : 0;
+        block.steps[i] = labs(steps);
+        if (steps < 0) block.dir_negative |= (1 << i);
+    }
+    block.step_event_count = events;
+    uint32_t start_rate = StepEngine::rateFromHz(segment.start_hz);
+    uint32_t end_rate = StepEngine::rateFromHz(segment.end_hz);
+    block.entry_rate = start_rate;
+    block.exit_rate = end_rate;
+    block.accel = segment.accel;
+    if (end_rate > start_rate) {
+        block.cruise_rate = end_rate;
+        block.decel_steps = 0;
+    } else {
+        block.cruise_rate = start_rate;
+        block.decel_steps = end_rate < start_rate ? events : 0;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (block.steps[i] == 0 || (_enabled_axes & (1 << i))) continue;
+        StepEngine::motor(i)->enable();
+        _enabled_axes |= (1 << i);
+    }
+    _last_append = millis();
+    _head = nextIndex(_head);
+    return true;
+}
+
+void SegmentReplay::reset() {
+    noInterrupts();
+    _tail = _head;
+    _tail_running = false;
+    interrupts();
+    _running = false;
+    _flush = false;
+    _enabled_axes = 0;
+}
+
+void SegmentReplay::flush() {
+    _flush = true;
+}
+
+bool SegmentReplay::isBusy() {
+    return _head != _tail || _running;
+}
+
+bool SegmentReplay::isFull() {
+    return nextIndex(_head) == _tail;
+}
+
+uint8_t SegmentReplay::freeSlots() {
+    uint8_t used = _head >= _tail ? _head - _tail : _head + REPLAY_BUFFER_SIZE - _tail;
+    return REPLAY_BUFFER_SIZE - 1 - used;
+}
+
+const MotionBlock* SegmentReplay::nextBlock() {
+    if (_tail_running) {
+        _tail = nextIndex(_tail);
+        _tail_running = false;
+    }
+    if (_tail == _head) {
+        return NULL;
+    }
+    _tail_running = true;
+    return &Planner::sharedBlock(_tail);
+}
+
+void SegmentReplay::update() {
+    // При удержании подачи следующий блок ждёт resume()
+    if (StepEngine::lineBusy() || StepEngine::holdState() != HOLD_NONE) {
+        return;
+    }
+
+    if (_head != _tail) {
+        // Как у Planner: запуск при заполненной очереди или после паузы,
+        // чтобы поток отрезков не прерывался остановками
+        if (!_flush && !isFull() && millis() - _last_append < PLANNER_START_DELAY_MS) {
+            return;
+        }
+        noInterrupts();
+        const MotionBlock* block = nextBlock();
+        interrupts();
+        if (block != NULL) {
+            _running = StepEngine::startLine(block, nextBlock);
+        }
+        return;
+    }
+
+    _running = false;
+    _flush = false;
+    if (_enabled_axes == 0) {
+        return;
+    }
+    // Очередь выполнена - выключаем драйверы
+    for (uint8_t i = 0; i < StepEngine::axisCount(); i++) {
+        if (_enabled_axes & (1 << i)) {
+            StepperMotor* motor = StepEngine::motor(i);
+            if (!motor->isBusy()) motor->disable();
+        }
+    }
+    _enabled_axes = 0;
+}
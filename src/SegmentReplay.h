@@ -0,0 +1,66 @@
+#ifndef SEGMENT_REPLAY_H
+#define SEGMENT_REPLAY_H
+
+#include <Arduino.h>
+#include "StepEngine.h"
+
+// Размер очереди готовых отрезков. Своей памяти у очереди нет: блоки
+// лежат в местах очереди Planner (Planner::sharedBlock).
+#define REPLAY_BUFFER_SIZE 6
+
+// Отрезок, заранее рассчитанный на ПК (tools/segc): перемещение с
+// постоянным ускорением вдоль одной фазы профиля. Скорости - шагов/с
+// ведущей оси, ускорение уже в формате движка (Q8 за такт).
+struct ReplaySegment {
+    long steps[STEP_ENGINE_MAX_AXES]; // Шагов по осям со знаком
+    uint16_t start_hz;                // Скорость в начале отрезка
+    uint16_t end_hz;                  // Скорость в конце отрезка
+    uint32_t accel;                   // Ускорение (Q8)
+};
+
+// Воспроизведение отрезков, рассчитанных на ПК: планирование, стыки и
+// разгоны уже выполнены, контроллер только переводит отрезок в
+// MotionBlock и отдаёт движку. Вычислений с плавающей точкой нет.
+// Очередь не смешивается с Planner: G1/G2/G3/G28 ждут её выполнения,
+// а отрезки - опустения очереди Planner, поэтому места у них общие.
+class SegmentReplay {
+public:
+    // Постановка отрезка в очередь - только при пустой очереди Planner.
+    // Если очередь заполнена, ждёт освобождения места. Возвращает false
+    // для неоткалиброванной оси или отрезка без шагов.
+    static bool push(const ReplaySegment& segment);
+
+    // Запуск очереди без паузы (последний отрезок программы)
+    static void flush();
+
+    // Есть ли невыполненные отрезки
+    static bool isBusy();
+
+    // Заполнена ли очередь
+    static bool isFull();
+
+    // Число свободных мест в очереди
+    static uint8_t freeSlots();
+
+    // Обновление состояния - должно вызываться в loop()
+    static void update();
+
+    // Очистка очереди после StepEngine::abort()
+    static void reset();
+
+    // Следующий блок для движка - вызывается из прерывания
+    static const MotionBlock* nextBlock();
+
+private:
+    static uint8_t nextIndex(uint8_t index);
+
+    static volatile uint8_t _head;
+    static volatile uint8_t _tail;
+    static volatile bool _tail_running;
+    static bool _running;           // Движок запущен из этой очереди
+    static bool _flush;             // Запустить, не дожидаясь паузы
+    static uint32_t _last_append;   // Время постановки последнего отрезка (мс)
+    static uint8_t _enabled_axes;   // Оси, драйверы которых включены очередью
+};
+
+#endif
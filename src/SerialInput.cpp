@@ -0,0 +1,89 @@
+#include "SerialInput.h"
+#include "GCodeParser.h"
+
+uint8_t SerialInput::_buffer[SERIAL_RX_BUFFER_SIZE];
+uint8_t SerialInput::_head = 0;
+uint8_t SerialInput::_tail = 0;
+uint8_t SerialInput::_realtime = 0;
+bool SerialInput::_dropping = false;
+uint8_t SerialInput::_lost = 0;
+
+uint8_t SerialInput::nextIndex(uint8_t index) {
+    return index + 1 < SERIAL_RX_BUFFER_SIZE ? index + 1 : 0;
+}
+
+uint8_t SerialInput::used() {
+    return _head >= _tail ? _head - _tail : _head + SERIAL_RX_BUFFER_SIZE - _tail;
+}
+
+void SerialInput::push(uint8_t c) {
+    _buffer[_head] = c;
+    _head = nextIndex(_head);
+}
+
+// Строки, конец которых отброшен, завершаются по мере освобождения места
+void SerialInput::terminateLost() {
+    while (_lost > 0 && used() + 2 < SERIAL_RX_BUFFER_SIZE) {
+        push(GCODE_LINE_LOST);
+        push('\n');
+        _lost--;
+    }
+}
+
+void SerialInput::poll(bool intercept) {
+    terminateLost();
+    // Serial выбирается всегда: команда реального времени не должна ждать
+    // за строками, которым нет места
+    while (Serial.available() > 0) {
+        uint8_t c = Serial.read();
+        if (intercept) {
+            switch (c) {
+                case REALTIME_STATUS: _realtime |= REALTIME_FLAG_STATUS; continue;
+                case REALTIME_HOLD: _realtime |= REALTIME_FLAG_HOLD; continue;
+                case REALTIME_RESUME: _realtime |= REALTIME_FLAG_RESUME; continue;
+                case REALTIME_RESET: _realtime |= REALTIME_FLAG_RESET; continue;
+            }
+        }
+        // Байты после потерянного конца строки не должны его обогнать
+        if (_dropping || _lost > 0 || nextIndex(_head) == _tail) {
+            bool end = c == '\n' || c == '\r';
+            if (!_dropping && _lost == 0) {
+                // Переполнение: начало строки, возможно, уже в буфере
+                uint8_t last = _buffer[_head > 0 ? _head - 1 : SERIAL_RX_BUFFER_SIZE - 1];
+                _dropping = last != '\n' && last != '\r';
+            }
+            if (end && _dropping) _lost++;
+            _dropping = !end;
+            continue;
+        }
+        push(c);
+    }
+}
+
+bool SerialInput::available() {
+    return _head != _tail;
+}
+
+uint8_t SerialInput::read() {
+    uint8_t c = _buffer[_tail];
+    _tail = nextIndex(_tail);
+    return c;
+}
+
+uint8_t SerialInput::freeBytes() {
+    int pending = Serial.available();
+    int free = SERIAL_RX_BUFFER_SIZE - 1 - used() - pending;
+    return free > 0 ? free : 0;
+}
+
+uint8_t SerialInput::takeRealtime() {
+    uint8_t flags = _realtime;
+    _realtime = 0;
+    return flags;
+}
+
+void SerialInput::clear() {
+    _tail = _head;
+    _dropping = false;
+    _lost = 0;
+}
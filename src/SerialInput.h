@@ -0,0 +1,67 @@
+#ifndef SERIAL_INPUT_H
+#define SERIAL_INPUT_H
+
+#include <Arduino.h>
+
+// Размер приёмного буфера Serial (задаётся в platformio.ini). Хост может
+// держать в пути не больше этого числа байт неподтверждённых строк.
+#ifndef SERIAL_RX_BUFFER_SIZE
+#define SERIAL_RX_BUFFER_SIZE 64
+#endif
+
+// Однобайтовые команды реального времени (только в текстовом режиме:
+// в двоичных кадрах эти значения - обычные данные)
+#define REALTIME_STATUS '?'  // Отчёт о состоянии
+#define REALTIME_HOLD '!'    // Удержание подачи
+#define REALTIME_RESUME '~'  // Продолжение после удержания
+#define REALTIME_RESET 0x18  // Ctrl-X: сброс движения
+
+// Биты принятых команд реального времени
+enum RealtimeFlags {
+    REALTIME_FLAG_STATUS = 0x01,
+    REALTIME_FLAG_HOLD = 0x02,
+    REALTIME_FLAG_RESUME = 0x04,
+    REALTIME_FLAG_RESET = 0x08
+};
+
+// Приём байтов Serial в собственный буфер строк. Каждая итерация
+// loop() забирает из Serial всё принятое, даже если строка ждёт места в
+// очереди: команды реального времени вынимаются из потока до сборки
+// строк и выполняются сразу, остальные байты ждут разбора в буфере.
+// Если хост прислал больше, чем помещается, обычные байты отбрасываются
+// до конца строки, а сама строка завершается байтом GCODE_LINE_LOST:
+// она получает ответ с ошибкой, и счёт ответов у хоста не сбивается.
+class SerialInput {
+public:
+    // Перенос принятых байтов; intercept - перехватывать команды
+    // реального времени (в текстовом режиме)
+    static void poll(bool intercept);
+
+    // Есть ли байты для разбора и следующий байт
+    static bool available();
+    static uint8_t read();
+
+    // Свободное место для строк хоста (байт)
+    static uint8_t freeBytes();
+
+    // Принятые команды реального времени (RealtimeFlags), флаги сбрасываются
+    static uint8_t takeRealtime();
+
+    // Сброс недоразобранных байтов (Ctrl-X)
+    static void clear();
+
+private:
+    static uint8_t nextIndex(uint8_t index);
+    static uint8_t used();
+    static void push(uint8_t c);
+    static void terminateLost();
+
+    static uint8_t _buffer[SERIAL_RX_BUFFER_SIZE];
+    static uint8_t _head;
+    static uint8_t _tail;
+    static uint8_t _realtime;
+    static bool _dropping; // Отбрасывается конец строки
+    static uint8_t _lost;  // Строк без конца, ждущих GCODE_LINE_LOST
+};
+
+#endif
@@ -0,0 +1,307 @@
+#include "Settings.h"
+#include <EEPROM.h>
+#include "AxisGroup.h"
+#include "BinaryLink.h"
+#include "GCodeParser.h"
+#include "Console.h"
+#include "Log.h"
+#include "Probe.h"
+
+#if defined(E2END)
+static_assert(SETTINGS_EEPROM_END <= E2END + 1, "Кольца настроек не помещаются в EEPROM");
+#endif
+
+const SettingsData* Settings::_defaults = NULL;
+SettingsData Settings::_data;
+uint8_t Settings::_data_slot = SETTINGS_SLOTS - 1;
+uint16_t Settings::_data_sequence = 0xFFFF;
+uint8_t Settings::_position_slot = SETTINGS_POSITION_SLOTS - 1;
+uint16_t Settings::_position_sequence = 0xFFFF;
+bool Settings::_parked = false;
+
+void Settings::begin(const SettingsData& defaults) {
+    _defaults = &defaults;
+    int8_t slot = loadRecord(SETTINGS_EEPROM_START, SETTINGS_SLOTS, sizeof(SettingsData), &_data, _data_sequence);
+    if (slot < 0) {
+        memcpy_P(&_data, &defaults, sizeof(SettingsData));
+        _data_slot = SETTINGS_SLOTS - 1;
+        _data_sequence = 0xFFFF;
+        Log::event(LOG_SETTINGS_DEFAULTS);
+    } else {
+        _data_slot = slot;
+    }
+    apply();
+
+    SettingsPosition position;
+    slot = loadRecord(SETTINGS_POSITION_START, SETTINGS_POSITION_SLOTS, sizeof(SettingsPosition),
+        &position, _position_sequence);
+    if (slot < 0) {
+        _position_slot = SETTINGS_POSITION_SLOTS - 1;
+        _position_sequence = 0xFFFF;
+        _parked = false;
+        return;
+    }
+    _position_slot = slot;
+    _parked = position.axes != 0;
+    if (_parked && (_data.flags & SETTINGS_FLAG_RESUME)) {
+        // Драйверы держали оси, пока контроллер был выключен:
+        // позиция та же, калибровка не нужна
+        uint8_t restored = 0;
+        for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+            if (!(position.axes & (1 << i))) continue;
+            StepperMotor* motor = AxisGroup::motor(i);
+            if (motor->restorePosition(position.steps[i], AxisGroup::maxSteps(i))) {
+                motor->enable();
+                restored |= 1 << i;
+            }
+        }
+        Log::event(LOG_POSITION_RESTORED, restored);
+    }
+    // Позиция годится только для одного включения: после сбоя без
+    // парковки оси должны пройти G28
+    clearPosition();
+}
+
+const SettingsData& Settings::data() {
+    return _data;
+}
+
+// Настройки - в двигатели и таблицу осей
+void Settings::apply() {
+    for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+        StepperMotor* motor = AxisGroup::motor(i);
+        motor->setStepsPerMM(_data.steps_per_mm[i]);
+        motor->setSpeed(_data.speed_hz[i]);
+        motor->setAcceleration(_data.accel[i]);
+        motor->setHomingSpeed(_data.homing_hz, _data.locate_hz);
+        AxisGroup::setMaxSteps(i, _data.max_steps[i]);
+        motor->setInputShaper(_data.shaper_type[i], _data.shaper_hz[i], _data.shaper_damping[i]);
+    }
+    Probe::setPin(_data.probe_pin);
+}
+
+bool Settings::set(uint16_t number, int32_t value) {
+    long integer = value >= 0 ? (value + GCODE_SCALE / 2) / GCODE_SCALE
+        : -((-value + GCODE_SCALE / 2) / GCODE_SCALE);
+    uint8_t axis = number % 10;
+    bool valid = true;
+    if (number == SETTING_RESUME) {
+        valid = integer == 0 || integer == 1;
+        if (valid) _data.flags = integer ? _data.flags | SETTINGS_FLAG_RESUME : _data.flags & ~SETTINGS_FLAG_RESUME;
+    } else if (number == SETTING_PROBE_PIN) {
+        valid = integer >= 0 && integer <= 0xFF && Probe::setPin(integer);
+        if (valid) _data.probe_pin = integer;
+    } else if (number == SETTING_LOCATE_HZ) {
+        valid = integer >= 0 && integer < (long)STEP_ENGINE_TICK_HZ;
+        if (valid) _data.locate_hz = integer;
+    } else if (number == SETTING_HOMING_HZ) {
+        valid = integer > 0 && integer < (long)STEP_ENGINE_TICK_HZ;
+        if (valid) _data.homing_hz = integer;
+    } else if (number >= SETTING_STEPS_PER_MM && axis < AxisGroup::count()) {
+        switch (number - axis) {
+            case SETTING_STEPS_PER_MM:
+                valid = value > 0;
+                if (valid) _data.steps_per_mm[axis] = (float)value / GCODE_SCALE;
+                break;
+            case SETTING_SPEED_HZ:
+                valid = integer > 0 && integer < (long)STEP_ENGINE_TICK_HZ;
+                if (valid) _data.speed_hz[axis] = integer;
+                break;
+            case SETTING_ACCEL:
+                valid = integer >= 0;
+                if (valid) _data.accel[axis] = integer;
+                break;
+            case SETTING_MAX_STEPS:
+                valid = integer > 0;
+                if (valid) _data.max_steps[axis] = integer;
+                break;
+            case SETTING_SHAPER_TYPE:
+            case SETTING_SHAPER_HZ:
+            case SETTING_SHAPER_DAMPING: {
+                uint8_t type = _data.shaper_type[axis];
+                float hz = _data.shaper_hz[axis];
+                float damping = _data.shaper_damping[axis];
+                if (number - axis == SETTING_SHAPER_TYPE) {
+                    valid = integer >= 0 && integer < SHAPER_TYPE_COUNT;
+                    type = integer;
+                } else if (number - axis == SETTING_SHAPER_HZ) {
+                    hz = (float)value / GCODE_SCALE;
+                } else {
+                    damping = (float)value / GCODE_SCALE;
+                }
+                // Сочетание проверяет сам формирователь: задержка должна
+                // поместиться в его историю
+                valid = valid && hz > 0 && AxisGroup::motor(axis)->setInputShaper(type, hz, damping);
+                if (valid) {
+                    _data.shaper_type[axis] = type;
+                    _data.shaper_hz[axis] = hz;
+                    _data.shaper_damping[axis] = damping;
+                }
+                break;
+            }
+            default:
+                Log::event(LOG_SETTING_UNKNOWN, number);
+                return false;
+        }
+    } else {
+        Log::event(LOG_SETTING_UNKNOWN, number);
+        return false;
+    }
+    if (!valid) {
+        Log::event(LOG_SETTING_INVALID, number);
+        return false;
+    }
+    apply();
+    saveData();
+    return true;
+}
+
+static void printSetting(uint16_t number) {
+    Console.print('$');
+    Console.print(number);
+    Console.print('=');
+}
+
+void Settings::report() {
+    printSetting(SETTING_RESUME);
+    Console.println((_data.flags & SETTINGS_FLAG_RESUME) ? 1 : 0);
+    printSetting(SETTING_PROBE_PIN);
+    Console.println(_data.probe_pin);
+    printSetting(SETTING_LOCATE_HZ);
+    Console.println(_data.locate_hz);
+    printSetting(SETTING_HOMING_HZ);
+    Console.println(_data.homing_hz);
+    for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+        printSetting(SETTING_STEPS_PER_MM + i);
+        Console.println(_data.steps_per_mm[i], 3);
+    }
+    for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+        printSetting(SETTING_SPEED_HZ + i);
+        Console.println(_data.speed_hz[i]);
+    }
+    for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+        printSetting(SETTING_ACCEL + i);
+        Console.println(_data.accel[i]);
+    }
+    for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+        printSetting(SETTING_MAX_STEPS + i);
+        Console.println(_data.max_steps[i]);
+    }
+    for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+        printSetting(SETTING_SHAPER_TYPE + i);
+        Console.println(_data.shaper_type[i]);
+    }
+    for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+        printSetting(SETTING_SHAPER_HZ + i);
+        Console.println(_data.shaper_hz[i], 3);
+    }
+    for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+        printSetting(SETTING_SHAPER_DAMPING + i);
+        Console.println(_data.shaper_damping[i], 3);
+    }
+}
+
+void Settings::restoreDefaults() {
+    if (_defaults == NULL) return;
+    memcpy_P(&_data, _defaults, sizeof(SettingsData));
+    apply();
+    saveData();
+}
+
+bool Settings::park() {
+    SettingsPosition position;
+    memset(&position, 0, sizeof(position));
+    for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+        StepperMotor* motor = AxisGroup::motor(i);
+        if (!motor->isCalibrated()) continue;
+        position.axes |= 1 << i;
+        position.steps[i] = motor->getCurrentPosition();
+        // Драйвер держит ось до выключения
+        motor->enable();
+    }
+    if (position.axes == 0) {
+        Log::event(LOG_NOTHING_TO_PARK);
+        return false;
+    }
+    savePosition(position);
+    _parked = true;
+    Log::event(LOG_POSITION_SAVED, position.axes);
+    return true;
+}
+
+void Settings::clearPosition() {
+    if (!_parked) {
+        return;
+    }
+    SettingsPosition position;
+    memset(&position, 0, sizeof(position));
+    savePosition(position);
+    _parked = false;
+}
+
+bool Settings::isParked() {
+    return _parked;
+}
+
+void Settings::saveData() {
+    _data_slot = (_data_slot + 1) % SETTINGS_SLOTS;
+    _data_sequence++;
+    writeRecord(SETTINGS_EEPROM_START + _data_slot * SETTINGS_DATA_RECORD,
+        sizeof(SettingsData), &_data, _data_sequence);
+}
+
+void Settings::savePosition(const SettingsPosition& position) {
+    _position_slot = (_position_slot + 1) % SETTINGS_POSITION_SLOTS;
+    _position_sequence++;
+    writeRecord(SETTINGS_POSITION_START + _position_slot * SETTINGS_POSITION_RECORD,
+        sizeof(SettingsPosition), &position, _position_sequence);
+}
+
+// Поиск целой записи с наибольшим номером в кольце. Возвращает место
+// (-1 - целых записей нет), данные копируются в payload.
+int8_t Settings::loadRecord(uint16_t start, uint8_t slots, uint8_t size, void* payload, uint16_t& sequence) {
+    int8_t found = -1;
+    uint16_t record = size + SETTINGS_RECORD_OVERHEAD;
+    for (uint8_t slot = 0; slot < slots; slot++) {
+        uint16_t addr = start + slot * record;
+        if (EEPROM.read(addr) != SETTINGS_VERSION) continue;
+        uint16_t crc = 0xFFFF;
+        for (uint16_t i = 0; i < record - 2; i++) {
+            crc = BinaryLink::crcUpdate(crc, EEPROM.read(addr + i));
+        }
+        uint16_t stored = EEPROM.read(addr + record - 2) | (EEPROM.read(addr + record - 1) << 8);
+        if (crc != stored) continue;
+        uint16_t number = EEPROM.read(addr + 1) | (EEPROM.read(addr + 2) << 8);
+        // Номер идёт по кругу: сравнение по разности
+        if (found < 0 || (int16_t)(number - sequence) > 0) {
+            found = slot;
+            sequence = number;
+        }
+    }
+    if (found >= 0) {
+        uint16_t addr = start + found * record + 3;
+        uint8_t* bytes = (uint8_t*)payload;
+        for (uint8_t i = 0; i < size; i++) {
+            bytes[i] = EEPROM.read(addr + i);
+        }
+    }
+    return found;
+}
+
+// Запись: EEPROM.update() пропускает байты, которые не изменились.
+// CRC пишется последней - прерванная запись не проходит проверку.
+void Settings::writeRecord(uint16_t addr, uint8_t size, const void* payload, uint16_t sequence) {
+    uint8_t header[3] = { SETTINGS_VERSION, (uint8_t)sequence, (uint8_t)(sequence >> 8) };
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 0; i < 3; i++) {
+        EEPROM.update(addr + i, header[i]);
+        crc = BinaryLink::crcUpdate(crc, header[i]);
+    }
+    const uint8_t* bytes = (const uint8_t*)payload;
+    for (uint8_t i = 0; i < size; i++) {
+        EEPROM.update(addr + 3 + i, bytes[i]);
+        crc = BinaryLink::crcUpdate(crc, bytes[i]);
+    }
+    EEPROM.update(addr + 3 + size, crc & 0xFF);
+    EEPROM.update(addr + 4 + size, crc >> 8);
+}
@@ -0,0 +1,131 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <Arduino.h>
+#include "StepEngine.h"
+
+// Настройки станка ($N=значение) и позиция для быстрого запуска - в EEPROM.
+//
+// Каждая запись хранится кольцом из нескольких мест: новая версия пишется
+// в следующее место с номером на 1 больше, и при загрузке берётся
+// целая запись (верная CRC16) с наибольшим номером. Прерванная запись
+// не портит предыдущую, а износ распределяется по местам кольца.
+// Байты, не изменившиеся с прошлой записи в это место, не перезаписываются.
+
+// Версия формата записей: записи другой версии не загружаются
+#define SETTINGS_VERSION 3
+
+// Мест в кольцах настроек и позиции
+#define SETTINGS_SLOTS 4
+#define SETTINGS_POSITION_SLOTS 8
+
+// Начало области в EEPROM
+#define SETTINGS_EEPROM_START 0
+
+// Номера настроек ($N); настройки осей - база + номер оси в AxisGroup
+#define SETTING_RESUME 1         // $1: доверять позиции после парковки (0/1)
+#define SETTING_PROBE_PIN 6      // $6: пин щупа G38 (см. Probe.h)
+#define SETTING_LOCATE_HZ 24     // $24: медленный подход к концевику, Гц
+#define SETTING_HOMING_HZ 25     // $25: быстрый подход к концевику, Гц
+#define SETTING_STEPS_PER_MM 100 // $100...: шагов на мм
+#define SETTING_SPEED_HZ 110     // $110...: скорость, Гц
+#define SETTING_ACCEL 120        // $120...: ускорение, Гц/с
+#define SETTING_MAX_STEPS 130    // $130...: длина рейки, шаги
+#define SETTING_SHAPER_TYPE 140  // $140...: формирователь (ShaperType: 0 - нет, 1 - ZV, 2 - MZV, 3 - EI)
+#define SETTING_SHAPER_HZ 150    // $150...: частота резонанса, Гц
+#define SETTING_SHAPER_DAMPING 160 // $160...: доля критического затухания
+
+#define SETTINGS_FLAG_RESUME 0x01
+
+// Осей в записях. Раскладка EEPROM не зависит от STEP_ENGINE_MAX_AXES
+// сборки: запись, сделанная прошивкой на 4 оси, читается и прошивкой,
+// собранной на 2 (platformio.ini), и наоборот.
+#define SETTINGS_AXES 4
+
+static_assert(STEP_ENGINE_MAX_AXES <= SETTINGS_AXES, "Оси движка не помещаются в записи настроек");
+
+// Значения настроек. Поля фиксированной ширины: запись в EEPROM
+// побайтно совпадает со структурой.
+struct SettingsData {
+    float steps_per_mm[SETTINGS_AXES];
+    int32_t speed_hz[SETTINGS_AXES];
+    int32_t accel[SETTINGS_AXES];
+    int32_t max_steps[SETTINGS_AXES];
+    float shaper_hz[SETTINGS_AXES];
+    float shaper_damping[SETTINGS_AXES];
+    uint8_t shaper_type[SETTINGS_AXES];
+    int32_t homing_hz;
+    int32_t locate_hz; // 0 - в STEPPER_HOMING_LOCATE_DIVISOR раз медленнее быстрого
+    uint8_t probe_pin;
+    uint8_t flags;
+};
+
+// Позиция осей на момент парковки
+struct SettingsPosition {
+    uint8_t axes; // Биты осей AxisGroup с достоверной позицией, 0 - записи нет
+    int32_t steps[SETTINGS_AXES];
+};
+
+// Служебные байты записи: версия, номер (2 байта), CRC16 (2 байта)
+#define SETTINGS_RECORD_OVERHEAD 5
+
+// Раскладка EEPROM: кольцо настроек, за ним кольцо позиции
+#define SETTINGS_DATA_RECORD (sizeof(SettingsData) + SETTINGS_RECORD_OVERHEAD)
+#define SETTINGS_POSITION_RECORD (sizeof(SettingsPosition) + SETTINGS_RECORD_OVERHEAD)
+#define SETTINGS_POSITION_START (SETTINGS_EEPROM_START + SETTINGS_SLOTS * SETTINGS_DATA_RECORD)
+
+// Конец колец в EEPROM: дальше - сохранённая программа (Program.h).
+// На Nano (110 + 5) * 4 + (17 + 5) * 8 = 636 байт.
+#define SETTINGS_EEPROM_END (SETTINGS_POSITION_START + SETTINGS_POSITION_SLOTS * SETTINGS_POSITION_RECORD)
+
+class Settings {
+public:
+    // Загрузка настроек (или defaults, если в EEPROM нет целой записи),
+    // применение к осям AxisGroup и восстановление позиции после
+    // парковки. Вызывается до AxisGroup::begin(), чтобы драйверы
+    // восстановленных осей не выключались. defaults - во флеш-памяти
+    // (PROGMEM) и должны существовать всё время работы (M873).
+    static void begin(const SettingsData& defaults);
+
+    // Текущие значения
+    static const SettingsData& data();
+
+    // $N=значение (в единицах 1/GCODE_SCALE): проверка, применение и
+    // запись в EEPROM. false - нет такой настройки или значение недопустимо.
+    static bool set(uint16_t number, int32_t value);
+
+    // Вывод всех настроек ($$)
+    static void report();
+
+    // Возврат к значениям по умолчанию с записью (M873)
+    static void restoreDefaults();
+
+    // Парковка перед выключением (M874): позиция откалиброванных осей
+    // записывается как достоверная, драйверы остаются включены и держат
+    // оси. false - нет откалиброванных осей.
+    static bool park();
+
+    // Позиция больше не достоверна (оси сдвинулись после парковки).
+    // Запись в EEPROM - только если позиция была сохранена.
+    static void clearPosition();
+
+    // Сохранена ли позиция парковкой после включения
+    static bool isParked();
+
+private:
+    static void apply();
+    static void saveData();
+    static void savePosition(const SettingsPosition& position);
+    static int8_t loadRecord(uint16_t start, uint8_t slots, uint8_t size, void* payload, uint16_t& sequence);
+    static void writeRecord(uint16_t addr, uint8_t size, const void* payload, uint16_t sequence);
+
+    static const SettingsData* _defaults;
+    static SettingsData _data;
+    static uint8_t _data_slot;      // Место последней записи настроек
+    static uint16_t _data_sequence;
+    static uint8_t _position_slot;
+    static uint16_t _position_sequence;
+    static bool _parked;            // В EEPROM - достоверная позиция
+};
+
+#endif
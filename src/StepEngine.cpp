@@ -0,0 +1,625 @@
+#include "StepEngine.h"
+#include "StepperMotor.h"
+#include "Planner.h"
+#include "StepStats.h"
+#include "Bench.h"
+
+StepperMotor* StepEngine::_motors[STEP_ENGINE_MAX_AXES];
+uint8_t StepEngine::_count = 0;
+#if defined(__AVR__)
+volatile uint8_t* StepEngine::_pul_ports[STEP_ENGINE_MAX_AXES];
+uint8_t StepEngine::_pul_high[STEP_ENGINE_MAX_AXES];
+uint8_t StepEngine::_port_count = 0;
+#endif
+uint8_t StepEngine::_pulse_high = 0;
+uint8_t StepEngine::_turned = 0;
+const MotionBlock* StepEngine::_line = NULL;
+BlockSource StepEngine::_line_source = NULL;
+StepRamp StepEngine::_line_ramp;
+uint32_t StepEngine::_line_accum = 0;
+uint32_t StepEngine::_line_events = 0;
+int32_t StepEngine::_line_error[STEP_ENGINE_MAX_AXES];
+volatile bool StepEngine::_line_active = false;
+bool StepEngine::_line_dir_pending = false;
+volatile uint8_t StepEngine::_hold = HOLD_NONE;
+uint32_t StepEngine::_hold_rate = 0;
+uint8_t StepEngine::_shaper_phase = 0;
+InputShaper StepEngine::_shapers[STEP_ENGINE_SHAPERS];
+
+int8_t StepEngine::attach(StepperMotor* motor) {
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_motors[i] == motor) return i;
+    }
+    if (_count >= STEP_ENGINE_MAX_AXES) {
+        return -1;
+    }
+    if (_count == 0) {
+        setupTimer();
+    }
+#if defined(__AVR__)
+    // Пины PUL группируются по портам для одновременной записи фронтов
+    uint8_t port = 0;
+    while (port < _port_count && _pul_ports[port] != motor->_pul_out) port++;
+    if (port == _port_count) {
+        _pul_ports[_port_count++] = motor->_pul_out;
+    }
+    motor->_pul_port = port;
+#endif
+    _motors[_count] = motor;
+    return _count++;
+}
+
+InputShaper* StepEngine::takeShaper() {
+    for (uint8_t i = 0; i < STEP_ENGINE_SHAPERS; i++) {
+        if (!_shapers[i].isEnabled()) return &_shapers[i];
+    }
+    return NULL;
+}
+
+StepperMotor* StepEngine::motor(uint8_t axis) {
+    return axis < _count ? _motors[axis] : NULL;
+}
+
+uint8_t StepEngine::axisCount() {
+    return _count;
+}
+
+uint32_t StepEngine::rateFromHz(long speed_hz) {
+    if (speed_hz <= 0) return 0;
+    // Не больше одного шага за такт
+    if ((unsigned long)speed_hz >= STEP_ENGINE_TICK_HZ) return 0xFFFFFFFFUL;
+    return (uint32_t)speed_hz * STEP_RATE_PER_HZ;
+}
+
+void StepEngine::resetRamp(StepRamp& ramp, uint32_t start_rate, uint32_t cruise_rate,
+    uint32_t floor_rate, uint32_t accel, uint32_t jerk) {
+    ramp.cruise_rate = cruise_rate;
+    ramp.floor_rate = floor_rate;
+    ramp.accel = accel;
+    ramp.jerk = jerk;
+    ramp.jerk_dv = 0;
+    ramp.jerk_down = false;
+    ramp.decel_steps = 0;
+    ramp.mirror = true;
+    if (accel != 0 && start_rate < cruise_rate) {
+        // Разгон с начальной скорости
+        ramp.rate = start_rate;
+        ramp.acc = jerk != 0 ? 0 : accel;
+        ramp.phase = RAMP_ACCEL;
+    } else {
+        ramp.rate = cruise_rate;
+        ramp.acc = 0;
+        ramp.phase = RAMP_CRUISE;
+    }
+}
+
+bool StepEngine::startLine(const MotionBlock* block, BlockSource source) {
+    if (_line_active) {
+        return false;
+    }
+    _line_source = source != NULL ? source : Planner::nextBlock;
+
+    // Прерывание не трогает состояние линии, пока _line_active == false
+    loadBlock(block);
+    writeLineDirections();
+    // Первый шаг ведущей оси - на следующем такте
+    _line_accum = 0UL - _line_ramp.rate;
+    _line_active = true;
+    wake();
+    return true;
+}
+
+// Подготовка блока к выполнению. Фаза задающего накопителя сохраняется,
+// чтобы на стыке блоков не было лишней паузы.
+void StepEngine::loadBlock(const MotionBlock* block) {
+    _line = block;
+    resetRamp(_line_ramp, block->entry_rate, block->cruise_rate, block->exit_rate, block->accel, 0);
+    _line_ramp.mirror = false;
+    _line_ramp.decel_steps = block->decel_steps;
+    _line_events = block->step_event_count;
+    for (uint8_t i = 0; i < _count; i++) {
+        _line_error[i] = -(int32_t)(block->step_event_count >> 1);
+        StepperMotor* motor = _motors[i];
+        motor->_isr_line = block->steps[i] != 0;
+        if (block->steps[i] != 0) {
+            int8_t dir = (block->dir_negative & (1 << i)) ? -1 : 1;
+            // Направление оси с формирователем выставляет он сам
+            if (motor->_shaper != NULL) {
+                motor->_shaper->setCommandDir(dir);
+            } else {
+                motor->_isr_dir = dir;
+            }
+        }
+    }
+    _line_dir_pending = true;
+}
+
+// Спад импульсов, поднятых на прошлом такте
+void StepEngine::lowerPulses() {
+#if defined(__AVR__)
+    for (uint8_t p = 0; p < _port_count; p++) {
+        if (_pul_high[p]) *_pul_ports[p] &= ~_pul_high[p];
+        _pul_high[p] = 0;
+    }
+#else
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_pulse_high & (1 << i)) _motors[i]->pulseLow();
+    }
+#endif
+    _pulse_high = 0;
+}
+
+// Смена направления - только после спада импульса: в конце такта или,
+// если импульс ещё поднят, в начале следующего, перед его фронтами
+void StepEngine::writeDirections() {
+    if (_line_dir_pending) {
+        writeLineDirections();
+    }
+    for (uint8_t i = 0; _turned != 0; i++, _turned >>= 1) {
+        if (_turned & 1) {
+            _motors[i]->writeDirection(_motors[i]->_isr_dir > 0);
+        }
+    }
+}
+
+void StepEngine::writeLineDirections() {
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_line->steps[i] != 0 && _motors[i]->_shaper == NULL) {
+            _motors[i]->writeDirection(_motors[i]->_isr_dir > 0);
+        }
+    }
+    _line_dir_pending = false;
+}
+
+bool StepEngine::lineBusy() {
+    return _line_active || shaping();
+}
+
+// Формирователи ещё выдают шаги, заданные раньше
+bool StepEngine::shaping() {
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_motors[i]->shaping()) return true;
+    }
+    return false;
+}
+
+void StepEngine::feedHold() {
+    noInterrupts();
+    if (!_line_active || _hold != HOLD_NONE) {
+        interrupts();
+        return;
+    }
+    uint32_t accel = _line_ramp.accel;
+    interrupts();
+
+    // Останавливаемся на скорости, набираемой за один шаг: sqrt(2a)
+    long floor_hz = 0;
+    if (accel != 0) {
+        floor_hz = (long)sqrt(2.0 * accel / STEP_ACCEL_PER_HZ_S);
+    }
+    uint32_t floor_rate = rateFromHz(floor_hz);
+
+    noInterrupts();
+    if (_line_active && _hold == HOLD_NONE) {
+        _hold_rate = floor_rate;
+        _hold = HOLD_DECEL;
+        holdRamp(_line_ramp.rate);
+    }
+    interrupts();
+}
+
+void StepEngine::stopLine() {
+    if (!_line_active || _hold != HOLD_NONE) {
+        return;
+    }
+    // Торможение по времени доходит до нуля за rate / accel тактов
+    _hold_rate = 0;
+    _hold = HOLD_DECEL;
+    holdRamp(_line_ramp.rate);
+}
+
+void StepEngine::cancelLine() {
+    noInterrupts();
+    if (_hold == HOLD_STOPPED || !_line_active) {
+        _line_active = false;
+        _hold = HOLD_NONE;
+        for (uint8_t i = 0; i < _count; i++) {
+            _motors[i]->_isr_line = false;
+        }
+    }
+    interrupts();
+}
+
+// Торможение удержания от скорости rate (при запрещённых прерываниях)
+void StepEngine::holdRamp(uint32_t rate) {
+    _line_ramp.rate = rate;
+    if (rate <= _hold_rate || _line_ramp.accel == 0) {
+        _hold = HOLD_STOPPED;
+        return;
+    }
+    retargetRamp(_line_ramp, _hold_rate);
+}
+
+void StepEngine::resume() {
+    noInterrupts();
+    if (_hold != HOLD_NONE && _line_active) {
+        // Разгон до скорости блока с той скорости, на которой стоим или
+        // тормозим; торможение в конце блока - по его decel_steps
+        const MotionBlock* block = _line;
+        resetRamp(_line_ramp, _line_ramp.rate, block->cruise_rate, block->exit_rate, block->accel, 0);
+        _line_ramp.mirror = false;
+        _line_ramp.decel_steps = block->decel_steps;
+    }
+    _hold = HOLD_NONE;
+    interrupts();
+}
+
+uint8_t StepEngine::holdState() {
+    // Остановка - когда стоят и выходы формирователей
+    if (_hold == HOLD_STOPPED && shaping()) {
+        return HOLD_DECEL;
+    }
+    return _hold;
+}
+
+void StepEngine::abort() {
+    uint8_t lost = 0;
+    noInterrupts();
+    lowerPulses();
+    _turned = 0;
+    bool stepping = _line_active && _hold != HOLD_STOPPED;
+    _line_active = false;
+    _hold = HOLD_NONE;
+    for (uint8_t i = 0; i < _count; i++) {
+        StepperMotor* motor = _motors[i];
+        if (motor->_isr_running || (motor->_isr_line && stepping) || motor->shaping()) {
+            lost |= (1 << i);
+        }
+        if (motor->_shaper != NULL) motor->_shaper->reset();
+        motor->_isr_line = false;
+        motor->_isr_running = false;
+        motor->_isr_step_pending = false;
+    }
+    interrupts();
+    for (uint8_t i = 0; i < _count; i++) {
+        _motors[i]->abort(lost & (1 << i));
+    }
+}
+
+void StepEngine::tick() {
+    StepperMotor* motor;
+    uint8_t raised = 0;
+    uint8_t turned = 0;
+    uint8_t active = 0;
+    Bench::begin(BENCH_TICK);
+
+#if defined(__AVR__)
+    uint16_t pulse_start = TCNT1;
+#endif
+    // Импульсы, не опущенные в конце прошлого такта, и отложенная
+    // вместе с ними смена направления
+    if (_pulse_high) {
+        lowerPulses();
+        writeDirections();
+    }
+
+    // Затем выдаём фронты, подготовленные на прошлом такте:
+    // задержка импульса от начала прерывания не зависит от расчётов
+#if defined(__AVR__)
+    // Оси на одном порту получают фронт одной записью - одновременно
+    for (uint8_t i = 0; i < _count; i++) {
+        motor = _motors[i];
+        if (motor->_isr_step_pending) {
+            _pul_high[motor->_pul_port] |= motor->_pul_mask;
+            motor->_isr_step_pending = false;
+            raised |= (1 << i);
+        }
+    }
+    for (uint8_t p = 0; p < _port_count; p++) {
+        if (_pul_high[p]) *_pul_ports[p] |= _pul_high[p];
+    }
+    // Счётчик сбрасывается по совпадению, его значение - опоздание фронта
+    if (raised) {
+        StepStats::recordSteps(raised, pulse_start / (F_CPU / 1000000UL));
+    }
+#else
+    for (uint8_t i = 0; i < _count; i++) {
+        motor = _motors[i];
+        if (motor->_isr_step_pending) {
+            motor->pulseHigh();
+            motor->_isr_step_pending = false;
+            raised |= (1 << i);
+        }
+    }
+    if (raised) {
+        StepStats::recordSteps(raised, 0);
+    }
+#endif
+
+    // Учёт выданных шагов и расчёт шагов следующего такта
+    for (uint8_t i = 0; i < _count; i++) {
+        motor = _motors[i];
+        if (raised & (1 << i)) {
+            // Сложение без знака: позиция колеса переходит через 2^32 без переполнения
+            motor->_current_pos = (int32_t)((uint32_t)motor->_current_pos + (uint32_t)(int32_t)motor->_isr_dir);
+            if (motor->_isr_running && motor->_isr_steps != STEP_ENGINE_CONTINUOUS) {
+                if (--motor->_isr_steps == 0) {
+                    motor->_isr_running = false;
+                } else {
+                    rampStep(motor->_isr_ramp, motor->_isr_steps);
+                }
+            }
+        }
+        InputShaper* shaper = motor->_shaper;
+        if (shaper != NULL && shaper->isActive()) {
+            active++;
+            // Выборка оси i кончается на своём такте из SHAPER_SAMPLE_TICKS
+            uint8_t result = shaper->tick(_shaper_phase == i * (SHAPER_SAMPLE_TICKS / STEP_ENGINE_MAX_AXES));
+            if (result == SHAPER_STEP) {
+                motor->_isr_step_pending = true;
+            } else if (result == SHAPER_TURN) {
+                motor->_isr_dir = shaper->direction();
+                turned |= (1 << i);
+            }
+        }
+        if (motor->_isr_running) {
+            active++;
+            if (motor->_isr_ramp.phase != RAMP_CRUISE) {
+                updateRamp(motor->_isr_ramp);
+            }
+            uint32_t prev = motor->_isr_accum;
+            motor->_isr_accum += motor->_isr_ramp.rate;
+            // Переполнение накопителя - на следующем такте шаг
+            if (motor->_isr_accum < prev) {
+                motor->_isr_step_pending = true;
+            }
+        }
+    }
+
+    if (_line_active) {
+        active++;
+        tickLine();
+    }
+    if (++_shaper_phase == SHAPER_SAMPLE_TICKS) {
+        _shaper_phase = 0;
+    }
+
+    // Импульс опускается без ожидания: сейчас, если он уже не короче
+    // STEP_PULSE_TIMER_TICKS, иначе - в начале следующего такта
+    _pulse_high = raised;
+#if defined(__AVR__)
+    if (raised && (uint16_t)(TCNT1 - pulse_start) >= STEP_PULSE_TIMER_TICKS) {
+        lowerPulses();
+    }
+#endif
+    _turned |= turned;
+    if (!_pulse_high) {
+        writeDirections();
+    }
+
+#if defined(__AVR__)
+    // Совпадение уже наступило - следующий такт начнётся с опозданием
+    if (TIFR1 & (1 << OCF1A)) {
+        StepStats::recordOverrun();
+    }
+#endif
+
+    // Таймер останавливается, когда опущены все импульсы
+    if (active == 0 && !_pulse_high) {
+        stopTimer();
+    }
+    Bench::end(raised ? BENCH_TICK_STEP : BENCH_TICK);
+}
+
+// Такт координированного движения: один задающий накопитель на все оси,
+// на каждый шаг ведущей оси - по одному сложению и сравнению на ось
+void StepEngine::tickLine() {
+    if (_hold == HOLD_STOPPED) {
+        return;
+    }
+    if (_line_events == 0) {
+        // Последние шаги блока выданы на этом такте - берём следующий
+        const MotionBlock* next = _line_source();
+        if (next != NULL) {
+            uint32_t rate = _line_ramp.rate;
+            loadBlock(next);
+            // Торможение удержания продолжается через стык блоков
+            if (_hold != HOLD_NONE) {
+                holdRamp(rate);
+            }
+            return;
+        }
+        for (uint8_t i = 0; i < _count; i++) {
+            _motors[i]->_isr_line = false;
+        }
+        // Очередь кончилась раньше остановки - удержание ждёт resume()
+        if (_hold != HOLD_NONE) {
+            _hold = HOLD_STOPPED;
+        }
+        _line_active = false;
+        return;
+    }
+
+    if (_line_ramp.phase != RAMP_CRUISE) {
+        updateRamp(_line_ramp);
+        if (_hold == HOLD_DECEL && _line_ramp.rate <= _hold_rate) {
+            _hold = HOLD_STOPPED;
+            return;
+        }
+    }
+    uint32_t prev = _line_accum;
+    _line_accum += _line_ramp.rate;
+    if (_line_accum >= prev) {
+        return;
+    }
+
+    const MotionBlock* line = _line;
+    for (uint8_t i = 0; i < _count; i++) {
+        if (line->steps[i] == 0) continue;
+        _line_error[i] += line->steps[i];
+        if (_line_error[i] > 0) {
+            _line_error[i] -= line->step_event_count;
+            StepperMotor* motor = _motors[i];
+            if (motor->_shaper != NULL) {
+                motor->_shaper->command();
+            } else {
+                motor->_isr_step_pending = true;
+            }
+        }
+    }
+    if (--_line_events != 0) {
+        rampStep(_line_ramp, _line_events);
+    }
+}
+
+// Учёт сделанного шага: переход к торможению
+void StepEngine::retargetRamp(StepRamp& ramp, uint32_t target_rate) {
+    uint32_t rate = ramp.rate;
+    ramp.jerk_down = false;
+    ramp.acc = ramp.jerk != 0 ? 0 : ramp.accel;
+    ramp.mirror = false;
+    if (ramp.accel == 0 || target_rate == rate) {
+        ramp.rate = target_rate;
+        ramp.cruise_rate = target_rate;
+        ramp.floor_rate = target_rate;
+        ramp.phase = RAMP_CRUISE;
+        return;
+    }
+    if (target_rate > rate) {
+        ramp.floor_rate = rate;
+        ramp.cruise_rate = target_rate;
+        ramp.jerk_dv = 0;
+        ramp.phase = RAMP_ACCEL;
+    } else {
+        ramp.floor_rate = target_rate;
+        ramp.cruise_rate = rate;
+        ramp.jerk_dv = 0;
+        if (ramp.jerk != 0) {
+            // Прирост скорости за нарастание ускорения: accel^2 / (2 * jerk),
+            // не больше половины изменения скорости
+            uint32_t dv = (uint32_t)((uint64_t)ramp.accel * ramp.accel / ((uint64_t)ramp.jerk * 512));
+            uint32_t half = (rate - target_rate) / 2;
+            ramp.jerk_dv = dv < half ? dv : half;
+        }
+        ramp.phase = RAMP_DECEL;
+    }
+}
+
+void StepEngine::rampStep(StepRamp& ramp, uint32_t steps_left) {
+    if (ramp.phase == RAMP_ACCEL && ramp.mirror) {
+        ramp.decel_steps++;
+    }
+    // В зеркальном режиме торможение начинается, когда осталось столько же
+    // шагов, сколько ушло на разгон
+    if (ramp.phase != RAMP_DECEL && ramp.accel != 0 && steps_left <= ramp.decel_steps) {
+        ramp.phase = RAMP_DECEL;
+        ramp.jerk_down = false;
+        ramp.acc = ramp.jerk != 0 ? 0 : ramp.accel;
+    }
+}
+
+// Изменение скорости за один такт. Только сложения и сравнения:
+// все коэффициенты рассчитаны заранее при постановке задания.
+void StepEngine::updateRamp(StepRamp& ramp) {
+    uint32_t rate = ramp.rate;
+
+    if (ramp.jerk != 0) {
+        // S-кривая: ускорение нарастает с рывком до предела, затем спадает
+        // симметрично, чтобы выйти на целевую скорость с нулевым ускорением
+        if (!ramp.jerk_down) {
+            bool near_target;
+            if (ramp.phase == RAMP_ACCEL) {
+                near_target = rate + ramp.jerk_dv >= ramp.cruise_rate;
+            } else {
+                near_target = rate <= ramp.floor_rate + ramp.jerk_dv;
+            }
+            if (near_target) {
+                ramp.jerk_down = true;
+            } else if (ramp.acc < ramp.accel) {
+                ramp.acc += ramp.jerk;
+                if (ramp.acc > ramp.accel) ramp.acc = ramp.accel;
+                if (ramp.phase == RAMP_ACCEL) {
+                    ramp.jerk_dv = rate - ramp.floor_rate;
+                }
+            }
+        }
+        if (ramp.jerk_down) {
+            // Не даём ускорению упасть до нуля, пока скорость не достигнута
+            if (ramp.acc > 2 * ramp.jerk) {
+                ramp.acc -= ramp.jerk;
+            } else {
+                ramp.acc = ramp.jerk;
+            }
+        }
+    }
+
+    uint32_t delta = ramp.acc >> 8;
+    if (delta == 0) delta = 1;
+
+    if (ramp.phase == RAMP_ACCEL) {
+        if (ramp.cruise_rate - rate <= delta) {
+            rate = ramp.cruise_rate;
+            ramp.phase = RAMP_CRUISE;
+        } else {
+            rate += delta;
+        }
+    } else {
+        // Торможение не опускается ниже нижней скорости,
+        // чтобы задание гарантированно завершилось
+        if (rate <= ramp.floor_rate || rate - ramp.floor_rate <= delta) {
+            rate = ramp.floor_rate;
+        } else {
+            rate -= delta;
+        }
+    }
+    ramp.rate = rate;
+}
+
+#if defined(__AVR__)
+
+ISR(TIMER1_COMPA_vect) {
+    StepEngine::tick();
+}
+
+void StepEngine::setupTimer() {
+    noInterrupts();
+    TCCR1A = 0;
+    TCCR1B = (1 << WGM12) | (1 << CS10); // CTC, без делителя (16 МГц)
+    OCR1A = F_CPU / STEP_ENGINE_TICK_HZ - 1;
+    TCNT1 = 0;
+    TIMSK1 &= ~(1 << OCIE1A); // Прерывание включается при первом задании
+    interrupts();
+}
+
+void StepEngine::wake() {
+    noInterrupts();
+    if (!(TIMSK1 & (1 << OCIE1A))) {
+        TCNT1 = 0;
+        TIFR1 = (1 << OCF1A);
+        TIMSK1 |= (1 << OCIE1A);
+    }
+    interrupts();
+}
+
+void StepEngine::stopTimer() {
+    // Вызывается из прерывания, прерывания уже запрещены
+    TIMSK1 &= ~(1 << OCIE1A);
+}
+
+#elif defined(ARDUINO_SIM)
+
+// Сборка [env:native]: таймер имитируется в виртуальном времени
+
+void StepEngine::setupTimer() {
+    simTimerAttach(tick, 1000000000UL / STEP_ENGINE_TICK_HZ);
+}
+
+void StepEngine::wake() {
+    simTimerEnable(true);
+}
+
+void StepEngine::stopTimer() {
+    simTimerEnable(false);
+}
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef STEP_ENGINE_H
+#define STEP_ENGINE_H
+
+#include <Arduino.h>
+
+class StepperMotor;
+class InputShaper;
+
+// Частота тактов шагового движка (прерывание Timer1 по совпадению A).
+// Каждая ось может сделать не больше одного шага за такт. Фронт шага
+// выдаётся в начале такта, поэтому интервалы между шагами кратны такту
+// (25 мкс), а отклонение шага от точного времени - меньше такта: 30 кГц
+// идут интервалами 25 и 50 мкс вперемешку, в среднем 33.3 мкс.
+#define STEP_ENGINE_TICK_HZ 40000UL
+
+// Максимальное число осей, обслуживаемых движком. Для 5-6 осей на
+// свободных пинах Nano: -D STEP_ENGINE_MAX_AXES=6 (растёт ОЗУ очереди).
+// Сборка [env:nanoatmega328] задаёт 2 - оси станка, см. platformio.ini.
+#ifndef STEP_ENGINE_MAX_AXES
+#define STEP_ENGINE_MAX_AXES 4
+#endif
+
+// Формирователей (InputShaper, около 95 байт ОЗУ каждый) в общем наборе:
+// место занимает только ось с включённым подавлением резонанса. Для
+// нескольких таких осей: -D STEP_ENGINE_SHAPERS=2
+#ifndef STEP_ENGINE_SHAPERS
+#define STEP_ENGINE_SHAPERS 1
+#endif
+
+// Минимальная длительность импульса PUL в тактах Timer1 (16 МГц, 3 мкс).
+// Прерывание не ждёт конца импульса: если к концу расчётов импульс ещё
+// короче, он опускается в начале следующего такта (в имитации - всегда).
+#define STEP_PULSE_TIMER_TICKS 48
+#define STEP_PULSE_MICROS 3
+
+// Скорость оси хранится как доля шага за такт в формате Q0.32:
+// переполнение 32-битного накопителя означает шаг.
+// STEP_RATE_PER_HZ = 2^32 / STEP_ENGINE_TICK_HZ
+#define STEP_RATE_PER_HZ ((uint32_t)(4294967296.0 / STEP_ENGINE_TICK_HZ + 0.5))
+
+// Ускорение хранится как приращение скорости за такт с 8 дробными битами,
+// рывок - как приращение ускорения за такт
+#define STEP_ACCEL_PER_HZ_S (4294967296.0 * 256.0 / ((double)STEP_ENGINE_TICK_HZ * STEP_ENGINE_TICK_HZ))
+#define STEP_JERK_PER_HZ_S2 (STEP_ACCEL_PER_HZ_S / STEP_ENGINE_TICK_HZ)
+
+// Признак бесконечного движения (используется при поиске концевика)
+#define STEP_ENGINE_CONTINUOUS 0xFFFFFFFFUL
+
+// Удержание подачи (feed hold) координированного движения
+enum HoldState {
+    HOLD_NONE,
+    HOLD_DECEL,   // Торможение до остановки
+    HOLD_STOPPED  // Стоим, остаток блока сохранён
+};
+
+// Фаза профиля скорости
+enum RampPhase {
+    RAMP_ACCEL,
+    RAMP_CRUISE,
+    RAMP_DECEL
+};
+
+// Профиль скорости задания. Все коэффициенты рассчитываются при постановке
+// задания, в прерывании только сложения и сравнения.
+struct StepRamp {
+    uint32_t rate;        // Текущая скорость (Q0.32)
+    uint32_t cruise_rate; // Крейсерская скорость
+    uint32_t floor_rate;  // Ниже этой скорости торможение не опускается
+    uint32_t accel;       // Ускорение (приращение скорости за такт, Q8)
+    uint32_t jerk;        // Рывок (0 - трапеция)
+    uint32_t acc;         // Текущее ускорение (Q8)
+    uint32_t jerk_dv;     // Прирост скорости при нарастании ускорения
+    uint32_t decel_steps; // Торможение начинается, когда осталось столько шагов
+    uint8_t phase;        // RampPhase
+    bool jerk_down;       // S-кривая: ускорение уменьшается
+    bool mirror;          // Тормозить за столько же шагов, сколько ушло на разгон
+};
+
+// Блок координированного движения: все оси блока ведёт один задающий
+// генератор, шаги по осям распределяются алгоритмом Брезенхема.
+// Скорости и ускорение заданы для ведущей оси (с наибольшим числом шагов).
+struct MotionBlock {
+    uint32_t steps[STEP_ENGINE_MAX_AXES]; // Шагов по каждой оси
+    uint8_t dir_negative;                 // Биты осей, движущихся назад
+    uint32_t step_event_count;            // Шагов по ведущей оси
+    uint32_t entry_rate;                  // Начальная скорость (Q0.32)
+    uint32_t cruise_rate;                 // Крейсерская скорость
+    uint32_t exit_rate;                   // Конечная скорость
+    uint32_t accel;                       // Ускорение (Q8)
+    uint32_t decel_steps;                 // Шагов торможения в конце блока
+};
+
+// Источник следующего блока для движка - вызывается из прерывания по
+// окончании текущего блока, NULL - блоков больше нет
+typedef const MotionBlock* (*BlockSource)();
+
+// Генератор шагов на прерывании Timer1. Основной цикл только передаёт
+// задания осям через StepperMotor, импульсы выдаются в tick().
+class StepEngine {
+public:
+    // Регистрация двигателя; при первой регистрации настраивается таймер.
+    // Возвращает номер оси или -1, если места нет.
+    static int8_t attach(StepperMotor* motor);
+
+    // Двигатель оси по номеру
+    static StepperMotor* motor(uint8_t axis);
+
+    // Число зарегистрированных осей
+    static uint8_t axisCount();
+
+    // Свободный (выключенный) формирователь из набора, NULL - все заняты.
+    // Место за осью закрепляет его настройка (InputShaper::configure()).
+    static InputShaper* takeShaper();
+
+    // Запуск координированного движения. Блок читается на месте до конца
+    // выполнения; следующий блок движок берёт сам у source (по умолчанию
+    // Planner::nextBlock()).
+    static bool startLine(const MotionBlock* block, BlockSource source = NULL);
+
+    // Выполняется ли координированное движение (включая шаги, которые
+    // ещё выдают формирователи осей, см. InputShaper.h)
+    static bool lineBusy();
+
+    // Удержание подачи: плавное торможение координированного движения
+    // с ускорением блока, остаток пути сохраняется. Пока удержание не
+    // снято resume(), новые блоки не запускаются.
+    static void feedHold();
+    static void resume();
+    static uint8_t holdState();
+
+    // Удержание из прерывания (касание щупа): то же торможение, что у
+    // feedHold(), но до нулевой скорости - без извлечения корня.
+    // Вызывается при запрещённых прерываниях.
+    static void stopLine();
+
+    // Отмена координированного движения, остановленного удержанием:
+    // остаток блока отбрасывается, оси линии остаются под током и
+    // с калибровкой. Другие двигатели (свои перемещения, режим
+    // скорости) не затрагиваются.
+    static void cancelLine();
+
+    // Немедленная остановка всех осей без торможения (сброс). Оси, которые
+    // в этот момент шагали, теряют калибровку.
+    static void abort();
+
+    // Включение прерывания таймера, если оно было остановлено
+    static void wake();
+
+    // Обработка одного такта - вызывается из прерывания
+    static void tick();
+
+    // Перевод частоты шагов (Гц) в формат скорости движка
+    static uint32_t rateFromHz(long speed_hz);
+
+    // Начальное состояние профиля скорости
+    static void resetRamp(StepRamp& ramp, uint32_t start_rate, uint32_t cruise_rate,
+        uint32_t floor_rate, uint32_t accel, uint32_t jerk);
+
+    // Смена целевой скорости профиля на ходу: разгон или торможение от
+    // текущей скорости. Вызывается при запрещённых прерываниях.
+    static void retargetRamp(StepRamp& ramp, uint32_t target_rate);
+
+private:
+    static void updateRamp(StepRamp& ramp);
+    static void rampStep(StepRamp& ramp, uint32_t steps_left);
+    static void tickLine();
+    static void holdRamp(uint32_t rate);
+    static void loadBlock(const MotionBlock* block);
+    static void writeLineDirections();
+    static void writeDirections();
+    static void lowerPulses();
+    static bool shaping();
+    static void setupTimer();
+    static void stopTimer();
+
+    static StepperMotor* _motors[STEP_ENGINE_MAX_AXES];
+    static uint8_t _count;
+#if defined(__AVR__)
+    static volatile uint8_t* _pul_ports[STEP_ENGINE_MAX_AXES]; // Порты пинов PUL
+    static uint8_t _pul_high[STEP_ENGINE_MAX_AXES]; // Поднятые биты PUL каждого порта
+    static uint8_t _port_count;
+#endif
+    static uint8_t _pulse_high; // Оси с поднятым импульсом PUL
+    static uint8_t _turned;     // Оси, ждущие смены направления от формирователя
+
+    // Состояние координированного движения
+    static const MotionBlock* _line;
+    static BlockSource _line_source;
+    static StepRamp _line_ramp;
+    static uint32_t _line_accum;
+    static uint32_t _line_events;  // Оставшиеся шаги ведущей оси
+    static int32_t _line_error[STEP_ENGINE_MAX_AXES]; // Накопители Брезенхема
+    static volatile bool _line_active;
+    static bool _line_dir_pending; // Направления нового блока ещё не выставлены
+    static volatile uint8_t _hold; // HoldState
+    static uint32_t _hold_rate;    // Скорость, на которой удержание останавливает шаги
+    static uint8_t _shaper_phase;  // Такт выборки формирователей (0...SHAPER_SAMPLE_TICKS-1)
+    static InputShaper _shapers[STEP_ENGINE_SHAPERS];
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "StepStats.h"
+#include "Console.h"
+
+#if defined(STEP_STATS)
+
+volatile uint32_t StepStats::_steps[STEP_ENGINE_MAX_AXES];
+volatile uint32_t StepStats::_missed[STEP_ENGINE_MAX_AXES];
+volatile uint32_t StepStats::_late[STEP_ENGINE_MAX_AXES][STEP_STATS_BUCKETS];
+volatile uint32_t StepStats::_overruns = 0;
+uint32_t StepStats::_peak_rate[STEP_ENGINE_MAX_AXES];
+uint32_t StepStats::_window_steps[STEP_ENGINE_MAX_AXES];
+uint32_t StepStats::_window_start = 0;
+uint32_t StepStats::_reset_time = 0;
+uint32_t StepStats::_loop_last = 0;
+uint32_t StepStats::_loop_max = 0;
+
+// Атомарное чтение счётчика, который меняется в прерывании
+static uint32_t readCounter(volatile uint32_t& counter) {
+    noInterrupts();
+    uint32_t value = counter;
+    interrupts();
+    return value;
+}
+
+void StepStats::loopStart() {
+    uint32_t now = micros();
+    if (_loop_last != 0 && now - _loop_last > _loop_max) {
+        _loop_max = now - _loop_last;
+    }
+    _loop_last = now;
+
+    // Пиковая частота - по числу шагов за окно
+    uint32_t now_ms = now / 1000;
+    if (now_ms - _window_start < STEP_STATS_PEAK_WINDOW_MS) {
+        return;
+    }
+    for (uint8_t i = 0; i < StepEngine::axisCount(); i++) {
+        uint32_t steps = readCounter(_steps[i]);
+        uint32_t rate = (steps - _window_steps[i]) * 1000UL / (now_ms - _window_start);
+        if (rate > _peak_rate[i]) _peak_rate[i] = rate;
+        _window_steps[i] = steps;
+    }
+    _window_start = now_ms;
+}
+
+// Формат для разбора на хосте:
+// [STAT AXIS:n STEPS:n RATE:n PEAK:n MISSED:n LATE:b0,b1,b2,b3,b4,b5]
+// [STAT LOOP_MAX:мкс OVERRUNS:n]
+void StepStats::report() {
+    uint32_t elapsed = millis() - _reset_time;
+    for (uint8_t i = 0; i < StepEngine::axisCount(); i++) {
+        uint32_t steps = readCounter(_steps[i]);
+        Console.print(F("[STAT AXIS:"));
+        Console.print(i);
+        Console.print(F(" STEPS:"));
+        Console.print(steps);
+        Console.print(F(" RATE:"));
+        Console.print(elapsed > 0 ? (uint32_t)((uint64_t)steps * 1000 / elapsed) : 0UL);
+        Console.print(F(" PEAK:"));
+        Console.print(_peak_rate[i]);
+        Console.print(F(" MISSED:"));
+        Console.print(readCounter(_missed[i]));
+        Console.print(F(" LATE:"));
+        for (uint8_t b = 0; b < STEP_STATS_BUCKETS; b++) {
+            if (b > 0) Console.print(',');
+            Console.print(readCounter(_late[i][b]));
+        }
+        Console.println(']');
+    }
+    Console.print(F("[STAT LOOP_MAX:"));
+    Console.print(_loop_max);
+    Console.print(F(" OVERRUNS:"));
+    Console.print(readCounter(_overruns));
+    Console.println(']');
+}
+
+void StepStats::reset() {
+    noInterrupts();
+    for (uint8_t i = 0; i < STEP_ENGINE_MAX_AXES; i++) {
+        _steps[i] = 0;
+        _missed[i] = 0;
+        for (uint8_t b = 0; b < STEP_STATS_BUCKETS; b++) {
+            _late[i][b] = 0;
+        }
+        _peak_rate[i] = 0;
+        _window_steps[i] = 0;
+    }
+    _overruns = 0;
+    interrupts();
+    _loop_max = 0;
+    _loop_last = 0;
+    _reset_time = millis();
+    _window_start = _reset_time;
+}
+
+#else
+
+void StepStats::report() {
+    Console.println(F("Статистика отключена (сборка без -D STEP_STATS)"));
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef STEP_STATS_H
+#define STEP_STATS_H
+
+#include <Arduino.h>
+#include "StepEngine.h"
+
+// Статистика таймингов шагов. Включается флагом сборки -D STEP_STATS;
+// без него все методы пустые и исчезают при компиляции.
+
+// Корзины гистограммы опоздания фронта от начала такта:
+// <1, 1-2, 2-4, 4-8, 8-16, >=16 мкс
+#define STEP_STATS_BUCKETS 6
+
+// Шаг, выданный позже этого срока, считается пропуском
+#define STEP_STATS_DEADLINE_US 10
+
+// Период измерения пиковой частоты шагов
+#define STEP_STATS_PEAK_WINDOW_MS 100
+
+#if defined(STEP_STATS)
+
+class StepStats {
+public:
+    // Из прерывания: на такте выданы шаги осей из маски raised
+    // с опозданием late_us от начала такта. Несколько тактов на шаг.
+    static inline void recordSteps(uint8_t raised, uint8_t late_us) {
+        uint8_t bucket = 0;
+        bool missed = late_us >= STEP_STATS_DEADLINE_US;
+        while (late_us != 0 && bucket < STEP_STATS_BUCKETS - 1) {
+            late_us >>= 1;
+            bucket++;
+        }
+        for (uint8_t i = 0; raised != 0; i++, raised >>= 1) {
+            if (raised & 1) {
+                _late[i][bucket]++;
+                _steps[i]++;
+                if (missed) _missed[i]++;
+            }
+        }
+    }
+
+    // Из прерывания: обработка такта не уложилась в период таймера
+    static inline void recordOverrun() {
+        _overruns++;
+    }
+
+    // Вызывается в начале каждой итерации loop()
+    static void loopStart();
+
+    // Отчёт в Serial (M860) и сброс (M861)
+    static void report();
+    static void reset();
+
+private:
+    static volatile uint32_t _steps[STEP_ENGINE_MAX_AXES];
+    static volatile uint32_t _missed[STEP_ENGINE_MAX_AXES];
+    static volatile uint32_t _late[STEP_ENGINE_MAX_AXES][STEP_STATS_BUCKETS];
+    static volatile uint32_t _overruns;
+    static uint32_t _peak_rate[STEP_ENGINE_MAX_AXES];
+    static uint32_t _window_steps[STEP_ENGINE_MAX_AXES];
+    static uint32_t _window_start;
+    static uint32_t _reset_time;
+    static uint32_t _loop_last;
+    static uint32_t _loop_max;
+};
+
+#else
+
+class StepStats {
+public:
+    static inline void recordSteps(uint8_t, uint8_t) {}
+    static inline void recordOverrun() {}
+    static inline void loopStart() {}
+    static void report();
+    static inline void reset() {}
+};
+
+#endif
+
+#endif
@@ -1,4 +1,7 @@
 #include "StepperMotor.h"
+#include "Log.h"
+#include "Endstops.h"
+#include "Bench.h"
 
 StepperMotor::StepperMotor(uint8_t pin_ena, uint8_t pin_dir, uint8_t pin_pul, 
     bool reverse, float steps_per_mm, float steps_per_degre) {
@@ -8,16 +11,38 @@ StepperMotor::StepperMotor(uint8_t pin_ena, uint8_t pin_dir, uint8_t pin_pul,
     _reverse = reverse;
     _steps_per_mm = steps_per_mm;
     _steps_per_degre = steps_per_degre;
+    _motor_type = AXIS;
+    // Масштабы считаются один раз, перемещения - без плавающей точки
+    _mm_scale = (int32_t)(steps_per_mm / STEPPER_UNIT_SCALE * (1L << STEPPER_SCALE_BITS) + 0.5);
+    _deg_scale = (int32_t)(steps_per_degre / STEPPER_UNIT_SCALE * (1L << STEPPER_SCALE_BITS) + 0.5);
+    _unit_target = 0;
     _current_pos = 0;
     _max_pos = 0;
-    _target_pos = 0;
-    _steps_remaining = 0;
     _calibrated = false;
     _state = IDLE;
-    _pulse_state = false;
-    _last_step_time = 0;
     _pause_start_time = 0;
+    _velocity_hz = 0;
+    _velocity_rate = 0;
+    _axis = -1;
+    _isr_steps = 0;
+    _isr_accum = 0;
+    _isr_dir = 1;
+    _isr_running = false;
+    _isr_line = false;
+    _isr_step_pending = false;
+    _shaper = NULL;
+    _endstop_armed = false;
+    _endstop_hit = false;
+    _endstop_pos = 0;
+    _endstop_time = 0;
+    StepEngine::resetRamp(_isr_ramp, 0, 0, 0, 0, 0);
+    _start_rate = 0;
+    _accel = 0;
+    _accel_hz = 0;
+    _jerk = 0;
     setSpeed(1000); // Скорость по умолчанию 1000 Гц
+    _homing_rate = _step_rate;
+    _locate_rate = _step_rate / STEPPER_HOMING_LOCATE_DIVISOR;
 }
 
 StepperMotor::StepperMotor(uint8_t pin_ena, uint8_t pin_dir, uint8_t pin_pul, uint8_t pin_endstop, 
@@ -29,32 +54,108 @@ StepperMotor::StepperMotor(uint8_t pin_ena, uint8_t pin_dir, uint8_t pin_pul, ui
     _reverse = reverse;
     _steps_per_mm = steps_per_mm;
     _steps_per_degre = steps_per_degre;
+    _motor_type = AXIS;
+    // Масштабы считаются один раз, перемещения - без плавающей точки
+    _mm_scale = (int32_t)(steps_per_mm / STEPPER_UNIT_SCALE * (1L << STEPPER_SCALE_BITS) + 0.5);
+    _deg_scale = (int32_t)(steps_per_degre / STEPPER_UNIT_SCALE * (1L << STEPPER_SCALE_BITS) + 0.5);
+    _unit_target = 0;
     _current_pos = 0;
     _max_pos = 0;
-    _target_pos = 0;
-    _steps_remaining = 0;
     _calibrated = false;
     _state = IDLE;
-    _pulse_state = false;
-    _last_step_time = 0;
     _pause_start_time = 0;
+    _velocity_hz = 0;
+    _velocity_rate = 0;
+    _axis = -1;
+    _isr_steps = 0;
+    _isr_accum = 0;
+    _isr_dir = 1;
+    _isr_running = false;
+    _isr_line = false;
+    _isr_step_pending = false;
+    _shaper = NULL;
+    _endstop_armed = false;
+    _endstop_hit = false;
+    _endstop_pos = 0;
+    _endstop_time = 0;
+    StepEngine::resetRamp(_isr_ramp, 0, 0, 0, 0, 0);
+    _start_rate = 0;
+    _accel = 0;
+    _accel_hz = 0;
+    _jerk = 0;
     setSpeed(1000); // Скорость по умолчанию 1000 Гц
+    _homing_rate = _step_rate;
+    _locate_rate = _step_rate / STEPPER_HOMING_LOCATE_DIVISOR;
 }
 
 void StepperMotor::begin() {
     pinMode(_pin_ena, OUTPUT);
     pinMode(_pin_dir, OUTPUT);
     pinMode(_pin_pul, OUTPUT);
-    disable(); // Изначально драйвер выключен
+#if defined(__AVR__)
+    _pul_out = portOutputRegister(digitalPinToPort(_pin_pul));
+    _pul_mask = digitalPinToBitMask(_pin_pul);
+    _dir_out = portOutputRegister(digitalPinToPort(_pin_dir));
+    _dir_mask = digitalPinToBitMask(_pin_dir);
+#endif
+    // Изначально драйвер выключен. Ось, позицию которой уже восстановил
+    // Settings::begin(), остаётся под током: ENA не поднимается ни на миг.
+    if (_calibrated) enable(); else disable();
     digitalWrite(_pin_pul, LOW);  // Изначально пин импульса в LOW
+    _axis = StepEngine::attach(this);
 }
 
 void StepperMotor::setSpeed(long speed_hz) {
     if (speed_hz > 0) {
-        _delay_micros = 1000000 / speed_hz / 2;
+        _speed_hz = speed_hz;
+        _step_rate = StepEngine::rateFromHz(speed_hz);
     }
 }
 
+void StepperMotor::setSpeedMM(long mm_per_min) {
+    // мм/мин -> мкм/с -> шаги/с
+    int64_t steps = (int64_t)mm_per_min * (STEPPER_UNIT_SCALE / 10) * _mm_scale / 6;
+    setSpeed((long)((steps + (1L << (STEPPER_SCALE_BITS - 1))) >> STEPPER_SCALE_BITS));
+}
+
+void StepperMotor::setSpeedDeg(long deg_per_s) {
+    int64_t steps = (int64_t)deg_per_s * STEPPER_UNIT_SCALE * _deg_scale;
+    setSpeed((long)((steps + (1L << (STEPPER_SCALE_BITS - 1))) >> STEPPER_SCALE_BITS));
+}
+
+void StepperMotor::setAcceleration(long accel) {
+    _accel_hz = accel > 0 ? accel : 0;
+    if (accel > 0) {
+        _accel = (uint32_t)(accel * STEP_ACCEL_PER_HZ_S);
+        // Скорость, набираемая за первый шаг из покоя: sqrt(2a)
+        _start_rate = StepEngine::rateFromHz((long)sqrt(2.0 * accel));
+    } else {
+        _accel = 0;
+        _start_rate = 0;
+    }
+}
+
+void StepperMotor::setJerk(long jerk) {
+    _jerk = jerk > 0 ? (uint32_t)(jerk * STEP_JERK_PER_HZ_S2) : 0;
+    if (jerk > 0 && _jerk == 0) _jerk = 1;
+}
+
+void StepperMotor::setHomingSpeed(long speed_hz, long locate_speed_hz) {
+    if (speed_hz > 0) {
+        _homing_rate = StepEngine::rateFromHz(speed_hz);
+        _locate_rate = locate_speed_hz > 0 ? StepEngine::rateFromHz(locate_speed_hz)
+            : _homing_rate / STEPPER_HOMING_LOCATE_DIVISOR;
+    }
+}
+
+void StepperMotor::setDirection(bool forward) {
+    // Порт DIR может быть общим с PUL, которые пишет прерывание движка:
+    // чтение-изменение-запись порта - без прерываний
+    noInterrupts();
+    writeDirection(forward);
+    interrupts();
+}
+
 void StepperMotor::enable() {
     digitalWrite(_pin_ena, LOW);
 }
@@ -63,30 +164,96 @@ void StepperMotor::disable() {
     digitalWrite(_pin_ena, HIGH);
 }
 
-void StepperMotor::stepHigh() {
-    digitalWrite(_pin_pul, HIGH);
-    _pulse_state = true;
-    _last_step_time = micros();
+void StepperMotor::abort(bool position_lost) {
+    stopSteps();
+    noInterrupts();
+    _endstop_armed = false;
+    _endstop_hit = false;
+    interrupts();
+    // Калибровка, прерванная на середине, тоже не даёт нуля
+    if (position_lost || isCalibrating()) {
+        _calibrated = false;
+    }
+    _state = IDLE;
+    _velocity_hz = 0;
+    _velocity_rate = 0;
+    disable();
+}
+
+void StepperMotor::startSteps(uint32_t steps, bool forward, uint32_t rate) {
+    stopSteps();
+    _isr_dir = forward ? 1 : -1;
+    _isr_steps = steps;
+    StepEngine::resetRamp(_isr_ramp, _start_rate, rate, _start_rate, _accel, _jerk);
+    // Первый шаг выдаётся на следующем такте
+    _isr_accum = 0UL - _isr_ramp.rate;
+    _isr_running = true;
+    StepEngine::wake();
+}
+
+void StepperMotor::stopSteps() {
+    noInterrupts();
+    _isr_running = false;
+    _isr_step_pending = false;
+    interrupts();
+}
+
+void StepperMotor::setMotorType(MotorType type) {
+    if (_state == IDLE) {
+        _motor_type = type;
+    }
+}
+
+MotorType StepperMotor::getMotorType() {
+    return _motor_type;
+}
+
+bool StepperMotor::setVelocity(long speed_hz) {
+    if (_motor_type != WHEEL) {
+        return false;
+    }
+    if ((_state != IDLE && _state != RUNNING) || followsLine()) {
+        Log::event(LOG_MOTOR_BUSY);
+        return false;
+    }
+    _velocity_hz = speed_hz;
+    if (_state == IDLE) {
+        if (speed_hz == 0) {
+            return true;
+        }
+        enable();
+        setDirection(speed_hz > 0);
+        _velocity_rate = StepEngine::rateFromHz(abs(speed_hz));
+        _state = RUNNING;
+        startSteps(STEP_ENGINE_CONTINUOUS, speed_hz > 0, _velocity_rate);
+        return true;
+    }
+    // Вращение продолжается, новая скорость применяется в update()
+    updateVelocity();
+    return true;
 }
 
-void StepperMotor::stepLow() {
-    digitalWrite(_pin_pul, LOW);
-    _pulse_state = false;
-    _last_step_time = micros();
+long StepperMotor::getVelocity() {
+    return _velocity_hz;
 }
 
 bool StepperMotor::isBusy() {
-    return _state != IDLE;
+    return _state != IDLE || followsLine();
+}
+
+bool StepperMotor::isCalibrating() {
+    return _state == CALIBRATING_HOME || _state == CALIBRATING_BACKOFF || _state == CALIBRATING_LOCATE ||
+        _state == CALIBRATING_PAUSE || _state == CALIBRATING_RETURN;
 }
 
 bool StepperMotor::moveTo(long absolute_pos) {
     if (!_calibrated) {
-        Serial.println(F("Ошибка: Двигатель не откалиброван. Выполните калибровку."));
+        Log::event(LOG_NOT_CALIBRATED);
         return false;
     }
     
-    if (_state != IDLE) {
-        Serial.println(F("Ошибка: Двигатель занят."));
+    if (isBusy()) {
+        Log::event(LOG_MOTOR_BUSY);
         return false;
     }
     
@@ -94,11 +261,102 @@ bool StepperMotor::moveTo(long absolute_pos) {
     if (absolute_pos < 0) absolute_pos = 0;
     if (absolute_pos > _max_pos) absolute_pos = _max_pos;
     
-    return move(absolute_pos - _current_pos);
+    return move(absolute_pos - getCurrentPosition());
+}
+
+bool StepperMotor::moveToMM(long absolute_pos_um) {
+    return moveToScaled((int64_t)absolute_pos_um * _mm_scale);
+}
+
+bool StepperMotor::moveToDeg(long absolute_pos_mdeg) {
+    return moveToScaled((int64_t)absolute_pos_mdeg * _deg_scale);
+}
+
+bool StepperMotor::moveMM(long relative_pos_um) {
+    return moveToScaled(scaledBase() + (int64_t)relative_pos_um * _mm_scale);
+}
+
+bool StepperMotor::moveDeg(long relative_pos_mdeg) {
+    return moveToScaled(scaledBase() + (int64_t)relative_pos_mdeg * _deg_scale);
+}
+
+// Цель прошлого перемещения, если ось на ней стоит. Блоки планировщика,
+// дуги, щуп и готовые отрезки цель не меняют: после них, как и после
+// прерванного перемещения, отсчёт идёт от текущей позиции.
+int64_t StepperMotor::scaledBase() {
+    long pos = getCurrentPosition();
+    long target = (long)((_unit_target + (1L << (STEPPER_SCALE_BITS - 1))) >> STEPPER_SCALE_BITS);
+    return target == pos ? _unit_target : (int64_t)pos << STEPPER_SCALE_BITS;
+}
+
+// Цель хранится с дробной частью шага: серия относительных перемещений
+// не накапливает ошибку округления
+bool StepperMotor::moveToScaled(int64_t target) {
+    long steps = (long)((target + (1L << (STEPPER_SCALE_BITS - 1))) >> STEPPER_SCALE_BITS);
+    if (!moveTo(steps)) {
+        return false;
+    }
+    // Если moveTo() обрезал цель пределами рейки, дробная часть не сохраняется
+    if (steps >= 0 && steps <= _max_pos) {
+        _unit_target = target;
+    }
+    return true;
+}
+
+long StepperMotor::mmToSteps(long pos_um) {
+    int64_t steps = (int64_t)pos_um * _mm_scale;
+    return (long)((steps + (1L << (STEPPER_SCALE_BITS - 1))) >> STEPPER_SCALE_BITS);
+}
+
+long StepperMotor::degToSteps(long pos_mdeg) {
+    int64_t steps = (int64_t)pos_mdeg * _deg_scale;
+    return (long)((steps + (1L << (STEPPER_SCALE_BITS - 1))) >> STEPPER_SCALE_BITS);
+}
+
+float StepperMotor::getStepsPerMM() {
+    return _steps_per_mm;
+}
+
+float StepperMotor::getStepsPerDeg() {
+    return _steps_per_degre;
+}
+
+bool StepperMotor::setInputShaper(uint8_t type, float freq_hz, float damping) {
+    if (isBusy()) {
+        Log::event(LOG_MOTOR_BUSY);
+        return false;
+    }
+    if (type == SHAPER_NONE) {
+        // Место в наборе освобождается для другой оси
+        if (_shaper != NULL) {
+            InputShaper* shaper = _shaper;
+            noInterrupts();
+            _shaper = NULL;
+            interrupts();
+            shaper->configure(SHAPER_NONE, 0, 0);
+        }
+        return true;
+    }
+    InputShaper* shaper = _shaper != NULL ? _shaper : StepEngine::takeShaper();
+    if (shaper == NULL || !shaper->configure(type, freq_hz, damping)) {
+        return false;
+    }
+    // Указатель читает прерывание - запись без прерываний
+    noInterrupts();
+    _shaper = shaper;
+    interrupts();
+    return true;
+}
+
+void StepperMotor::setStepsPerMM(float steps_per_mm) {
+    if (steps_per_mm > 0) {
+        _steps_per_mm = steps_per_mm;
+        _mm_scale = (int32_t)(steps_per_mm / STEPPER_UNIT_SCALE * (1L << STEPPER_SCALE_BITS) + 0.5);
+    }
 }
 
 bool StepperMotor::move(long relative_pos) {
-    if (_state != IDLE && _state != CALIBRATING_RETURN) {
+    if ((_state != IDLE && _state != CALIBRATING_RETURN) || followsLine()) {
         return false;
     }
     
@@ -106,17 +364,12 @@ bool StepperMotor::move(long relative_pos) {
         return true;
     }
     
-    _target_pos = _current_pos + relative_pos;
-    _steps_remaining = abs(relative_pos);
+    _unit_target = (int64_t)(_current_pos + relative_pos) << STEPPER_SCALE_BITS;
     
     enable(); // Включаем драйвер
     
     // Определяем направление
-    if (relative_pos > 0) {
-        digitalWrite(_pin_dir, HIGH);
-    } else {
-        digitalWrite(_pin_dir, LOW);
-    }
+    setDirection(relative_pos > 0);
     
     // Сохраняем информацию о том, что это движение в рамках калибровки
     if (_state == CALIBRATING_RETURN) {
@@ -125,13 +378,13 @@ bool StepperMotor::move(long relative_pos) {
         _state = MOVING;
     }
     
-    _last_step_time = micros();
+    startSteps(abs(relative_pos), relative_pos > 0, _step_rate);
     return true;
 }
 
 void StepperMotor::startCalibration(uint8_t pin_endstop_start, long max_distance_steps) {
-    if (_state != IDLE) {
-        Serial.println(F("Ошибка: Двигатель занят."));
+    if (isBusy()) {
+        Log::event(LOG_MOTOR_BUSY);
         return;
     }
     
@@ -139,23 +392,65 @@ void StepperMotor::startCalibration(uint8_t pin_endstop_start, long max_distance
     _max_pos = max_distance_steps;  // Устанавливаем максимальную позицию
     
     pinMode(_pin_endstop_start, INPUT_PULLUP);
+#if defined(__AVR__)
+    _endstop_in = portInputRegister(digitalPinToPort(_pin_endstop_start));
+    _endstop_mask = digitalPinToBitMask(_pin_endstop_start);
+#endif
+    Endstops::attach(this, _pin_endstop_start);
 
-    Serial.println(F("Начало калибровки..."));
-    Serial.println(F("Движение к начальному концевику..."));
-    Serial.print(F("Максимальное расстояние установлено: "));
-    Serial.print(_max_pos);
-    Serial.println(F(" шагов."));
+    Log::event(LOG_CALIBRATION_START, _axis, _max_pos);
     
     enable();
-    digitalWrite(_pin_dir, LOW); // Направление к началу
-    
     _state = CALIBRATING_HOME;
-    _last_step_time = micros();
     _calibrated = false;
+    startApproach(_homing_rate);
+}
+
+bool StepperMotor::restorePosition(long position, long max_distance_steps) {
+    if (isBusy()) {
+        return false;
+    }
+    noInterrupts();
+    _current_pos = position;
+    interrupts();
+    _unit_target = (int64_t)position << STEPPER_SCALE_BITS;
+    _max_pos = max_distance_steps;
+    _calibrated = true;
+    return true;
+}
+
+// Движение к началу до срабатывания концевика
+void StepperMotor::startApproach(uint32_t rate) {
+    setDirection(false);
+    startSteps(STEP_ENGINE_CONTINUOUS, false, rate);
+    armEndstop();
+}
+
+void StepperMotor::armEndstop() {
+    noInterrupts();
+    _endstop_hit = false;
+    _endstop_armed = true;
+    // Концевик уже замкнут - фронта не будет, срабатываем сразу
+    if (readEndstop()) {
+        latchEndstop();
+    }
+    interrupts();
+}
+
+// Вызывается из прерывания PCINT: шаг, подготовленный на следующий
+// такт, отменяется, позиция на момент срабатывания сохраняется
+void StepperMotor::latchEndstop() {
+    _isr_running = false;
+    _isr_step_pending = false;
+    _endstop_pos = _current_pos;
+    _endstop_time = micros();
+    _endstop_armed = false;
+    _endstop_hit = true;
 }
 
 void StepperMotor::update() {
     static bool was_calibrating_return = false;
+    Bench::begin(BENCH_MOTOR_UPDATE);
     
     // Запоминаем, была ли калибровка
     if (_state == CALIBRATING_RETURN) {
@@ -166,7 +461,7 @@ void StepperMotor::update() {
         case IDLE:
             // Если только что завершилась калибровка
             if (was_calibrating_return) {
-                Serial.println(F("Калибровка завершена."));
+                Log::event(LOG_CALIBRATION_DONE, _axis);
                 was_calibrating_return = false;
             }
             break;
@@ -176,6 +471,8 @@ void StepperMotor::update() {
             break;
             
         case CALIBRATING_HOME:
+        case CALIBRATING_BACKOFF:
+        case CALIBRATING_LOCATE:
         case CALIBRATING_PAUSE:
             updateCalibration();
             break;
@@ -183,80 +480,108 @@ void StepperMotor::update() {
         case CALIBRATING_RETURN:
             updateMovement(); // Используем тот же механизм для движения
             break;
-            
-        case STEP_HIGH:
-        case STEP_LOW:
-            updateMovement();
+
+        case RUNNING:
+            updateVelocity();
             break;
     }
+    Bench::end(BENCH_MOTOR_UPDATE);
+}
+
+// Режим скорости: профиль в прерывании перенацеливается на новую
+// скорость; перед сменой направления колесо тормозит до скорости старта
+void StepperMotor::updateVelocity() {
+    bool reverse = _velocity_hz == 0 || (_velocity_hz > 0) != (_isr_dir > 0);
+    uint32_t target = reverse ? _start_rate : StepEngine::rateFromHz(abs(_velocity_hz));
+
+    noInterrupts();
+    if (target != _velocity_rate) {
+        StepEngine::retargetRamp(_isr_ramp, target);
+        _velocity_rate = target;
+    }
+    bool stopped = reverse && _isr_ramp.rate <= _start_rate;
+    interrupts();
+
+    if (!stopped) {
+        return;
+    }
+    stopSteps();
+    if (_velocity_hz == 0) {
+        _state = IDLE;
+        disable();
+        return;
+    }
+    // Разгон в обратную сторону
+    setDirection(_velocity_hz > 0);
+    _velocity_rate = StepEngine::rateFromHz(abs(_velocity_hz));
+    startSteps(STEP_ENGINE_CONTINUOUS, _velocity_hz > 0, _velocity_rate);
 }
 
 void StepperMotor::updateMovement() {
-    unsigned long current_time = micros();
-    
-    if (_state == MOVING || _state == STEP_HIGH || _state == STEP_LOW || _state == CALIBRATING_RETURN) {
-        if (current_time - _last_step_time >= _delay_micros) {
-            if (_state == MOVING || _state == STEP_LOW || _state == CALIBRATING_RETURN) {
-                // Время для HIGH импульса
-                stepHigh();
-                _state = STEP_HIGH;
-            } else if (_state == STEP_HIGH) {
-                // Время для LOW импульса
-                stepLow();
-                _steps_remaining--;
-                
-                // Обновляем позицию
-                if (_target_pos > _current_pos) {
-                    _current_pos++;
-                } else {
-                    _current_pos--;
-                }
-                
-                if (_steps_remaining > 0) {
-                    _state = STEP_LOW;
-                } else {
-                    // Движение завершено
-                    _state = IDLE;
-                    disable(); // Выключаем драйвер
-                }
-            }
-        }
+    // Шаги выдаёт прерывание движка, здесь только ждём окончания задания
+    if (_isr_running) {
+        return;
     }
+
+    _state = IDLE;
+    disable(); // Выключаем драйвер
 }
 
 void StepperMotor::updateCalibration() {
-    unsigned long current_time = micros();
-    
+#if !defined(__AVR__) && !defined(ARDUINO_SIM)
+    // Без прерываний PCINT концевик опрашивается из loop()
+    Endstops::handleChange();
+#endif
     switch (_state) {
         case CALIBRATING_HOME:
-            if (digitalRead(_pin_endstop_start) == LOW) {
-                // Концевик сработал
-                _current_pos = 0;
-                Serial.println(F("Начальная точка найдена. Установлена позиция 0."));
-                Serial.print(F("Длина рейки установлена: "));
-                Serial.print(_max_pos);
-                Serial.println(F(" шагов."));
-                
-                _calibrated = true;
+        case CALIBRATING_LOCATE:
+            if (!_endstop_hit || micros() - _endstop_time < STEPPER_ENDSTOP_DEBOUNCE_US) {
+                break;
+            }
+            if (!readEndstop()) {
+                // Помеха: концевик отпущен, продолжаем подход
+                startApproach(_state == CALIBRATING_HOME ? _homing_rate : _locate_rate);
+                break;
+            }
+            if (_state == CALIBRATING_HOME) {
+                // Быстрый подход закончен - отходим для точного подхода
+                _state = CALIBRATING_BACKOFF;
+                setDirection(true);
+                startSteps(STEPPER_HOMING_BACKOFF_STEPS, true, _homing_rate);
+                break;
+            }
+            // Точка срабатывания при медленном подходе - позиция 0;
+            // шаги после неё (не больше одного) сохраняются в позиции
+            noInterrupts();
+            _current_pos -= _endstop_pos;
+            interrupts();
+            _unit_target = (int64_t)_current_pos << STEPPER_SCALE_BITS;
+            Log::event(LOG_HOME_FOUND, _axis, _max_pos);
+            
+            _calibrated = true;
+            disable();
+            _state = CALIBRATING_PAUSE;
+            _pause_start_time = millis();
+            break;
+
+        case CALIBRATING_BACKOFF:
+            if (_isr_running) {
+                break;
+            }
+            if (readEndstop()) {
+                Log::event(LOG_ENDSTOP_STUCK);
                 disable();
-                _state = CALIBRATING_PAUSE;
-                _pause_start_time = millis();
-            } else {
-                // Продолжаем движение
-                if (current_time - _last_step_time >= _delay_micros) {
-                    if (!_pulse_state) {
-                        stepHigh();
-                    } else {
-                        stepLow();
-                    }
-                }
+                _state = IDLE;
+                break;
             }
+            _state = CALIBRATING_LOCATE;
+            startApproach(_locate_rate);
             break;
             
         case CALIBRATING_PAUSE:
             if (millis() - _pause_start_time >= 500) {
                 // Пауза закончилась, калибровка завершена
-                Serial.println(F("Калибровка завершена."));
+                Log::event(LOG_CALIBRATION_DONE, _axis);
                 _state = IDLE;
             }
             break;
@@ -269,9 +594,33 @@ void StepperMotor::updateCalibration() {
 }
 
 long StepperMotor::getCurrentPosition() {
-    return _current_pos;
+    // 32-битное значение меняется в прерывании - читаем атомарно
+    noInterrupts();
+    long pos = _current_pos;
+    interrupts();
+    return pos;
 }
 
 bool StepperMotor::isCalibrated() {
     return _calibrated;
+}
+
+int8_t StepperMotor::getAxis() {
+    return _axis;
+}
+
+bool StepperMotor::drivesPin(uint8_t pin) {
+    return pin == _pin_ena || pin == _pin_dir || pin == _pin_pul;
+}
+
+long StepperMotor::getMaxPosition() {
+    return _max_pos;
+}
+
+long StepperMotor::getSpeed() {
+    return _speed_hz;
+}
+
+long StepperMotor::getAcceleration() {
+    return _accel_hz;
 }
\ No newline at end of file
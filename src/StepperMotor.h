@@ -2,22 +2,52 @@
 #define STEPPER_MOTOR_H
 
 #include <Arduino.h>
+#include "StepEngine.h"
+#include "InputShaper.h"
+
+// Позиции в мм и градусах передаются в тысячных долях единицы
+// (микрометры и миллиградусы), как их выдаёт разбор G-code
+#define STEPPER_UNIT_SCALE 1000L
+
+// Калибровка в две фазы: быстрый подход к концевику, отход на
+// STEPPER_HOMING_BACKOFF_STEPS и медленный повторный подход
+#define STEPPER_HOMING_BACKOFF_STEPS 200
+
+// Медленный подход по умолчанию - во столько раз медленнее быстрого
+#define STEPPER_HOMING_LOCATE_DIVISOR 8
+
+// Срабатывание концевика подтверждается, если через это время
+// он всё ещё замкнут; иначе это помеха и подход продолжается
+#define STEPPER_ENDSTOP_DEBOUNCE_US 2000UL
+
+// Дробные биты масштабов "шагов на тысячную долю единицы" (формат Q8.24):
+// при 80 шагах/мм ошибка на 1 м пути - сотые доли шага
+#define STEPPER_SCALE_BITS 24
 
 enum MotorState {
     IDLE,
     MOVING,
-    CALIBRATING_HOME,
+    CALIBRATING_HOME,    // Быстрый подход к концевику
+    CALIBRATING_BACKOFF, // Отход от концевика
+    CALIBRATING_LOCATE,  // Медленный повторный подход
     CALIBRATING_PAUSE,
     CALIBRATING_RETURN,
-    STEP_HIGH,
-    STEP_LOW
+    RUNNING // Режим скорости (WHEEL)
 };
 
+// AXIS - ось с концевиком и пределами рейки, WHEEL - колесо:
+// непрерывное вращение в режиме скорости, без калибровки и пределов
 enum MotorType {
     WHEEL,
     AXIS,
 };
 
+// Пины задаются номерами при создании объекта. На AVR begin() один раз
+// переводит их в регистры портов и маски, и шаговый движок пишет PUL
+// всех осей одного порта одной записью - импульсы выходят одновременно.
+// Шаблона с пинами на этапе компиляции нет: движок обходит оси через
+// указатели на StepperMotor, и разрешённые компилятором пины не доходят
+// до прерывания.
 class StepperMotor {
 public:
     // Конструктор: принимает номера пинов для ENA, DIR, PUL
@@ -39,27 +69,93 @@ public:
     // Движение к абсолютной позиции (в шагах)
     bool moveTo(long absolute_pos);
 
-    // Движение к абсолютной позиции (в мм)
-    bool moveToMM(long absolute_pos_mm);
+    // Движение к абсолютной позиции (в мкм)
+    bool moveToMM(long absolute_pos_um);
     
-    // Движение к абсолютной позиции (в градусах)
-    bool moveToDeg(long absolute_pos_deg);
+    // Движение к абсолютной позиции (в миллиградусах)
+    bool moveToDeg(long absolute_pos_mdeg);
 
     // Движение на относительное количество шагов
     bool move(long relative_pos);
 
-    // Движение на относительное растояний
-    bool moveMM(long relative_pos_mm);
+    // Движение на относительное растояние (в мкм). Дробная часть шага
+    // не теряется, а переносится на следующие перемещения. Отсчёт - от
+    // текущей позиции, если ось двигали G1/G2/G3, щуп или готовые отрезки.
+    bool moveMM(long relative_pos_um);
+
+    // Движение на относительный угол (в миллиградусах)
+    bool moveDeg(long relative_pos_mdeg);
+
+    // Перевод абсолютной позиции в шаги с округлением
+    long mmToSteps(long pos_um);
+    long degToSteps(long pos_mdeg);
+
+    // Шагов на мм и на градус, заданные в конструкторе
+    float getStepsPerMM();
+    float getStepsPerDeg();
 
-    // Движение на относительный угол
-    bool moveDeg(long relative_pos_deg);
+    // Смена шагов на мм (настройки $100...): масштаб пересчитывается,
+    // позиция в шагах не меняется
+    void setStepsPerMM(float steps_per_mm);
+
+    // Режим скорости (только для WHEEL): плавный разгон или торможение
+    // до speed_hz без остановки, знак задаёт направление, 0 - плавная
+    // остановка. Смена направления - через остановку. Новую скорость
+    // можно задавать во время вращения. Позиция при этом считается по
+    // модулю 2^32: расстояние между отсчётами - (long)(a - b).
+    bool setVelocity(long speed_hz);
+
+    // Заданная скорость режима скорости в Гц со знаком
+    long getVelocity();
+
+    // Тип двигателя (по умолчанию AXIS)
+    void setMotorType(MotorType type);
+    MotorType getMotorType();
 
     // Проверка, выполняется ли операция
     bool isBusy();
 
+    // Немедленная остановка без торможения и отключение драйвера (сброс
+    // через StepEngine::abort()). position_lost - двигатель шагал, и
+    // позиция могла сбиться: калибровка сбрасывается.
+    void abort(bool position_lost);
+
+    // Выполняется ли калибровка
+    bool isCalibrating();
+
+    // Калибровка без поиска концевика: позиция, сохранённая перед
+    // выключением (Settings), принимается как найденная G28.
+    // Только для неподвижного двигателя.
+    bool restorePosition(long position, long max_distance_steps);
+
     // Установка скорости вращения в Гц (шагов в секунду)
     void setSpeed(long speed_hz);
 
+    // Установка скорости в мм/мин или градусах/с (пересчитывается в Гц один раз)
+    void setSpeedMM(long mm_per_min);
+    void setSpeedDeg(long deg_per_s);
+
+    // Установка ускорения в шагах/с^2 (0 - без разгона и торможения)
+    void setAcceleration(long accel);
+
+    // Ограничение рывка в шагах/с^3 для S-образного профиля (0 - трапеция)
+    void setJerk(long jerk);
+
+    // Подавление резонанса при координированном движении (ShaperType,
+    // частота резонанса в Гц, доля критического затухания). Только на
+    // неподвижном двигателе; false - двигатель занят или задержка
+    // формирователя не помещается в историю (см. InputShaper.h), или
+    // заняты все STEP_ENGINE_SHAPERS формирователей.
+    bool setInputShaper(uint8_t type, float freq_hz, float damping);
+
+    // Скорость быстрого подхода к концевику при калибровке в Гц и
+    // медленного повторного подхода (0 - в STEPPER_HOMING_LOCATE_DIVISOR
+    // раз медленнее быстрого)
+    void setHomingSpeed(long speed_hz, long locate_speed_hz = 0);
+
+    // Установка направления вращения (вперёд - к увеличению позиции)
+    void setDirection(bool forward);
+
     // Включение драйвера (подача питания на мотор)
     void enable();
 
@@ -72,39 +168,118 @@ public:
     // Проверка, откалиброван ли двигатель
     bool isCalibrated();
 
+    // Номер оси в шаговом движке (-1 до вызова begin())
+    int8_t getAxis();
+
+    // Максимальная позиция (длина рейки в шагах)
+    long getMaxPosition();
+
+    // Выход драйвера на пине: ENA, DIR или PUL
+    bool drivesPin(uint8_t pin);
+
+    // Скорость в Гц и ускорение в шагах/с^2, заданные setSpeed()/setAcceleration()
+    long getSpeed();
+    long getAcceleration();
+
 private:
-    void stepHigh(); // Установить пин PUL в HIGH
-    void stepLow();  // Установить пин PUL в LOW
+    friend class StepEngine;
+    friend class Endstops;
+    friend class Probe;
+
+    // Установить/сбросить пин PUL - вызываются из прерывания движка
+#if defined(__AVR__)
+    inline void pulseHigh() { *_pul_out |= _pul_mask; }
+    inline void pulseLow() { *_pul_out &= ~_pul_mask; }
+    inline void writeDirection(bool forward) {
+        if (forward) *_dir_out |= _dir_mask; else *_dir_out &= ~_dir_mask;
+    }
+#else
+    inline void pulseHigh() { digitalWrite(_pin_pul, HIGH); }
+    inline void pulseLow() { digitalWrite(_pin_pul, LOW); }
+    inline void writeDirection(bool forward) { digitalWrite(_pin_dir, forward ? HIGH : LOW); }
+#endif
+
+    // Замкнут ли концевик (активный уровень - LOW)
+#if defined(__AVR__)
+    inline bool readEndstop() { return !(*_endstop_in & _endstop_mask); }
+#else
+    inline bool readEndstop() { return digitalRead(_pin_endstop_start) == LOW; }
+#endif
+
+    void armEndstop(); // Ждать срабатывания концевика
+    void latchEndstop(); // Остановка по концевику - из прерывания
+    void startApproach(uint32_t rate); // Подход к концевику
+    void startSteps(uint32_t steps, bool forward, uint32_t rate); // Передать задание движку
+    bool moveToScaled(int64_t target); // Движение к позиции в шагах Q.24
+    int64_t scaledBase(); // Начало относительного перемещения в шагах Q.24
+    void stopSteps(); // Остановить выдачу шагов
     void updateMovement(); // Обновление движения
     void updateCalibration(); // Обновление калибровки
+    void updateVelocity(); // Обновление режима скорости
+    bool followsLine() { return _isr_line || shaping(); } // Занят координированным движением
+    bool shaping() { return _shaper != NULL && _shaper->isActive(); } // Формирователь выдаёт шаги
     
     // Пины
+    int8_t _axis; // Номер оси в шаговом движке
     uint8_t _pin_ena;
     uint8_t _pin_dir;
     uint8_t _pin_pul;
     uint8_t _pin_endstop_start;
+#if defined(__AVR__)
+    volatile uint8_t* _pul_out; // Регистр порта пина PUL
+    uint8_t _pul_mask;          // Маска бита пина PUL
+    uint8_t _pul_port;          // Номер порта PUL в шаговом движке
+    volatile uint8_t* _dir_out; // Регистр порта пина DIR
+    uint8_t _dir_mask;          // Маска бита пина DIR
+    volatile uint8_t* _endstop_in; // Регистр входа пина концевика
+    uint8_t _endstop_mask;
+#endif
 
     // Характеристики
     MotorType _motor_type;
     bool _reverse;
     float _steps_per_mm;
     float _steps_per_degre;
+    int32_t _mm_scale;  // Шагов на мкм (Q8.24)
+    int32_t _deg_scale; // Шагов на миллиградус (Q8.24)
+    int64_t _unit_target; // Цель последнего перемещения в единицах с дробной частью шага (Q.24)
 
     // Состояние
     MotorState _state;
-    int32_t _current_pos; // Текущая позиция в шагах
+    volatile int32_t _current_pos; // Текущая позиция в шагах (меняется в прерывании)
     int32_t _max_pos;     // Максимальная позиция (длина рейки в шагах)
-    int32_t _target_pos;  // Целевая позиция
-    int32_t _steps_remaining; // Количество оставшихся шагов
     
     // Тайминги
-    uint16_t _delay_micros; // Задержка между шагами для контроля скорости
-    uint32_t _last_step_time; // Время последнего шага
+    long _speed_hz;      // Скорость в Гц
+    long _accel_hz;      // Ускорение в шагах/с^2
+    uint32_t _step_rate; // Скорость в формате движка (доля шага за такт, Q0.32)
+    uint32_t _homing_rate; // Скорость быстрого подхода к концевику
+    uint32_t _locate_rate; // Скорость медленного подхода
+    uint32_t _start_rate; // Начальная скорость разгона
+    uint32_t _accel;      // Ускорение (приращение скорости за такт, Q8)
+    uint32_t _jerk;       // Рывок (приращение ускорения за такт)
     uint32_t _pause_start_time; // Время начала паузы
+    long _velocity_hz;    // Заданная скорость режима скорости (со знаком)
+    uint32_t _velocity_rate; // Скорость, к которой сейчас идёт профиль
+
+    // Состояние генератора шагов (общее с прерыванием)
+    volatile uint32_t _isr_steps; // Оставшиеся шаги или STEP_ENGINE_CONTINUOUS
+    uint32_t _isr_accum;          // Фазовый накопитель
+    int8_t _isr_dir;              // +1 или -1
+    StepRamp _isr_ramp;           // Профиль скорости (считается в прерывании)
+    volatile bool _isr_running;   // Задание выполняется
+    volatile bool _isr_line;      // Ось ведёт координированное движение
+    volatile bool _isr_step_pending; // Шаг будет выдан на следующем такте
+    InputShaper* _shaper;         // Формирователь из набора StepEngine, NULL - шаги сразу на пин
+
+    // Концевик (общее с прерыванием PCINT)
+    volatile bool _endstop_armed; // Срабатывание остановит шаги
+    volatile bool _endstop_hit;   // Сработал, ждёт подтверждения
+    volatile int32_t _endstop_pos; // Позиция в момент срабатывания
+    volatile uint32_t _endstop_time; // Время срабатывания (мкс)
     
     // Флаги
     bool _calibrated;  // Флаг, что калибровка пройдена
-    bool _pulse_state; // Состояние импульса (HIGH/LOW)
 };
 
 #endif
\ No newline at end of file
@@ -1,5 +1,19 @@
 #include <Arduino.h>
 #include "StepperMotor.h"
+#include "Planner.h"
+#include "AxisGroup.h"
+#include "Arc.h"
+#include "SegmentReplay.h"
+#include "GCodeParser.h"
+#include "Console.h"
+#include "BinaryLink.h"
+#include "SerialInput.h"
+#include "Log.h"
+#include "StepStats.h"
+#include "Settings.h"
+#include "Probe.h"
+#include "Program.h"
+#include "Bench.h"
 
 // --- НАСТРОЙКИ ---
 // Пины для первого двигателя
@@ -14,194 +28,758 @@ const int PIN_Y_DIR = 6;
 const int PIN_Y_PUL = 7;
 const int PIN_Y_ENDSTOP = 9;
 
+// Вход щупа G38 по умолчанию (A0); меняется настройкой $6, в том
+// числе на пин концевика
+const int PIN_PROBE = 14;
+
 // Максимальные расстояния в шагах
 const long MAX_X_STEPS = 10000;
 const long MAX_Y_STEPS = 10000;
 
-// Создаем два двигателя
-StepperMotor motorX(PIN_X_ENA, PIN_X_DIR, PIN_X_PUL, false, 80.0, 1.8);
-StepperMotor motorY(PIN_Y_ENA, PIN_Y_DIR, PIN_Y_PUL, false, 80.0, 1.8);
+// Шагов на мм
+const float X_STEPS_PER_MM = 80.0;
+const float Y_STEPS_PER_MM = 80.0;
+
+// Создаем два двигателя. PUL обеих осей на порту D, поэтому шаги X и Y
+// выдаются одной записью в порт.
+StepperMotor motorX(PIN_X_ENA, PIN_X_DIR, PIN_X_PUL, PIN_X_ENDSTOP, false, X_STEPS_PER_MM, 1.8);
+StepperMotor motorY(PIN_Y_ENA, PIN_Y_DIR, PIN_Y_PUL, PIN_Y_ENDSTOP, false, Y_STEPS_PER_MM, 1.8);
+
+// Скорость и ускорение осей (Гц, Гц/с). Окружение [env:bench] поднимает
+// их до предела движка, чтобы измерить наибольшую частоту шагов.
+#ifndef AXIS_SPEED_HZ
+#define AXIS_SPEED_HZ 6400
+#endif
+#ifndef AXIS_ACCEL_HZ_S
+#define AXIS_ACCEL_HZ_S 16000
+#endif
+
+// Настройки по умолчанию: действуют, пока в EEPROM нет записи.
+// Меняются командами $N=значение и сохраняются (см. Settings.h).
+// Хранятся во флеш-памяти: в ОЗУ только текущие значения.
+const SettingsData SETTINGS_DEFAULTS PROGMEM = {
+    { X_STEPS_PER_MM, Y_STEPS_PER_MM },    // $100, $101
+    { AXIS_SPEED_HZ, AXIS_SPEED_HZ },      // $110, $111
+    { AXIS_ACCEL_HZ_S, AXIS_ACCEL_HZ_S },  // $120, $121
+    { MAX_X_STEPS, MAX_Y_STEPS },          // $130, $131
+    { 40.0, 40.0 },                        // $150, $151: резонанс портала, Гц
+    { 0.1, 0.1 },                          // $160, $161: затухание
+    { SHAPER_NONE, SHAPER_NONE },          // $140, $141: без подавления резонанса
+    4800, // $25: быстрый подход к концевику
+    600,  // $24: медленный повторный подход для точности
+    PIN_PROBE, // $6: вход щупа
+    0     // $1: без восстановления позиции после парковки
+};
+
+// Сколько байт Serial разбирается за одну итерацию loop()
+const uint8_t SERIAL_BYTES_PER_LOOP = 16;
+
+// Коды ошибок в ответе "error:N" (1-4 - ошибки разбора, см. GCodeStatus)
+const uint8_t ERROR_UNKNOWN_COMMAND = 20;
+const uint8_t ERROR_EXECUTION = 21;
+
+// Строка разобрана, но ждёт места в очереди или окончания калибровки
+bool commandPending = false;
+
+// Запрошен отчёт "?", ещё не поместившийся в буфер передачи
+bool statusRequested = false;
+
+// Принятая команда - одна на текст и двоичные кадры: протокол
+// меняется только после ответа на последнюю команду
+GCodeCommand command;
+
+// Разбор входящих строк G-code
+GCodeParser parser(command);
 
-// Структура для хранения текущих координат
-struct Position {
-    long x = 0;
-    long y = 0;
-} currentPos, targetPos;
+// Двоичный протокол: кадры вместо строк, ответы без текста
+BinaryLink binaryLink(command);
+bool binaryMode = false;
+// Режим, в который нужно перейти после подтверждения текущей команды
+bool binaryRequested = false;
+
+// Подача G1 (модальная, 0 - максимальная скорость осей): в шагах/мин
+// или в мм/мин, если задана в режиме G21
+long feedRate = 0;
+bool feedInMM = false;
+
+// Единицы координат G1: G21 - мм, G22 - шаги (по умолчанию)
+bool unitsMM = false;
 
 void printHelp() {
-    Serial.println(F("\n--- 2-осевая система управления (G-code) ---"));
-    Serial.println(F("Поддерживаемые G-code команды:"));
-    Serial.println(F("  G28        - Калибровка (Home) всех осей"));
-    Serial.println(F("  G28 X      - Калибровка только оси X"));
-    Serial.println(F("  G28 Y      - Калибровка только оси Y"));
-    Serial.println(F("  G1 X100 Y200 - Линейное перемещение в позицию X=100, Y=200"));
-    Serial.println(F("  G1 X500    - Перемещение только по оси X"));
-    Serial.println(F("  M114       - Показать текущие координаты"));
-    Serial.println(F("  M119       - Показать статус концевиков"));
-    Serial.println(F("--------------------------------------------"));
-}
-
-bool parseGCode(String command) {
-    command.toUpperCase();
-    command.trim();
-    
+    Console.print(F("\n--- "));
+    Console.print(AxisGroup::count());
+    Console.println(F("-осевая система управления (G-code) ---"));
+    Console.println(F("Поддерживаемые G-code команды:"));
+    Console.println(F("  G28        - Калибровка (Home) всех осей"));
+    Console.println(F("  G28 X      - Калибровка только оси X"));
+    Console.println(F("  G28 Y      - Калибровка только оси Y"));
+    Console.println(F("  G1 X100 Y200 - Линейное перемещение в позицию X=100, Y=200"));
+    Console.println(F("  G1 X500    - Перемещение только по оси X"));
+    Console.println(F("  G1 X100 F6000 - Перемещение с подачей 6000 шагов/мин"));
+    Console.println(F("  G2 X0 Y0 I500 J0 - Дуга по часовой, центр относительно начала"));
+    Console.println(F("  G3 X1000 Y0 R500 - Дуга против часовой по радиусу"));
+    Console.println(F("  G21        - Координаты в мм, подача в мм/мин (G1 X10.5 F600)"));
+    Console.println(F("  G22        - Координаты в шагах (по умолчанию)"));
+    Console.println(F("  G38.2 X3000 F600 - Перемещение до касания щупа: ответ [PRB:x,y:1],"));
+    Console.println(F("               без касания - [PRB:x,y:0] и ошибка; G38.3 - без ошибки"));
+    Console.println(F("  Слова можно писать в любом порядке, ( ) и ; - комментарии"));
+    Console.println(F("  M114       - Показать текущие координаты"));
+    Console.println(F("  M119       - Показать статус концевиков"));
+    Console.println(F("  M870       - Переход в двоичный протокол (см. BinaryLink.h)"));
+    Console.println(F("  M860       - Статистика таймингов шагов (сборка с -D STEP_STATS)"));
+    Console.println(F("  M861       - Сброс статистики таймингов"));
+    Console.println(F("  M872 S2 P0 - Сообщения: уровень 0-3, P1 - только коды [MSG:код ...]"));
+    Console.println(F("  $$         - Список настроек; $110=8000 - изменить (хранятся в EEPROM)"));
+    Console.println(F("  $140=3 $150=42.5 $160=0.1 - Подавление резонанса оси X: EI на 42.5 Гц"));
+    Console.println(F("  M873       - Настройки по умолчанию"));
+    Console.println(F("  M874       - Парковка перед выключением: позиция сохраняется, драйверы"));
+    Console.println(F("               держат оси; при $1=1 после включения G28 не нужна"));
+    Console.println(F("  M880 ... M881 - Запись программы в EEPROM: строки G между ними"));
+    Console.println(F("               сохраняются, а не выполняются"));
+    Console.println(F("  M882 L100 X50 I10 - Программа 100 раз со смещением X на 50,"));
+    Console.println(F("               растущим на 10 с каждым повтором (Y, J - для Y)"));
+    Console.println(F("  M883       - Текст сохранённой программы"));
+    Console.println(F("Каждая строка подтверждается \"ok\" или \"error:N\" при приёме в очередь."));
+    Console.println(F("M114 добавляет Q:<свободно блоков> R:<свободно байт приёма>."));
+    Console.println(F("Сразу, вне очереди: ? - состояние, ! - удержание подачи,"));
+    Console.println(F("  ~ - продолжить, Ctrl-X - сброс движения (ответ [RESET])"));
+    Console.println(F("--------------------------------------------"));
+}
+
+// Сообщение с целью перемещения по первым двум осям группы
+void logTarget(uint8_t code, const long target[STEP_ENGINE_MAX_AXES]) {
+    long pos[2] = { 0, 0 };
+    for (uint8_t i = 0; i < AxisGroup::count() && i < 2; i++) {
+        pos[i] = target[AxisGroup::motor(i)->getAxis()];
+    }
+    Log::event(code, pos[0], pos[1]);
+}
+
+// Можно ли выполнить строку сейчас, не дожидаясь внутри loop():
+// перемещения ждут места в очереди, калибровка - окончания движения
+bool commandReady(const GCodeCommand& cmd) {
+    // Хорды начатой дуги встают в очередь раньше следующих перемещений,
+    // готовые отрезки с ПК выполняются до конца
+    bool idle = !AxisGroup::isCalibrating() && !Arc::isBusy() && !SegmentReplay::isBusy() &&
+        !Probe::isBusy();
+    // Щуп, настройки, парковка и запись программы - только на неподвижных
+    // осях: очередь пуста раньше, чем формирователь выдаст последние шаги
+    if (cmd.isCode('G', 28) || cmd.isCode('G', 38, 2) || cmd.isCode('G', 38, 3) || cmd.has('$') ||
+            cmd.isCode('M', 873) || cmd.isCode('M', 874) || cmd.isCode('M', 880)) {
+        return idle && !Planner::isBusy() && !StepEngine::lineBusy();
+    }
+    if (cmd.isCode('G', 1) || cmd.isCode('G', 2) || cmd.isCode('G', 3)) {
+        return idle && !Planner::isFull();
+    }
+    return true;
+}
+
+// Строка с ПК: перемещения, настройки и запись ждут окончания программы
+// M882, запросы (M114, M119, ...) выполняются и во время неё
+bool hostCommandReady(const GCodeCommand& cmd) {
+    if (Program::isRunning() && (cmd.has('G') || cmd.has('$') || cmd.isCode('M', 873) ||
+            cmd.isCode('M', 874) || cmd.isCode('M', 880) || cmd.isCode('M', 882))) {
+        return false;
+    }
+    return commandReady(cmd);
+}
+
+// Во время записи программы (M880) строки G сохраняются, а не выполняются
+bool recording(const GCodeCommand& cmd) {
+    return Program::isRecording() && cmd.has('G');
+}
+
+// Отрезок с ПК ждёт окончания перемещений из G-code и места в очереди
+bool segmentReady() {
+    return !AxisGroup::isCalibrating() && !Arc::isBusy() && !Planner::isBusy() &&
+        !Probe::isBusy() && !Program::isRunning() && !SegmentReplay::isFull();
+}
+
+// Поле осей двоичного кадра для оси группы (-1 - оси нет в кадрах)
+int8_t binaryField(uint8_t index) {
+    for (uint8_t field = 0; field < BINARY_AXIS_COUNT; field++) {
+        if (BINARY_AXES[field] == AxisGroup::letter(index)) return field;
+    }
+    return -1;
+}
+
+// Постановка отрезка из кадра BINARY_SEGMENT. Возвращает 0 или код ошибки.
+uint8_t executeSegment(const BinarySegment& packet) {
+    Settings::clearPosition();
+    ReplaySegment segment;
+    for (uint8_t i = 0; i < STEP_ENGINE_MAX_AXES; i++) {
+        segment.steps[i] = 0;
+    }
+    const int16_t steps[BINARY_AXIS_COUNT] = { packet.x, packet.y };
+    uint8_t fields = 0;
+    for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+        int8_t field = binaryField(i);
+        if (field < 0) continue;
+        segment.steps[AxisGroup::motor(i)->getAxis()] = steps[field];
+        fields |= 1 << field;
+    }
+    // Шаги по оси, которой нет в группе, выполнить нельзя
+    for (uint8_t field = 0; field < BINARY_AXIS_COUNT; field++) {
+        if (!(fields & (1 << field)) && steps[field] != 0) return ERROR_EXECUTION;
+    }
+    segment.start_hz = packet.start_hz;
+    segment.end_hz = packet.end_hz;
+    segment.accel = packet.accel;
+    if (!SegmentReplay::push(segment)) {
+        return ERROR_EXECUTION;
+    }
+    if (packet.flags & BINARY_SEGMENT_LAST) {
+        SegmentReplay::flush();
+    }
+    return 0;
+}
+
+// Выполнение разобранной строки G-code. Возвращает 0 или код ошибки.
+uint8_t executeGCode(const GCodeCommand& cmd) {
+    // Оси сдвинутся: позиция, сохранённая парковкой, больше не верна
+    if (cmd.isCode('G', 28) || cmd.isCode('G', 1) || cmd.isCode('G', 2) || cmd.isCode('G', 3) ||
+            cmd.isCode('G', 38, 2) || cmd.isCode('G', 38, 3)) {
+        Settings::clearPosition();
+    }
+
+    // $$ - список настроек, $N=значение - изменение с записью в EEPROM
+    if (cmd.has('$')) {
+        if (!cmd.has('=')) {
+            Settings::report();
+            return 0;
+        }
+        return Settings::set(cmd.integer('$'), cmd.value('=')) ? 0 : ERROR_EXECUTION;
+    }
+
     // G28 - Home (калибровка)
-    if (command.startsWith("G28")) {
-        if (command.indexOf("X") >= 0 && command.indexOf("Y") >= 0) {
-            // Калибровка обеих осей
-            Serial.println(F("Начинаем калибровку обеих осей..."));
-            if (!motorX.isBusy() && !motorY.isBusy()) {
-                motorX.startCalibration(PIN_X_ENDSTOP, MAX_X_STEPS);
-                motorY.startCalibration(PIN_Y_ENDSTOP, MAX_Y_STEPS);
-                return true;
-            }
-        } else if (command.indexOf("X") >= 0) {
-            // Калибровка только X
-            Serial.println(F("Калибровка оси X..."));
-            if (!motorX.isBusy()) {
-                motorX.startCalibration(PIN_X_ENDSTOP, MAX_X_STEPS);
-                return true;
-            }
-        } else if (command.indexOf("Y") >= 0) {
-            // Калибровка только Y
-            Serial.println(F("Калибровка оси Y..."));
-            if (!motorY.isBusy()) {
-                motorY.startCalibration(PIN_Y_ENDSTOP, MAX_Y_STEPS);
-                return true;
-            }
-        } else {
-            // G28 без параметров - калибровка обеих осей
-            Serial.println(F("Калибровка всех осей..."));
-            if (!motorX.isBusy() && !motorY.isBusy()) {
-                motorX.startCalibration(PIN_X_ENDSTOP, MAX_X_STEPS);
-                motorY.startCalibration(PIN_Y_ENDSTOP, MAX_Y_STEPS);
-                return true;
-            }
+    if (cmd.isCode('G', 28)) {
+        // Калибровка начинается после выполнения очереди перемещений
+        Planner::synchronize();
+        // G28 без букв осей - калибровка всех осей
+        uint8_t axes = AxisGroup::mask(cmd);
+        if (axes == 0) axes = AXIS_GROUP_ALL;
+        Log::event(LOG_HOMING_AXES, axes);
+        if (AxisGroup::isBusy(axes)) {
+            Log::event(LOG_AXES_BUSY);
+            return ERROR_EXECUTION;
         }
-        Serial.println(F("Ошибка: Один или оба двигателя заняты"));
-        return false;
+        AxisGroup::startCalibration(axes);
+        return 0;
     }
     
     // G1 - Линейное перемещение
-    else if (command.startsWith("G1")) {
-        if (motorX.isBusy() || motorY.isBusy()) {
-            Serial.println(F("Ошибка: Двигатели заняты"));
-            return false;
+    else if (cmd.isCode('G', 1)) {
+        // Подача модальная: действует и на следующие G1
+        if (cmd.has('F')) {
+            feedRate = cmd.integer('F');
+            feedInMM = unitsMM;
         }
         
-        bool hasX = false, hasY = false;
-        long newX = currentPos.x, newY = currentPos.y;
-        
-        // Парсим X координату
-        int xIndex = command.indexOf("X");
-        if (xIndex >= 0) {
-            String xStr = "";
-            for (int i = xIndex + 1; i < command.length(); i++) {
-                char c = command.charAt(i);
-                if (c == ' ' || c == 'Y' || c == 'Z') break;
-                if (isdigit(c) || c == '-' || c == '.') xStr += c;
-            }
-            if (xStr.length() > 0) {
-                newX = xStr.toInt();
-                hasX = true;
+        if (AxisGroup::mask(cmd) != 0) {
+            // Новая точка отсчитывается от конца последнего блока в очереди
+            long target[STEP_ENGINE_MAX_AXES];
+            AxisGroup::target(cmd, unitsMM, target);
+            
+            logTarget(LOG_MOVE_TO, target);
+            
+            // Блок встаёт в очередь планировщика, движение не прерывается
+            if (Planner::line(target, feedRate, feedInMM)) {
+                return 0;
+            } else {
+                Log::event(LOG_EXECUTION_FAILED);
+                return ERROR_EXECUTION;
             }
         }
+        return 0;
+    }
+    
+    // G2/G3 - Дуга по часовой / против часовой стрелки
+    else if (cmd.isCode('G', 2) || cmd.isCode('G', 3)) {
+        if (cmd.has('F')) {
+            feedRate = cmd.integer('F');
+            feedInMM = unitsMM;
+        }
         
-        // Парсим Y координату
-        int yIndex = command.indexOf("Y");
-        if (yIndex >= 0) {
-            String yStr = "";
-            for (int i = yIndex + 1; i < command.length(); i++) {
-                char c = command.charAt(i);
-                if (c == ' ' || c == 'X' || c == 'Z') break;
-                if (isdigit(c) || c == '-' || c == '.') yStr += c;
-            }
-            if (yStr.length() > 0) {
-                newY = yStr.toInt();
-                hasY = true;
-            }
+        // Конечная точка - как у G1, центр I/J или радиус R - в тех же
+        // единицах, дробная часть сохраняется и для шагов
+        // Дуга в плоскости XY (G17)
+        int8_t plane[2] = { AxisGroup::find('X'), AxisGroup::find('Y') };
+        if (plane[0] < 0 || plane[1] < 0) {
+            Log::event(LOG_NO_XY);
+            return ERROR_EXECUTION;
+        }
+        long steps[STEP_ENGINE_MAX_AXES];
+        AxisGroup::target(cmd, unitsMM, steps);
+        uint8_t axes[2];
+        long target[2];
+        float scale[2] = { 1, 1 };
+        for (uint8_t i = 0; i < 2; i++) {
+            StepperMotor* motor = AxisGroup::motor(plane[i]);
+            axes[i] = motor->getAxis();
+            target[i] = steps[axes[i]];
+            if (unitsMM) scale[i] = motor->getStepsPerMM();
         }
+        bool clockwise = cmd.isCode('G', 2);
         
-        if (hasX || hasY) {
-            Serial.print(F("Перемещение в: X="));
-            Serial.print(newX);
-            Serial.print(F(" Y="));
-            Serial.println(newY);
-            
-            bool success = true;
-            if (hasX) success &= motorX.moveTo(newX);
-            if (hasY) success &= motorY.moveTo(newY);
-            
-            if (success) {
-                targetPos.x = newX;
-                targetPos.y = newY;
-                Serial.println(F("OK"));
-                return true;
-            } else {
-                Serial.println(F("Ошибка выполнения команды"));
-                return false;
+        float offset[2];
+        if (cmd.has('R')) {
+            if (!Arc::radiusOffset(axes[0], axes[1], scale, target,
+                    (float)cmd.value('R') / GCODE_SCALE, clockwise, offset)) {
+                Log::event(LOG_ARC_RADIUS);
+                return ERROR_EXECUTION;
             }
+        } else if (cmd.has('I') || cmd.has('J')) {
+            offset[0] = (float)cmd.value('I') / GCODE_SCALE;
+            offset[1] = (float)cmd.value('J') / GCODE_SCALE;
+        } else {
+            Log::event(LOG_ARC_CENTER);
+            return ERROR_EXECUTION;
+        }
+        
+        logTarget(LOG_ARC_TO, steps);
+        
+        if (!Arc::start(axes[0], axes[1], scale, target, offset, clockwise, feedRate, feedInMM)) {
+            Log::event(LOG_EXECUTION_FAILED);
+            return ERROR_EXECUTION;
+        }
+        return 0;
+    }
+    
+    // G38.2/G38.3 - Перемещение до касания щупа. Ответ "ok" - при
+    // постановке, позиция касания приходит по окончании строкой [PRB:...]
+    else if (cmd.isCode('G', 38, 2) || cmd.isCode('G', 38, 3)) {
+        if (cmd.has('F')) {
+            feedRate = cmd.integer('F');
+            feedInMM = unitsMM;
+        }
+        if (AxisGroup::mask(cmd) == 0) {
+            Log::event(LOG_EXECUTION_FAILED);
+            return ERROR_EXECUTION;
         }
+        long target[STEP_ENGINE_MAX_AXES];
+        AxisGroup::target(cmd, unitsMM, target);
+        logTarget(LOG_MOVE_TO, target);
+        // G38.2 без касания - ошибка, G38.3 - нет
+        if (!Probe::start(target, feedRate, feedInMM, cmd.isCode('G', 38, 2))) {
+            return ERROR_EXECUTION;
+        }
+        return 0;
+    }
+    
+    // G21/G22 - Единицы координат
+    else if (cmd.isCode('G', 21) || cmd.isCode('G', 22)) {
+        unitsMM = cmd.isCode('G', 21);
+        return 0;
     }
     
     // M114 - Показать позицию
-    else if (command.startsWith("M114")) {
-        Serial.print(F("X:"));
-        Serial.print(motorX.getCurrentPosition());
-        Serial.print(F(" Y:"));
-        Serial.print(motorY.getCurrentPosition());
+    else if (cmd.isCode('M', 114)) {
+        for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+            if (i > 0) Console.print(' ');
+            Console.print(AxisGroup::letter(i));
+            Console.print(':');
+            Console.print(AxisGroup::motor(i)->getCurrentPosition());
+        }
         
-        if (motorX.isBusy() || motorY.isBusy()) {
-            Serial.println(F(" (движется)"));
-        } else {
-            Serial.println();
+        if (Planner::isBusy() || SegmentReplay::isBusy() || AxisGroup::isBusy() || Program::isRunning()) {
+            Console.print(F(" (движется)"));
         }
-        return true;
+        // Состояние буферов для потоковой передачи
+        Console.print(F(" Q:"));
+        Console.print(Planner::freeBlocks());
+        Console.print(F(" R:"));
+        Console.println(SerialInput::freeBytes());
+        return 0;
     }
     
     // M119 - Статус концевиков
-    else if (command.startsWith("M119")) {
-        Serial.print(F("X: "));
-        Serial.print(motorX.isCalibrated() ? F("Calibrated") : F("Not calibrated"));
-        Serial.print(F(" Y: "));
-        Serial.println(motorY.isCalibrated() ? F("Calibrated") : F("Not calibrated"));
-        return true;
+    else if (cmd.isCode('M', 119)) {
+        for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+            if (i > 0) Console.print(' ');
+            Console.print(AxisGroup::letter(i));
+            Console.print(F(": "));
+            Console.print(AxisGroup::motor(i)->isCalibrated() ? F("Calibrated") : F("Not calibrated"));
+        }
+        Console.println();
+        return 0;
+    }
+    
+    // M860 - Статистика таймингов, M861 - её сброс
+    else if (cmd.isCode('M', 860)) {
+        StepStats::report();
+        return 0;
+    }
+    else if (cmd.isCode('M', 861)) {
+        StepStats::reset();
+        return 0;
+    }
+    
+    // M872 - Сообщения: S - уровень подробности (0 - нет, 1 - ошибки,
+    // 2 - ход работы, 3 - отладка), P1 - только коды [MSG:...], P0 - текст
+    else if (cmd.isCode('M', 872)) {
+        if (cmd.has('S')) Log::setLevel(cmd.integer('S'));
+        if (cmd.has('P')) Log::setCodesOnly(cmd.integer('P') != 0);
+        return 0;
+    }
+    
+    // M873 - Настройки по умолчанию
+    else if (cmd.isCode('M', 873)) {
+        Settings::restoreDefaults();
+        return 0;
+    }
+    
+    // M874 - Парковка перед выключением
+    else if (cmd.isCode('M', 874)) {
+        return Settings::park() ? 0 : ERROR_EXECUTION;
+    }
+    
+    // M880 - Запись программы, M881 - её конец
+    else if (cmd.isCode('M', 880)) {
+        return Program::record() ? 0 : ERROR_EXECUTION;
+    }
+    else if (cmd.isCode('M', 881)) {
+        return Program::finish() ? 0 : ERROR_EXECUTION;
+    }
+    
+    // M882 - Выполнение программы: L - повторов, X/Y - смещение,
+    // I/J - приращение смещения с каждым повтором, в единицах программы
+    else if (cmd.isCode('M', 882)) {
+        long loops = cmd.has('L') ? cmd.integer('L') : 1;
+        if (loops < 1) {
+            Log::event(LOG_EXECUTION_FAILED);
+            return ERROR_EXECUTION;
+        }
+        int32_t offset[2] = { cmd.value('X'), cmd.value('Y') };
+        int32_t step[2] = { cmd.value('I'), cmd.value('J') };
+        return Program::start(loops, offset, step) ? 0 : ERROR_EXECUTION;
+    }
+    
+    // M883 - Текст сохранённой программы
+    else if (cmd.isCode('M', 883)) {
+        Program::list();
+        return 0;
+    }
+    
+    // M870 - Двоичный протокол (после ответа "ok")
+    else if (cmd.isCode('M', 870)) {
+        binaryRequested = true;
+        return 0;
     }
     
-    Serial.println(F("Неизвестная команда"));
-    return false;
+    Log::event(LOG_UNKNOWN_COMMAND);
+    return ERROR_UNKNOWN_COMMAND;
+}
+
+// Подтверждение строки: хост считает байты неподтверждённых строк
+// и по каждому ответу освобождает место в приёмном буфере
+void acknowledge(uint8_t error) {
+    // Сообщения о выполнении строки - раньше ответа, если есть место
+    Log::drain();
+    if (binaryMode) {
+        binaryLink.sendAck(error);
+    } else if (error == 0) {
+        Console.println(F("ok"));
+    } else {
+        Console.print(F("error:"));
+        Console.println(error);
+    }
+    // Смена протокола - после ответа в прежнем формате
+    if (binaryRequested != binaryMode) {
+        binaryMode = binaryRequested;
+        Console.setMuted(binaryMode);
+        parser.reset();
+        binaryLink.reset();
+    }
+}
+
+// Команда, ожидающая выполнения, из текущего протокола
+const GCodeCommand& currentCommand() {
+    return binaryMode ? binaryLink.command() : parser.command();
+}
+
+// Отложенный кадр - отрезок, а не команда G-code
+bool segmentPending() {
+    return binaryMode && binaryLink.type() == BINARY_SEGMENT;
+}
+
+// Ответ на запрос состояния в двоичном протоколе
+void sendBinaryStatus() {
+    uint8_t state = 0;
+    if (Planner::isBusy() || SegmentReplay::isBusy() || AxisGroup::isBusy() || Program::isRunning()) {
+        state |= BINARY_STATE_MOVING;
+    }
+    if (AxisGroup::isCalibrating()) state |= BINARY_STATE_CALIBRATING;
+    long position[BINARY_AXIS_COUNT] = { 0, 0 };
+    for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+        int8_t field = binaryField(i);
+        if (field < 0) continue;
+        StepperMotor* motor = AxisGroup::motor(i);
+        position[field] = motor->getCurrentPosition();
+        // Флаги калибровки осей идут подряд в порядке полей
+        if (motor->isCalibrated()) state |= BINARY_STATE_X_CALIBRATED << field;
+    }
+    binaryLink.sendStatus(position[0], position[1], state,
+        Planner::freeBlocks(), SerialInput::freeBytes());
+}
+
+// Принятый двоичный кадр: перемещения выполняются как строки G-code
+void handlePacket() {
+    if (binaryLink.status() == BINARY_DUPLICATE) {
+        acknowledge(0); // Подтверждение потерялось, кадр уже выполнен
+        return;
+    }
+    if (binaryLink.status() != BINARY_OK) {
+        acknowledge(binaryLink.status());
+        return;
+    }
+    switch (binaryLink.type()) {
+        case BINARY_MOVE:
+        case BINARY_HOME:
+            if (recording(binaryLink.command())) {
+                acknowledge(Program::append(binaryLink.command()) ? 0 : ERROR_EXECUTION);
+            } else if (!hostCommandReady(binaryLink.command())) {
+                commandPending = true;
+            } else {
+                acknowledge(executeGCode(binaryLink.command()));
+            }
+            break;
+        case BINARY_SEGMENT:
+            if (!segmentReady()) {
+                commandPending = true;
+            } else {
+                acknowledge(executeSegment(binaryLink.segment()));
+            }
+            break;
+        case BINARY_QUERY:
+            sendBinaryStatus();
+            break;
+        case BINARY_TEXT_MODE:
+            binaryRequested = false;
+            acknowledge(0);
+            break;
+        default:
+            acknowledge(ERROR_UNKNOWN_COMMAND);
+            break;
+    }
+}
+
+// Состояние для отчёта "?"
+const __FlashStringHelper* machineState() {
+    if (AxisGroup::isCalibrating()) return F("Home");
+    // Торможение после касания щупа - часть G38, а не удержание
+    if (StepEngine::holdState() != HOLD_NONE && !Probe::isTriggered()) return F("Hold");
+    if (Planner::isBusy() || SegmentReplay::isBusy() || Arc::isBusy() || AxisGroup::isBusy() ||
+            Probe::isBusy() || Program::isRunning()) {
+        return F("Run");
+    }
+    return F("Idle");
+}
+
+// Значения отчёта "?", снятые один раз: длина считается и текст
+// выводится по одним и тем же числам
+struct StatusReport {
+    const __FlashStringHelper* state;
+    long position[STEP_ENGINE_MAX_AXES];
+    uint8_t queue_free;
+    uint8_t rx_free;
+};
+
+// Вывод, который только считает байты: длина отчёта без буфера под текст
+class LengthCounter : public Print {
+public:
+    LengthCounter() : length(0) {}
+    size_t write(uint8_t) { length++; return 1; }
+    size_t length;
+};
+
+void printStatusReport(Print& out, const StatusReport& report) {
+    out.print('<');
+    out.print(report.state);
+    out.print(F("|MPos:"));
+    for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+        if (i > 0) out.print(',');
+        out.print(report.position[i]);
+    }
+    out.print(F("|Q:"));
+    out.print(report.queue_free);
+    out.print(F("|R:"));
+    out.print(report.rx_free);
+    out.print(F(">\r\n"));
+}
+
+// Отчёт о состоянии: <Run|MPos:1000,2000|Q:7|R:127>. Отправляется, только
+// если целиком помещается в буфер передачи Serial, иначе - на следующей
+// итерации: опрос не останавливает loop() ожиданием порта.
+bool sendStatusReport() {
+    StatusReport report;
+    report.state = machineState();
+    for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+        report.position[i] = AxisGroup::motor(i)->getCurrentPosition();
+    }
+    report.queue_free = Planner::freeBlocks();
+    report.rx_free = SerialInput::freeBytes();
+    LengthCounter counter;
+    printStatusReport(counter, report);
+    if ((size_t)Serial.availableForWrite() < counter.length) {
+        return false;
+    }
+    printStatusReport(Console, report);
+    return true;
+}
+
+// Сброс Ctrl-X: движение останавливается сразу, очереди и недоразобранные
+// строки выбрасываются. После "[RESET]" хост начинает передачу заново.
+void resetMotion() {
+    StepEngine::abort();
+    Arc::abort();
+    Planner::reset();
+    SegmentReplay::reset();
+    Probe::reset();
+    Program::reset();
+    commandPending = false;
+    statusRequested = false;
+    parser.reset();
+    SerialInput::clear();
+    Console.println(F("[RESET]"));
+}
+
+// Команды реального времени, принятые SerialInput::poll()
+void handleRealtime() {
+    uint8_t flags = SerialInput::takeRealtime();
+    if (flags & REALTIME_FLAG_RESET) {
+        resetMotion();
+        return;
+    }
+    if (flags & REALTIME_FLAG_HOLD) {
+        StepEngine::feedHold();
+    }
+    // Остановку по касанию щупа продолжить нельзя
+    if ((flags & REALTIME_FLAG_RESUME) && !Probe::isTriggered()) {
+        StepEngine::resume();
+    }
+    if (flags & REALTIME_FLAG_STATUS) {
+        statusRequested = true;
+    }
+    if (statusRequested) {
+        statusRequested = !sendStatusReport();
+    }
+}
+
+// Сообщение о принятой строке: буква и номер команды
+void logCommand(const GCodeCommand& cmd) {
+    char letter = cmd.has('G') ? 'G' : cmd.has('M') ? 'M' : 0;
+    if (letter != 0) {
+        Log::event(LOG_COMMAND, letter, cmd.integer(letter));
+    }
 }
 
 void setup() {
     Serial.begin(115200);
     while (!Serial) { ; } // Ожидание подключения к порту
 
-    motorX.begin();
-    motorY.begin();
-    
-    motorX.setSpeed(1600);
-    motorY.setSpeed(1600);
+    // Оси станка: буква G-code, двигатель, концевик, длина рейки.
+    // Новая ось добавляется строкой в этой таблице.
+    AxisGroup::add('X', &motorX, PIN_X_ENDSTOP, MAX_X_STEPS);
+    AxisGroup::add('Y', &motorY, PIN_Y_ENDSTOP, MAX_Y_STEPS);
+    // Скорости, ускорения, длины реек и позиция после парковки - из EEPROM.
+    // До инициализации пинов: драйверы восстановленных осей не выключаются.
+    Settings::begin(SETTINGS_DEFAULTS);
+    AxisGroup::begin();
+    Program::begin();
 
-    Serial.println(F("2-осевая система управления инициализирована"));
+    Console.print(AxisGroup::count());
+    Console.println(F("-осевая система управления инициализирована"));
+    Console.print(F("Буферы: RX "));
+    Console.print(SERIAL_RX_BUFFER_SIZE);
+    Console.print(F(" байт, очередь "));
+    Console.print(PLANNER_BUFFER_SIZE - 1);
+    Console.println(F(" блоков"));
     printHelp();
+    StepStats::reset();
 }
 
 void loop() {
-    motorX.update();
-    motorY.update();
+    StepStats::loopStart();
+    Bench::mark(BENCH_LOOP);
+    // Приём - до всего остального: команды реального времени выполняются
+    // и тогда, когда строка ждёт места в очереди
+    SerialInput::poll(!binaryMode);
+    handleRealtime();
+    AxisGroup::update();
+    Bench::begin(BENCH_PLANNER_UPDATE);
+    Planner::update();
+    Bench::end(BENCH_PLANNER_UPDATE);
+    Probe::update();
+    Arc::update();
+    SegmentReplay::update();
+    Program::update();
+    Log::drain();
     
-    currentPos.x = motorX.getCurrentPosition();
-    currentPos.y = motorY.getCurrentPosition();
+    // Строка сохранённой программы - уже разобранная, по одной за итерацию
+    if (Program::hasLine() && commandReady(Program::line())) {
+        Bench::begin(BENCH_EXECUTE);
+        uint8_t error = executeGCode(Program::line());
+        Bench::end(BENCH_EXECUTE);
+        Program::next(error);
+    }
     
-    // Обработка команд из Serial
-    if (Serial.available() > 0) {
-        String command = Serial.readStringUntil('\n');
-        command.trim();
-        
-        if (command.length() > 0) {
-            Serial.print(F("Получена команда: "));
-            Serial.println(command);
-            parseGCode(command);
+    // Отложенная строка выполняется, как только это станет возможно;
+    // до этого новые байты не читаются и остаются в приёмном буфере
+    if (commandPending) {
+        if (segmentPending()) {
+            if (!segmentReady()) {
+                return;
+            }
+            commandPending = false;
+            acknowledge(executeSegment(binaryLink.segment()));
+        } else {
+            if (!hostCommandReady(currentCommand())) {
+                return;
+            }
+            commandPending = false;
+            Bench::begin(BENCH_EXECUTE);
+            uint8_t error = executeGCode(currentCommand());
+            Bench::end(BENCH_EXECUTE);
+            acknowledge(error);
         }
     }
-}
\ No newline at end of file
+    
+    // Обработка команд из Serial: не больше SERIAL_BYTES_PER_LOOP байт
+    // за итерацию, без ожидания конца строки
+    for (uint8_t i = 0; i < SERIAL_BYTES_PER_LOOP && SerialInput::available(); i++) {
+        if (binaryMode) {
+            if (!binaryLink.feed(SerialInput::read())) {
+                continue;
+            }
+            handlePacket();
+            break; // Один кадр за итерацию
+        }
+        uint8_t c = SerialInput::read();
+        Bench::begin(BENCH_PARSE_BYTE);
+        bool complete = parser.feed(c);
+        Bench::end(complete ? BENCH_PARSE_LINE : BENCH_PARSE_BYTE);
+        if (!complete) {
+            continue;
+        }
+        if (parser.status() != GCODE_OK) {
+            // Коды сообщений идут в порядке GCodeStatus
+            Log::event(LOG_PARSE_CHAR + parser.status() - GCODE_ERROR_CHAR);
+            acknowledge(parser.status());
+        } else if (parser.command().words == 0) {
+            acknowledge(0); // Строка из одних комментариев
+        } else if (recording(parser.command())) {
+            acknowledge(Program::append(parser.command()) ? 0 : ERROR_EXECUTION);
+        } else {
+            logCommand(parser.command());
+            if (!hostCommandReady(parser.command())) {
+                commandPending = true;
+            } else {
+                Bench::begin(BENCH_EXECUTE);
+                uint8_t error = executeGCode(parser.command());
+                Bench::end(BENCH_EXECUTE);
+                acknowledge(error);
+            }
+        }
+        break; // Одна команда за итерацию
+    }
+}
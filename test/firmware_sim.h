@@ -0,0 +1,204 @@
+#ifndef TEST_FIRMWARE_SIM_H
+#define TEST_FIRMWARE_SIM_H
+
+// Общее для тестов прошивки из src/main.cpp целиком: команды идут через
+// Serial, результат проверяется по трассе пинов в виртуальном времени.
+// Каждый тест начинается с bootFirmware() (и homeFirmware(), если нужны
+// перемещения) и не зависит от остальных.
+
+#include <unity.h>
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <math.h>
+#include <stdio.h>
+#include "Planner.h"
+#include "StepperMotor.h"
+#include "AxisGroup.h"
+#include "Arc.h"
+#include "BinaryLink.h"
+#include "SegmentReplay.h"
+#include "Program.h"
+
+void setup();
+void loop();
+void resetMotion();
+
+// Состояние main.cpp, которое на плате обнуляется при перезагрузке
+extern BinaryLink binaryLink;
+extern bool binaryMode;
+extern bool binaryRequested;
+extern long feedRate;
+extern bool feedInMM;
+extern bool unitsMM;
+
+// Пины из main.cpp
+const uint8_t PIN_X_DIR = 3;
+const uint8_t PIN_X_PUL = 4;
+const uint8_t PIN_Y_DIR = 6;
+const uint8_t PIN_Y_PUL = 7;
+const uint8_t PIN_X_ENDSTOP = 8;
+const uint8_t PIN_Y_ENDSTOP = 9;
+const uint8_t PIN_PROBE = 14;
+
+// Настройки скорости из setup()
+const long SPEED_HZ = 6400;
+const long ACCEL = 16000;
+
+const uint32_t TICK_NS = 1000000000UL / STEP_ENGINE_TICK_HZ;
+
+// Шаги оси по трассе: передние фронты PUL с учётом DIR
+struct AxisTrace {
+    long steps;          // Число импульсов
+    long position;       // Сумма шагов со знаком
+    uint64_t first_ns;   // Первый и последний фронт
+    uint64_t last_ns;
+    uint64_t min_width_ns;    // Минимальная длительность импульса
+    uint64_t min_period_ns;   // Минимальный интервал между шагами
+    uint64_t max_period_ns;   // Максимальный интервал (без первых и последних шагов)
+};
+
+inline AxisTrace analyze(uint8_t pul, uint8_t dir, size_t from, long skip_edges = 0) {
+    AxisTrace t = { 0, 0, 0, 0, UINT64_MAX, UINT64_MAX, 0 };
+    const std::vector<SimEdge>& trace = simTrace();
+    int dir_level = simPinLevel(dir);
+    // Направление на момент начала участка трассы
+    for (size_t i = from; i < trace.size(); i++) {
+        if (trace[i].pin == dir) { dir_level = !trace[i].level; break; }
+    }
+    uint64_t rise = 0;
+    std::vector<uint64_t> periods;
+    for (size_t i = from; i < trace.size(); i++) {
+        const SimEdge& e = trace[i];
+        if (e.pin == dir) dir_level = e.level;
+        if (e.pin != pul) continue;
+        if (e.level == HIGH) {
+            if (t.steps > 0) periods.push_back(e.time_ns - rise);
+            else t.first_ns = e.time_ns;
+            rise = e.time_ns;
+            t.last_ns = e.time_ns;
+            t.steps++;
+            t.position += dir_level ? 1 : -1;
+        } else if (e.time_ns - rise < t.min_width_ns) {
+            t.min_width_ns = e.time_ns - rise;
+        }
+    }
+    for (size_t i = 0; i < periods.size(); i++) {
+        if (periods[i] < t.min_period_ns) t.min_period_ns = periods[i];
+        if ((long)i >= skip_edges && (long)i + skip_edges < (long)periods.size() &&
+            periods[i] > t.max_period_ns) {
+            t.max_period_ns = periods[i];
+        }
+    }
+    return t;
+}
+
+// Число фронтов PUL оси с позиции трассы from
+inline long stepsSince(uint8_t pul, size_t from) {
+    long steps = 0;
+    const std::vector<SimEdge>& trace = simTrace();
+    for (size_t i = from; i < trace.size(); i++) {
+        if (trace[i].pin == pul && trace[i].level == HIGH) steps++;
+    }
+    return steps;
+}
+
+inline bool motionDone() {
+    return !Arc::isBusy() && !Planner::isBusy() && !SegmentReplay::isBusy();
+}
+
+// Отправка строки и прогон прошивки до окончания движения
+inline void runCommand(const char* line, uint32_t timeout_us = 10000000UL) {
+    simSerialInput(line);
+    // Строка должна быть принята до проверки окончания движения
+    simRun(loop, 50000);
+    simRun(loop, timeout_us, 10, motionDone);
+}
+
+// Физическая позиция осей по трассе (от включения) и концевики,
+// замыкающиеся, когда ось доходит до своей точки срабатывания
+const long X_SWITCH = -3000;
+const long Y_SWITCH = -2000;
+
+struct Machine {
+    size_t scanned;
+    long x, y;
+    int dir_x, dir_y;
+    long glitch_at; // Позиция X, на которой концевик даёт короткую помеху
+    long probe_x;   // Позиция X, с которой щуп касается детали (0 - детали нет)
+};
+
+static Machine machine;
+
+inline void machineLoop() {
+    const std::vector<SimEdge>& trace = simTrace();
+    for (; machine.scanned < trace.size(); machine.scanned++) {
+        const SimEdge& e = trace[machine.scanned];
+        if (e.pin == PIN_X_DIR) machine.dir_x = e.level;
+        if (e.pin == PIN_Y_DIR) machine.dir_y = e.level;
+        if (e.level != HIGH) continue;
+        if (e.pin == PIN_X_PUL) machine.x += machine.dir_x ? 1 : -1;
+        if (e.pin == PIN_Y_PUL) machine.y += machine.dir_y ? 1 : -1;
+    }
+    bool glitch = machine.glitch_at != 0 && machine.x == machine.glitch_at;
+    if (glitch) machine.glitch_at = 0;
+    simSetInput(PIN_X_ENDSTOP, machine.x <= X_SWITCH || glitch ? LOW : -1);
+    if (glitch) simSetInput(PIN_X_ENDSTOP, -1);
+    simSetInput(PIN_Y_ENDSTOP, machine.y <= Y_SWITCH ? LOW : -1);
+    simSetInput(PIN_PROBE, machine.probe_x != 0 && machine.x >= machine.probe_x ? LOW : -1);
+    loop();
+}
+
+inline bool homingDone() {
+    return simSerialOutput().find("ok") != std::string::npos &&
+        Planner::freeBlocks() == PLANNER_BUFFER_SIZE - 1 &&
+        StepEngine::motor(0)->isCalibrated() && StepEngine::motor(1)->isCalibrated() &&
+        !StepEngine::motor(0)->isBusy() && !StepEngine::motor(1)->isBusy();
+}
+
+// Перезагрузка платы с чистой EEPROM: оси остановлены и без калибровки,
+// очереди пусты, модальное состояние - как после включения. Объекты
+// осей и движка уже созданы, setup() находит их зарегистрированными.
+inline void bootFirmware() {
+    for (uint8_t i = 0; i < AxisGroup::count(); i++) {
+        AxisGroup::motor(i)->abort(true);
+    }
+    resetMotion();
+    binaryLink.reset();
+    binaryMode = false;
+    binaryRequested = false;
+    feedRate = 0;
+    feedInMM = false;
+    unitsMM = false;
+    simReset();
+    simEepromErase();
+    Machine idle = { 0, 0, 0, LOW, LOW, 0, 0 };
+    machine = idle;
+    setup();
+}
+
+// Калибровка обеих осей (G28): позиция 0 - точка срабатывания концевика
+inline void homeFirmware() {
+    simSerialClearOutput();
+    simSerialInput("G28\n");
+    simRun(machineLoop, 10000000UL, 10, homingDone);
+    TEST_ASSERT_TRUE(homingDone());
+    simSerialClearOutput();
+}
+
+// Кадр двоичного протокола: флаги и три числа данных
+inline void sendFrame(uint8_t seq, uint8_t type, uint8_t flags = 0, int32_t a = 0, int32_t b = 0, int32_t c = 0) {
+    uint8_t frame[BINARY_FRAME_SIZE] = { BINARY_SYNC_HOST, seq, type, flags };
+    int32_t values[3] = { a, b, c };
+    for (uint8_t i = 0; i < 12; i++) {
+        frame[4 + i] = (uint32_t)values[i / 4] >> ((i % 4) * 8);
+    }
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 1; i < BINARY_FRAME_SIZE - 2; i++) {
+        crc = BinaryLink::crcUpdate(crc, frame[i]);
+    }
+    frame[BINARY_FRAME_SIZE - 2] = crc & 0xFF;
+    frame[BINARY_FRAME_SIZE - 1] = crc >> 8;
+    simSerialInput(frame, BINARY_FRAME_SIZE);
+}
+
+#endif
@@ -0,0 +1,91 @@
+#include "../firmware_sim.h"
+
+// Дуги G2/G3: хорды в очереди планировщика, отклонение от окружности
+// по трассе шагов
+
+void setUp() {
+    bootFirmware();
+    homeFirmware();
+    runCommand("G1 X4000 Y2000\n");
+}
+
+void tearDown() {
+}
+
+// Отклонение шагов трассы от окружности: позиции X/Y восстанавливаются
+// по фронтам, начиная с (x, y) и уровней DIR до начала участка
+struct ArcTrace {
+    long x, y;
+    double max_error;
+    long min_y;
+};
+
+struct ArcStart {
+    size_t from;
+    int dir_x, dir_y;
+};
+
+static ArcStart markArc() {
+    ArcStart s = { simTrace().size(), simPinLevel(PIN_X_DIR), simPinLevel(PIN_Y_DIR) };
+    return s;
+}
+
+static ArcTrace traceArc(const ArcStart& start, long x, long y, double cx, double cy, double radius) {
+    ArcTrace t = { x, y, 0, y };
+    const std::vector<SimEdge>& trace = simTrace();
+    int dir_x = start.dir_x, dir_y = start.dir_y;
+    for (size_t i = start.from; i < trace.size(); i++) {
+        const SimEdge& e = trace[i];
+        if (e.pin == PIN_X_DIR) dir_x = e.level;
+        if (e.pin == PIN_Y_DIR) dir_y = e.level;
+        if (e.level != HIGH) continue;
+        if (e.pin == PIN_X_PUL) t.x += dir_x ? 1 : -1;
+        else if (e.pin == PIN_Y_PUL) t.y += dir_y ? 1 : -1;
+        else continue;
+        double err = fabs(sqrt((t.x - cx) * (t.x - cx) + (t.y - cy) * (t.y - cy)) - radius);
+        if (err > t.max_error) t.max_error = err;
+        if (t.y < t.min_y) t.min_y = t.y;
+    }
+    return t;
+}
+
+void test_arc_full_circle() {
+    // Полная окружность одной строкой вокруг (5000, 2000)
+    ArcStart start = markArc();
+    simSerialClearOutput();
+    runCommand("G2 X4000 Y2000 I1000 J0\n");
+    TEST_ASSERT_TRUE(simSerialOutput().find("ok") != std::string::npos);
+
+    ArcTrace t = traceArc(start, 4000, 2000, 5000, 2000, 1000);
+    TEST_ASSERT_EQUAL(4000, t.x);
+    TEST_ASSERT_EQUAL(2000, t.y);
+    // Хорды отклоняются от окружности не больше чем на допуск и шаг
+    TEST_ASSERT_TRUE(t.max_error < ARC_TOLERANCE_STEPS + 1.5);
+
+    runCommand("M114\n");
+    TEST_ASSERT_TRUE(simSerialOutput().find("X:4000 Y:2000") != std::string::npos);
+}
+
+void test_arc_radius_form() {
+    // Полуокружность против часовой из (4000, 2000) в (6000, 2000):
+    // центр (5000, 2000), путь проходит через нижнюю точку Y=1000
+    ArcStart start = markArc();
+    runCommand("G3 X6000 Y2000 R1000\n");
+    ArcTrace t = traceArc(start, 4000, 2000, 5000, 2000, 1000);
+    TEST_ASSERT_EQUAL(6000, t.x);
+    TEST_ASSERT_EQUAL(2000, t.y);
+    TEST_ASSERT_INT_WITHIN(2, 1000, t.min_y);
+    TEST_ASSERT_TRUE(t.max_error < ARC_TOLERANCE_STEPS + 1.5);
+
+    // Цель дальше диаметра - ошибка
+    simSerialClearOutput();
+    runCommand("G3 X9000 Y2000 R1000\n");
+    TEST_ASSERT_TRUE(simSerialOutput().find("error:21") != std::string::npos);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_arc_full_circle);
+    RUN_TEST(test_arc_radius_form);
+    return UNITY_END();
+}
@@ -0,0 +1,176 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "BinaryLink.h"
+
+static GCodeCommand command;
+static BinaryLink link_(command);
+
+// Кадр хоста с правильной CRC
+static void makeFrame(uint8_t* frame, uint8_t seq, uint8_t type, uint8_t flags,
+    int32_t a = 0, int32_t b = 0, int32_t c = 0) {
+    memset(frame, 0, BINARY_FRAME_SIZE);
+    frame[0] = BINARY_SYNC_HOST;
+    frame[1] = seq;
+    frame[2] = type;
+    frame[3] = flags;
+    int32_t values[3] = { a, b, c };
+    for (uint8_t i = 0; i < 3; i++) {
+        for (uint8_t k = 0; k < 4; k++) {
+            frame[4 + i * 4 + k] = (uint32_t)values[i] >> (k * 8);
+        }
+    }
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 1; i < BINARY_FRAME_SIZE - 2; i++) {
+        crc = BinaryLink::crcUpdate(crc, frame[i]);
+    }
+    frame[BINARY_FRAME_SIZE - 2] = crc & 0xFF;
+    frame[BINARY_FRAME_SIZE - 1] = crc >> 8;
+}
+
+// Подаёт кадр побайтно, возвращает true, если кадр завершился на последнем байте
+static bool feedFrame(const uint8_t* frame) {
+    bool done = false;
+    for (uint8_t i = 0; i < BINARY_FRAME_SIZE; i++) {
+        done = link_.feed(frame[i]);
+    }
+    return done;
+}
+
+void setUp() {
+    simReset();
+    link_.reset();
+}
+
+void tearDown() {
+}
+
+void test_crc_matches_ccitt() {
+    // Контрольное значение CRC-16/CCITT-FALSE для "123456789"
+    uint16_t crc = 0xFFFF;
+    for (const char* c = "123456789"; *c; c++) {
+        crc = BinaryLink::crcUpdate(crc, *c);
+    }
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, crc);
+}
+
+void test_move_becomes_gcode() {
+    uint8_t frame[BINARY_FRAME_SIZE];
+    makeFrame(frame, 0, BINARY_MOVE, 0x05, 10500, 777, 600000);
+    // Мусор до синхробайта пропускается
+    TEST_ASSERT_FALSE(link_.feed('x'));
+    TEST_ASSERT_TRUE(feedFrame(frame));
+    TEST_ASSERT_EQUAL(BINARY_OK, link_.status());
+    const GCodeCommand& cmd = link_.command();
+    TEST_ASSERT_TRUE(cmd.isCode('G', 1));
+    TEST_ASSERT_EQUAL(10500, cmd.value('X'));
+    TEST_ASSERT_FALSE(cmd.has('Y'));
+    TEST_ASSERT_EQUAL(600, cmd.integer('F'));
+
+    makeFrame(frame, 1, BINARY_HOME, 0x02);
+    TEST_ASSERT_TRUE(feedFrame(frame));
+    TEST_ASSERT_TRUE(link_.command().isCode('G', 28));
+    TEST_ASSERT_FALSE(link_.command().has('X'));
+    TEST_ASSERT_TRUE(link_.command().has('Y'));
+}
+
+void test_errors_and_duplicates() {
+    uint8_t frame[BINARY_FRAME_SIZE];
+    makeFrame(frame, 0, BINARY_QUERY, 0);
+    TEST_ASSERT_TRUE(feedFrame(frame));
+    TEST_ASSERT_EQUAL(BINARY_OK, link_.status());
+
+    // Повтор того же кадра не выполняется повторно
+    TEST_ASSERT_TRUE(feedFrame(frame));
+    TEST_ASSERT_EQUAL(BINARY_DUPLICATE, link_.status());
+
+    // Повреждённый кадр
+    makeFrame(frame, 1, BINARY_MOVE, 0x01, 100);
+    frame[5] ^= 0x10;
+    TEST_ASSERT_TRUE(feedFrame(frame));
+    TEST_ASSERT_EQUAL(BINARY_ERROR_CRC, link_.status());
+    TEST_ASSERT_EQUAL(0, link_.command().words);
+
+    // Пропущенный кадр: ответ указывает, с какого номера повторить
+    makeFrame(frame, 2, BINARY_MOVE, 0x01, 100);
+    TEST_ASSERT_TRUE(feedFrame(frame));
+    TEST_ASSERT_EQUAL(BINARY_ERROR_SEQUENCE, link_.status());
+    link_.sendAck(link_.status());
+    std::string out = simSerialOutput();
+    TEST_ASSERT_EQUAL(6, out.size());
+    TEST_ASSERT_EQUAL(BINARY_SYNC_DEVICE, (uint8_t)out[0]);
+    TEST_ASSERT_EQUAL(1, (uint8_t)out[1]);
+    TEST_ASSERT_EQUAL(BINARY_ACK, (uint8_t)out[2]);
+    TEST_ASSERT_EQUAL(BINARY_ERROR_SEQUENCE, (uint8_t)out[3]);
+}
+
+void test_resync_after_lost_byte() {
+    uint8_t first[BINARY_FRAME_SIZE];
+    uint8_t second[BINARY_FRAME_SIZE];
+    makeFrame(first, 0, BINARY_MOVE, 0x01, 100);
+    makeFrame(second, 0, BINARY_MOVE, 0x01, 200);
+
+    // Потерян байт данных: кадр дополняется синхробайтом следующего,
+    // CRC не сходится, но следующий кадр принимается целиком
+    bool done = false;
+    for (uint8_t i = 0; i < BINARY_FRAME_SIZE; i++) {
+        if (i == 5) continue;
+        done = link_.feed(first[i]);
+    }
+    TEST_ASSERT_FALSE(done);
+    TEST_ASSERT_TRUE(link_.feed(second[0]));
+    TEST_ASSERT_EQUAL(BINARY_ERROR_CRC, link_.status());
+    done = false;
+    for (uint8_t i = 1; i < BINARY_FRAME_SIZE; i++) {
+        done = link_.feed(second[i]);
+    }
+    TEST_ASSERT_TRUE(done);
+    TEST_ASSERT_EQUAL(BINARY_OK, link_.status());
+    TEST_ASSERT_EQUAL(200, link_.command().value('X'));
+}
+
+void test_stale_frame_is_dropped() {
+    uint8_t frame[BINARY_FRAME_SIZE];
+    makeFrame(frame, 0, BINARY_MOVE, 0x01, 100);
+
+    // Хост оборвал кадр: после паузы приём начинается заново
+    for (uint8_t i = 0; i < 7; i++) {
+        link_.feed(frame[i]);
+    }
+    simAdvance((BINARY_FRAME_TIMEOUT_MS + 10) * 1000UL);
+    TEST_ASSERT_TRUE(feedFrame(frame));
+    TEST_ASSERT_EQUAL(BINARY_OK, link_.status());
+    TEST_ASSERT_EQUAL(100, link_.command().value('X'));
+}
+
+void test_status_reply() {
+    uint8_t frame[BINARY_FRAME_SIZE];
+    makeFrame(frame, 0, BINARY_QUERY, 0);
+    TEST_ASSERT_TRUE(feedFrame(frame));
+    link_.sendStatus(-2, 70000, BINARY_STATE_MOVING, 7, 127);
+    std::string out = simSerialOutput();
+    TEST_ASSERT_EQUAL(BINARY_STATUS_SIZE + 5, out.size());
+    TEST_ASSERT_EQUAL(BINARY_STATUS, (uint8_t)out[2]);
+    TEST_ASSERT_EQUAL_HEX8(0xFE, (uint8_t)out[3]);
+    TEST_ASSERT_EQUAL_HEX8(0xFF, (uint8_t)out[6]);
+    TEST_ASSERT_EQUAL_HEX8(0x70, (uint8_t)out[7]);
+    TEST_ASSERT_EQUAL_HEX8(0x11, (uint8_t)out[8]);
+    TEST_ASSERT_EQUAL_HEX8(0x01, (uint8_t)out[9]);
+    TEST_ASSERT_EQUAL(7, (uint8_t)out[12]);
+    TEST_ASSERT_EQUAL(127, (uint8_t)out[13]);
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 1; i < out.size() - 2; i++) {
+        crc = BinaryLink::crcUpdate(crc, out[i]);
+    }
+    TEST_ASSERT_EQUAL_HEX16(crc, (uint8_t)out[out.size() - 2] | ((uint8_t)out[out.size() - 1] << 8));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_crc_matches_ccitt);
+    RUN_TEST(test_move_becomes_gcode);
+    RUN_TEST(test_errors_and_duplicates);
+    RUN_TEST(test_resync_after_lost_byte);
+    RUN_TEST(test_stale_frame_is_dropped);
+    RUN_TEST(test_status_reply);
+    return UNITY_END();
+}
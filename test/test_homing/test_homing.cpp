@@ -0,0 +1,48 @@
+#include "../firmware_sim.h"
+
+void setUp() {
+    bootFirmware();
+}
+
+void tearDown() {
+}
+
+void test_boot() {
+    TEST_ASSERT_TRUE(simSerialOutput().find("инициализирована") != std::string::npos);
+    TEST_ASSERT_FALSE(StepEngine::motor(0)->isCalibrated());
+}
+
+void test_homing() {
+    simSerialClearOutput();
+    // Помеха на концевике X посреди быстрого подхода не завершает калибровку
+    machine.glitch_at = -1000;
+    simSerialInput("G28\n");
+    uint64_t start = simNanos();
+    simRun(machineLoop, 10000000UL, 10, homingDone);
+    double seconds = (simNanos() - start) / 1e9;
+
+    // Обе оси калибруются одновременно: время - как у более длинной X
+    TEST_ASSERT_TRUE(homingDone());
+    TEST_ASSERT_TRUE(seconds < 2.5);
+
+    // Позиция 0 - точка срабатывания при медленном подходе,
+    // перебег после срабатывания не больше шага
+    TEST_ASSERT_INT_WITHIN(1, X_SWITCH, machine.x - StepEngine::motor(0)->getCurrentPosition());
+    TEST_ASSERT_INT_WITHIN(1, Y_SWITCH, machine.y - StepEngine::motor(1)->getCurrentPosition());
+    TEST_ASSERT_TRUE(StepEngine::motor(0)->getCurrentPosition() >= 0);
+    TEST_ASSERT_TRUE(StepEngine::motor(0)->getCurrentPosition() <= 1);
+
+    // Концевики остаются замкнутыми в нуле: дальше ими управляет машина
+    simSerialClearOutput();
+    simRun(machineLoop, 50000);
+    simSerialInput("M119\n");
+    simRun(machineLoop, 50000);
+    TEST_ASSERT_TRUE(simSerialOutput().find("X: Calibrated Y: Calibrated") != std::string::npos);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_boot);
+    RUN_TEST(test_homing);
+    return UNITY_END();
+}
@@ -0,0 +1,134 @@
+#include "../firmware_sim.h"
+
+// Отрезки G1 из очереди планировщика: форма трапеции, стыки блоков,
+// статистика шагов
+
+void setUp() {
+    bootFirmware();
+    homeFirmware();
+}
+
+void tearDown() {
+}
+
+void test_line_is_straight_and_timed() {
+    size_t from = simTrace().size();
+    runCommand("G1 X4000 Y2000\n");
+
+    AxisTrace x = analyze(PIN_X_PUL, PIN_X_DIR, from);
+    AxisTrace y = analyze(PIN_Y_PUL, PIN_Y_DIR, from);
+    TEST_ASSERT_EQUAL(4000, x.position);
+    TEST_ASSERT_EQUAL(2000, y.position);
+
+    // Импульс не короче 3 мкс, частота не выше setSpeed() (с точностью до такта)
+    TEST_ASSERT_TRUE(x.min_width_ns >= STEP_PULSE_MICROS * 1000UL);
+    TEST_ASSERT_TRUE(x.min_period_ns >= 1000000000UL / SPEED_HZ - TICK_NS);
+
+    // Трапеция: разгон и торможение по 0.4 с, 1440 шагов на 6400 Гц
+    double expected = 2.0 * SPEED_HZ / ACCEL + (4000.0 - (double)SPEED_HZ * SPEED_HZ / ACCEL) / SPEED_HZ;
+    double actual = (x.last_ns - x.first_ns) / 1e9;
+    TEST_ASSERT_DOUBLE_WITHIN(expected * 0.05, expected, actual);
+
+    // Оси заканчивают вместе, в середине пути Y отстаёт от X ровно вдвое
+    TEST_ASSERT_TRUE(y.last_ns <= x.last_ns + TICK_NS * 2);
+    long xs = 0, ys = 0;
+    const std::vector<SimEdge>& trace = simTrace();
+    for (size_t i = from; i < trace.size() && xs < 2000; i++) {
+        if (trace[i].level != HIGH) continue;
+        if (trace[i].pin == PIN_X_PUL) xs++;
+        if (trace[i].pin == PIN_Y_PUL) ys++;
+    }
+    TEST_ASSERT_INT_WITHIN(1, 1000, ys);
+
+    runCommand("M114\n");
+    TEST_ASSERT_TRUE(simSerialOutput().find("X:4000 Y:2000") != std::string::npos);
+}
+
+void test_queued_segments_do_not_stop() {
+    // Десять сегментов по одной прямой подряд: на стыках нет остановки
+    size_t from = simTrace().size();
+    simSerialInput("G1 X200\nG1 X400\nG1 X600\nG1 X800\nG1 X1000\n"
+        "G1 X1200\nG1 X1400\nG1 X1600\nG1 X1800\nG1 X2000\n");
+    simRun(loop, 200000);
+    simRun(loop, 10000000UL, 10, motionDone);
+
+    std::string out = simSerialOutput();
+    size_t acks = 0;
+    for (size_t pos = out.find("ok"); pos != std::string::npos; pos = out.find("ok", pos + 2)) acks++;
+    TEST_ASSERT_TRUE(acks >= 10);
+
+    AxisTrace x = analyze(PIN_X_PUL, PIN_X_DIR, from, 100);
+    TEST_ASSERT_EQUAL(2000, x.position);
+    // Вне разгона и торможения интервал не больше, чем при 1 кГц
+    TEST_ASSERT_TRUE(x.max_period_ns < 1000000UL);
+}
+
+// Интервал между двумя последними шагами оси с позиции трассы from
+static uint64_t lastPeriod(uint8_t pul, size_t from) {
+    uint64_t last = 0, prev = 0;
+    const std::vector<SimEdge>& trace = simTrace();
+    for (size_t i = from; i < trace.size(); i++) {
+        if (trace[i].pin != pul || trace[i].level != HIGH) continue;
+        prev = last;
+        last = trace[i].time_ns;
+    }
+    return last - prev;
+}
+
+void test_short_final_block_stops() {
+    // Короткий последний блок на прямой входит со скоростью sqrt(2aL):
+    // вся его длина - торможение до нижней скорости sqrt(2a), а не
+    // остановка с ходу на скорости входа
+    runCommand("G1 X6000\n");
+    size_t from = simTrace().size();
+    simSerialInput("G1 X3000\nG1 X2900\n");
+    simRun(loop, 200000);
+    simRun(loop, 10000000UL, 10, motionDone);
+    AxisTrace x = analyze(PIN_X_PUL, PIN_X_DIR, from);
+    TEST_ASSERT_EQUAL(-3100, x.position);
+    double floor_hz = sqrt(2.0 * ACCEL);
+    TEST_ASSERT_TRUE(lastPeriod(PIN_X_PUL, from) > 1e9 / (floor_hz * 2));
+}
+
+void test_timing_stats() {
+    // Статистика считает только шаги после сброса
+    runCommand("G1 X500\n");
+    runCommand("M861\n");
+    runCommand("G1 X2500\n");
+    simSerialClearOutput();
+    runCommand("M860\n");
+    std::string out = simSerialOutput();
+    TEST_ASSERT_TRUE(out.find("[STAT AXIS:0 STEPS:2000 ") != std::string::npos);
+    TEST_ASSERT_TRUE(out.find("[STAT AXIS:1 STEPS:0 ") != std::string::npos);
+    // В имитации прерывание не опаздывает: все шаги в первой корзине
+    TEST_ASSERT_TRUE(out.find("MISSED:0 LATE:2000,0,0,0,0,0]") != std::string::npos);
+    TEST_ASSERT_TRUE(out.find("[STAT LOOP_MAX:") != std::string::npos);
+}
+
+static bool motorIdle() {
+    return !StepEngine::motor(0)->isBusy();
+}
+
+void test_relative_move_after_line() {
+    // Относительное перемещение в мм - от конца отрезка G1, а не от цели
+    // прошлого перемещения самой оси
+    StepperMotor* motor = StepEngine::motor(0);
+    TEST_ASSERT_TRUE(motor->moveMM(500));
+    simRun(loop, 1000000UL, 10, motorIdle);
+    runCommand("G1 X4000\n");
+    simRun(loop, 1000000UL, 10, motorIdle);
+    TEST_ASSERT_TRUE(motor->moveMM(1000));
+    simRun(loop, 1000000UL, 10, motorIdle);
+    TEST_ASSERT_TRUE(motorIdle());
+    TEST_ASSERT_EQUAL(4080, motor->getCurrentPosition());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_line_is_straight_and_timed);
+    RUN_TEST(test_queued_segments_do_not_stop);
+    RUN_TEST(test_short_final_block_stops);
+    RUN_TEST(test_timing_stats);
+    RUN_TEST(test_relative_move_after_line);
+    return UNITY_END();
+}
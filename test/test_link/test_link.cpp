@@ -0,0 +1,47 @@
+#include "../firmware_sim.h"
+
+// Двоичный протокол в прошивке: переход по M870, кадры вместо строк,
+// возврат в текстовый режим
+
+void setUp() {
+    bootFirmware();
+    homeFirmware();
+}
+
+void tearDown() {
+}
+
+void test_binary_protocol() {
+    runCommand("M870\n");
+    simSerialClearOutput();
+
+    // Перемещение X в 7000 шагов и запрос состояния: только двоичные ответы
+    sendFrame(0, BINARY_MOVE, 0x01, 7000 * GCODE_SCALE);
+    simRun(loop, 50000);
+    simRun(loop, 10000000UL, 10, motionDone);
+    sendFrame(1, BINARY_QUERY);
+    simRun(loop, 10000);
+    std::string out = simSerialOutput();
+    TEST_ASSERT_EQUAL(6 + BINARY_STATUS_SIZE + 5, out.size());
+    TEST_ASSERT_EQUAL(BINARY_SYNC_DEVICE, (uint8_t)out[0]);
+    TEST_ASSERT_EQUAL(0, (uint8_t)out[1]);
+    TEST_ASSERT_EQUAL(BINARY_ACK, (uint8_t)out[2]);
+    TEST_ASSERT_EQUAL(0, (uint8_t)out[3]);
+    const uint8_t* status = (const uint8_t*)out.data() + 6;
+    TEST_ASSERT_EQUAL(BINARY_STATUS, status[2]);
+    TEST_ASSERT_EQUAL(7000, status[3] | (status[4] << 8));
+    TEST_ASSERT_EQUAL(BINARY_STATE_X_CALIBRATED | BINARY_STATE_Y_CALIBRATED, status[11]);
+
+    // Возврат в текстовый режим
+    sendFrame(2, BINARY_TEXT_MODE);
+    simRun(loop, 10000);
+    simSerialClearOutput();
+    runCommand("M114\n");
+    TEST_ASSERT_TRUE(simSerialOutput().find("X:7000 Y:0") != std::string::npos);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_binary_protocol);
+    return UNITY_END();
+}
@@ -0,0 +1,87 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "Log.h"
+#include "Console.h"
+
+void setUp() {
+    simReset();
+    Log::setLevel(LOG_DEBUG);
+    Log::setCodesOnly(false);
+    Log::drain();
+    simSerialClearOutput();
+}
+
+void tearDown() {
+}
+
+void test_text_with_numbers() {
+    Log::event(LOG_HOME_FOUND, 1, 9000);
+    TEST_ASSERT_EQUAL(0, simSerialOutput().size()); // Только в очереди
+    Log::drain();
+    TEST_ASSERT_EQUAL_STRING("Ось 1: начальная точка найдена, установлена позиция 0. "
+        "Длина рейки: 9000 шагов.\r\n", simSerialOutput().c_str());
+
+    simSerialClearOutput();
+    Log::event(LOG_COMMAND, 'G', 28);
+    Log::drain();
+    TEST_ASSERT_EQUAL_STRING("Получена команда: G28\r\n", simSerialOutput().c_str());
+}
+
+void test_codes_only() {
+    Log::setCodesOnly(true);
+    Log::event(LOG_MOVE_TO, -5, 12);
+    Log::event(LOG_MOTOR_BUSY);
+    Log::drain();
+    TEST_ASSERT_EQUAL_STRING("[MSG:65 -5 12]\r\n[MSG:1]\r\n", simSerialOutput().c_str());
+}
+
+void test_levels() {
+    Log::setLevel(LOG_ERROR);
+    Log::event(LOG_CALIBRATION_DONE, 0);
+    Log::event(LOG_MOVE_TO, 1, 2);
+    Log::event(LOG_ARC_ABORTED);
+    Log::drain();
+    TEST_ASSERT_EQUAL_STRING("Ошибка: Дуга прервана\r\n", simSerialOutput().c_str());
+
+    simSerialClearOutput();
+    Log::setLevel(LOG_OFF);
+    Log::event(LOG_ARC_ABORTED);
+    Log::drain();
+    TEST_ASSERT_EQUAL(0, simSerialOutput().size());
+}
+
+void test_drain_does_not_wait_for_port() {
+    // В буфере передачи 10 байт: отправляется только то, что помещается
+    simSerialSetTxSpace(10);
+    Log::event(LOG_ARC_ABORTED);
+    Log::drain();
+    TEST_ASSERT_EQUAL(10, simSerialOutput().size());
+    Log::drain();
+    TEST_ASSERT_EQUAL(10, simSerialOutput().size());
+
+    // Другой вывод сначала дописывает начатое сообщение
+    Console.print(F("ok"));
+    TEST_ASSERT_EQUAL_STRING("Ошибка: Дуга прервана\r\nok", simSerialOutput().c_str());
+}
+
+void test_overflow_reports_drops() {
+    for (uint8_t i = 0; i < LOG_BUFFER_SIZE + 2; i++) {
+        Log::event(LOG_CALIBRATION_DONE, i);
+    }
+    Log::drain();
+    simSerialClearOutput();
+    Log::event(LOG_ARC_ABORTED);
+    Log::drain();
+    TEST_ASSERT_EQUAL_STRING("Потеряно сообщений: 3\r\nОшибка: Дуга прервана\r\n",
+        simSerialOutput().c_str());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_text_with_numbers);
+    RUN_TEST(test_codes_only);
+    RUN_TEST(test_levels);
+    RUN_TEST(test_drain_does_not_wait_for_port);
+    RUN_TEST(test_overflow_reports_drops);
+    return UNITY_END();
+}
@@ -0,0 +1,166 @@
+#include <unity.h>
+#include <string>
+#include "GCodeParser.h"
+#include "SerialInput.h"
+
+static GCodeCommand command;
+static GCodeParser parser(command);
+
+// Подаёт строку побайтно, возвращает true, если завершилась хотя бы одна строка
+static bool feedLine(const char* text) {
+    bool done = false;
+    for (const char* c = text; *c; c++) {
+        if (parser.feed(*c)) done = true;
+    }
+    return done;
+}
+
+void setUp() {
+    parser.reset();
+}
+
+void tearDown() {
+}
+
+void test_words_in_any_order() {
+    TEST_ASSERT_TRUE(feedLine("x10 F600 g1 Y-2.5\n"));
+    const GCodeCommand& cmd = parser.command();
+    TEST_ASSERT_EQUAL(GCODE_OK, parser.status());
+    TEST_ASSERT_TRUE(cmd.isCode('G', 1));
+    TEST_ASSERT_EQUAL(10000, cmd.value('X'));
+    TEST_ASSERT_EQUAL(-2500, cmd.value('Y'));
+    TEST_ASSERT_EQUAL(600, cmd.integer('F'));
+    TEST_ASSERT_FALSE(cmd.has('Z'));
+}
+
+void test_decimals_are_not_truncated() {
+    TEST_ASSERT_TRUE(feedLine("G1 X10.5 Y.25\n"));
+    TEST_ASSERT_EQUAL(10500, parser.command().value('X'));
+    TEST_ASSERT_EQUAL(250, parser.command().value('Y'));
+    TEST_ASSERT_EQUAL(11, parser.command().integer('X'));
+}
+
+void test_letter_without_number() {
+    TEST_ASSERT_TRUE(feedLine("G28 X\r\n"));
+    TEST_ASSERT_TRUE(parser.command().isCode('G', 28));
+    TEST_ASSERT_TRUE(parser.command().has('X'));
+    TEST_ASSERT_FALSE(parser.command().has('Y'));
+}
+
+void test_comments_are_skipped() {
+    TEST_ASSERT_TRUE(feedLine("G1 (move X1) Y5 ; X9\n"));
+    TEST_ASSERT_FALSE(parser.command().has('X'));
+    TEST_ASSERT_EQUAL(5000, parser.command().value('Y'));
+}
+
+void test_empty_lines_are_ignored() {
+    TEST_ASSERT_FALSE(feedLine("\r\n\n"));
+}
+
+void test_errors() {
+    TEST_ASSERT_TRUE(feedLine("G1 X1.2.3\n"));
+    TEST_ASSERT_EQUAL(GCODE_ERROR_NUMBER, parser.status());
+    TEST_ASSERT_TRUE(feedLine("G1 X#\n"));
+    TEST_ASSERT_EQUAL(GCODE_ERROR_CHAR, parser.status());
+    TEST_ASSERT_TRUE(feedLine("G1 X99999999\n"));
+    TEST_ASSERT_EQUAL(GCODE_ERROR_OVERFLOW, parser.status());
+    // Следующая строка разбирается заново
+    TEST_ASSERT_TRUE(feedLine("M114\n"));
+    TEST_ASSERT_EQUAL(GCODE_OK, parser.status());
+    TEST_ASSERT_TRUE(parser.command().isCode('M', 114));
+}
+
+void test_setting_words() {
+    TEST_ASSERT_TRUE(feedLine("$110=6400.5\n"));
+    const GCodeCommand& cmd = parser.command();
+    TEST_ASSERT_EQUAL(GCODE_OK, parser.status());
+    TEST_ASSERT_EQUAL(110, cmd.integer('$'));
+    TEST_ASSERT_EQUAL(6400500, cmd.value('='));
+    TEST_ASSERT_FALSE(cmd.has('G'));
+    // $$ - одно слово '$' без числа
+    TEST_ASSERT_TRUE(feedLine("$$\n"));
+    TEST_ASSERT_TRUE(parser.command().has('$'));
+    TEST_ASSERT_FALSE(parser.command().has('='));
+}
+
+void test_line_too_long() {
+    for (uint8_t i = 0; i < GCODE_LINE_SIZE + 8; i++) {
+        parser.feed('G');
+    }
+    TEST_ASSERT_TRUE(parser.feed('\n'));
+    TEST_ASSERT_EQUAL(GCODE_ERROR_LENGTH, parser.status());
+}
+
+// Разбор всего, что принято; статусы и X завершённых строк
+static void drainInput(std::string& statuses, std::string& xs) {
+    for (uint8_t pass = 0; pass < 4; pass++) {
+        SerialInput::poll(true);
+        while (SerialInput::available()) {
+            if (!parser.feed(SerialInput::read())) continue;
+            statuses += (char)('0' + parser.status());
+            xs += parser.command().has('X') ? std::to_string(parser.command().integer('X')) + " " : "- ";
+        }
+    }
+}
+
+void test_input_overflow() {
+    // Строки заполняют буфер так, что в нём остаются первые 7 байт
+    // "G1 X12345": без метки строка выполнилась бы как G1 X123
+    std::string text;
+    size_t fill = SERIAL_RX_BUFFER_SIZE - 1 - 7;
+    while (text.size() + 6 <= fill) text += "G1 X1\n";
+    text.insert(0, fill - text.size(), ' ');
+    text += "G1 X12345\n?G1 X2\n";
+    simSerialInput(text.c_str());
+
+    std::string statuses;
+    std::string xs;
+    drainInput(statuses, xs);
+
+    // Команда реального времени за полным буфером принята сразу
+    TEST_ASSERT_EQUAL(REALTIME_FLAG_STATUS, SerialInput::takeRealtime());
+    // Строка без конца и строка после неё - ошибки, остальные выполняются
+    size_t lines = fill / 6;
+    TEST_ASSERT_EQUAL(lines + 2, statuses.size());
+    TEST_ASSERT_EQUAL_STRING(std::string(lines, '0').c_str(), statuses.substr(0, lines).c_str());
+    TEST_ASSERT_EQUAL('0' + GCODE_ERROR_LENGTH, statuses[lines]);
+    TEST_ASSERT_EQUAL('0' + GCODE_ERROR_LENGTH, statuses[lines + 1]);
+    TEST_ASSERT_TRUE(xs.find("123 ") == std::string::npos);
+
+    // После переполнения приём продолжается как обычно
+    statuses.clear();
+    xs.clear();
+    simSerialInput("G1 X3\n");
+    drainInput(statuses, xs);
+    TEST_ASSERT_EQUAL_STRING("0", statuses.c_str());
+    TEST_ASSERT_EQUAL_STRING("3 ", xs.c_str());
+}
+
+void test_word_limit() {
+    // Повтор буквы заменяет значение и места не занимает
+    TEST_ASSERT_TRUE(feedLine("G1 X1 X2 X3 X4 X5 X6 X7 X8 X9\n"));
+    TEST_ASSERT_EQUAL(GCODE_OK, parser.status());
+    TEST_ASSERT_EQUAL(9000, parser.command().value('X'));
+
+    TEST_ASSERT_TRUE(feedLine("G1 A1 B2 C3 D4 E5 F6 H7\n"));
+    TEST_ASSERT_EQUAL(GCODE_OK, parser.status());
+    TEST_ASSERT_EQUAL(7, parser.command().integer('H'));
+    TEST_ASSERT_TRUE(feedLine("G1 A1 B2 C3 D4 E5 F6 H7 I8\n"));
+    TEST_ASSERT_EQUAL(GCODE_ERROR_LENGTH, parser.status());
+    TEST_ASSERT_EQUAL(0, parser.command().words);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_words_in_any_order);
+    RUN_TEST(test_decimals_are_not_truncated);
+    RUN_TEST(test_letter_without_number);
+    RUN_TEST(test_comments_are_skipped);
+    RUN_TEST(test_empty_lines_are_ignored);
+    RUN_TEST(test_errors);
+    RUN_TEST(test_setting_words);
+    RUN_TEST(test_line_too_long);
+    RUN_TEST(test_input_overflow);
+    RUN_TEST(test_word_limit);
+    return UNITY_END();
+}
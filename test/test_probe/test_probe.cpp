@@ -0,0 +1,107 @@
+#include "../firmware_sim.h"
+
+// Щуп G38.2/G38.3 на машине: деталь замыкает щуп, когда ось X доходит
+// до machine.probe_x
+
+void setUp() {
+    bootFirmware();
+    homeFirmware();
+}
+
+void tearDown() {
+}
+
+static bool probeDone() {
+    return simSerialOutput().find("[PRB:") != std::string::npos && motionDone() &&
+        !StepEngine::lineBusy();
+}
+
+// Строка G38 на машине со щупом: до отчёта [PRB:...]
+static void runProbe(const char* line) {
+    simSerialClearOutput();
+    simSerialInput(line);
+    simRun(machineLoop, 5000000UL, 10, probeDone);
+}
+
+void test_probe_contact() {
+    runCommand("G1 X2000 Y4000\n");
+    // Деталь под щупом на X = 4000 в координатах прошивки
+    simRun(machineLoop, 1000);
+    long offset = machine.x - StepEngine::motor(0)->getCurrentPosition();
+    machine.probe_x = offset + 4000;
+
+    // Подход на 6400 Гц - быстрее калибровки: позиция касания точна до
+    // шага, затем торможение с ускорением оси v^2/2a = 1280 шагов
+    size_t from = simTrace().size();
+    runProbe("G38.2 X9000 F384000\n");
+    std::string out = simSerialOutput();
+    TEST_ASSERT_TRUE(out.find("ok") != std::string::npos);
+    long x = 0, y = 0;
+    int contact = -1;
+    TEST_ASSERT_EQUAL(3, sscanf(out.c_str() + out.find("[PRB:"), "[PRB:%ld,%ld:%d]", &x, &y, &contact));
+    TEST_ASSERT_EQUAL(1, contact);
+    TEST_ASSERT_INT_WITHIN(1, 4000, x);
+    TEST_ASSERT_EQUAL(4000, y);
+    long overtravel = StepEngine::motor(0)->getCurrentPosition() - 4000;
+    TEST_ASSERT_INT_WITHIN(150, 1280, overtravel);
+    TEST_ASSERT_EQUAL(machine.x - offset, StepEngine::motor(0)->getCurrentPosition());
+    TEST_ASSERT_EQUAL(2000 + overtravel, stepsSince(PIN_X_PUL, from));
+    size_t stopped_from = simTrace().size();
+    simRun(machineLoop, 100000);
+    TEST_ASSERT_EQUAL(0, stepsSince(PIN_X_PUL, stopped_from));
+
+    // Остаток перемещения отброшен, калибровка сохранена
+    simSerialClearOutput();
+    runCommand("M119\n");
+    TEST_ASSERT_TRUE(simSerialOutput().find("X: Calibrated Y: Calibrated") != std::string::npos);
+
+    // Щуп ещё замкнут - перемещение не начинается
+    runProbe("G38.2 X9000\n");
+    TEST_ASSERT_TRUE(simSerialOutput().find("error:21") != std::string::npos);
+}
+
+void test_probe_without_contact() {
+    // Без касания: G38.3 - только отчёт, G38.2 - ещё и ошибка
+    runCommand("G1 X3000 Y4000\n");
+    runProbe("G38.3 X3500\n");
+    TEST_ASSERT_TRUE(simSerialOutput().find("[PRB:3500,4000:0]") != std::string::npos);
+    TEST_ASSERT_TRUE(simSerialOutput().find("не сработал") == std::string::npos);
+    runProbe("G38.2 X3000\n");
+    TEST_ASSERT_TRUE(simSerialOutput().find("[PRB:3000,4000:0]") != std::string::npos);
+    TEST_ASSERT_TRUE(simSerialOutput().find("не сработал") != std::string::npos);
+}
+
+static bool yStopped() {
+    return !StepEngine::motor(1)->isBusy();
+}
+
+void test_contact_leaves_other_axes_running() {
+    // Y едет своим перемещением, пока X подходит щупом: касание
+    // останавливает только X
+    runCommand("G1 X2000\n");
+    simRun(machineLoop, 1000);
+    machine.probe_x = machine.x - StepEngine::motor(0)->getCurrentPosition() + 4000;
+    StepperMotor* y = StepEngine::motor(1);
+    simSerialClearOutput();
+    simSerialInput("G38.2 X9000\n");
+    simRun(machineLoop, 50000);
+    TEST_ASSERT_TRUE(y->move(6000));
+    simRun(machineLoop, 5000000UL, 10, probeDone);
+    TEST_ASSERT_TRUE(simSerialOutput().find(":1]") != std::string::npos);
+    TEST_ASSERT_TRUE(y->isBusy());
+
+    size_t from = simTrace().size();
+    simRun(machineLoop, 5000000UL, 10, yStopped);
+    TEST_ASSERT_EQUAL(0, stepsSince(PIN_X_PUL, from));
+    TEST_ASSERT_EQUAL(6000, y->getCurrentPosition());
+    TEST_ASSERT_TRUE(y->isCalibrated());
+    TEST_ASSERT_TRUE(StepEngine::motor(0)->isCalibrated());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_probe_contact);
+    RUN_TEST(test_probe_without_contact);
+    RUN_TEST(test_contact_leaves_other_axes_running);
+    return UNITY_END();
+}
@@ -0,0 +1,94 @@
+#include "../firmware_sim.h"
+
+// Программа в EEPROM: запись M880/M881, вывод M883, запуск M882
+// с повторами и смещением
+
+void setUp() {
+    bootFirmware();
+    homeFirmware();
+    runCommand("G1 X3000 Y4000\n");
+}
+
+void tearDown() {
+}
+
+static bool programDone() {
+    return simSerialOutput().find("Программа выполнена") != std::string::npos;
+}
+
+// Запись трёх строк программы
+static void recordProgram() {
+    runCommand("M880\n");
+    runCommand("G1 X3500 Y4200\n");
+    runCommand("G1 X3200.25 Y4000\n");
+    runCommand("G1 X3000 Y4000\n");
+    runCommand("M881\n");
+}
+
+void test_stored_program() {
+    // Запись: строки сохраняются, оси стоят
+    size_t from = simTrace().size();
+    recordProgram();
+    TEST_ASSERT_EQUAL(0, stepsSince(PIN_X_PUL, from));
+    std::string out = simSerialOutput();
+    TEST_ASSERT_TRUE(out.find("error") == std::string::npos);
+    // Целые значения - по 2 байта, дробные - по 4
+    TEST_ASSERT_TRUE(out.find("строк 3, байт 22") != std::string::npos);
+
+    // Программа переживает перезагрузку
+    Program::begin();
+    simSerialClearOutput();
+    runCommand("M883\n");
+    out = simSerialOutput();
+    TEST_ASSERT_TRUE(out.find("G1 X3500 Y4200\r\nG1 X3200.25 Y4000\r\nG1 X3000 Y4000\r\nok") != std::string::npos);
+}
+
+void test_program_run() {
+    recordProgram();
+    // Три повтора со смещением X 100, 50, 0: ответ сразу, строки - без ПК
+    simSerialClearOutput();
+    size_t from = simTrace().size();
+    simSerialInput("M882 L3 X100 I-50\n");
+    simRun(loop, 50000);
+    TEST_ASSERT_TRUE(simSerialOutput().find("ok") != std::string::npos);
+    // Перемещение с ПК ждёт конца программы, запрос - нет. Строка
+    // приходит частями, пока строки программы выполняются.
+    simSerialInput("G1 X20");
+    simRun(loop, 50000);
+    simSerialInput("00\n");
+    simRun(loop, 50000);
+    TEST_ASSERT_TRUE(Program::isRunning());
+    simSerialClearOutput();
+    simSerialInput("?");
+    simRun(loop, 1000);
+    TEST_ASSERT_TRUE(simSerialOutput().find("<Run|") != std::string::npos);
+    simRun(loop, 20000000UL, 10, programDone);
+    TEST_ASSERT_TRUE(programDone());
+    TEST_ASSERT_EQUAL(600 + 300 + 200 + 2 * (450 + 300 + 200), stepsSince(PIN_X_PUL, from));
+    TEST_ASSERT_EQUAL(3 * 400, stepsSince(PIN_Y_PUL, from));
+    simRun(loop, 10000000UL, 10, motionDone);
+    simSerialClearOutput();
+    runCommand("M114\n");
+    TEST_ASSERT_TRUE(simSerialOutput().find("X:2000 Y:4000") != std::string::npos);
+}
+
+void test_unstorable_line_drops_program() {
+    // Строка, которую нельзя сохранить, - программа не записывается
+    runCommand("M880\n");
+    simSerialClearOutput();
+    runCommand("G38.2 X9000\n");
+    TEST_ASSERT_TRUE(simSerialOutput().find("error:21") != std::string::npos);
+    runCommand("M881\n");
+    simSerialClearOutput();
+    runCommand("M882\n");
+    TEST_ASSERT_TRUE(simSerialOutput().find("error:21") != std::string::npos);
+    TEST_ASSERT_FALSE(Program::isRunning());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_stored_program);
+    RUN_TEST(test_program_run);
+    RUN_TEST(test_unstorable_line_drops_program);
+    return UNITY_END();
+}
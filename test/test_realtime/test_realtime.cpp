@@ -0,0 +1,88 @@
+#include "../firmware_sim.h"
+
+// Команды реального времени вне очереди строк: ? ! ~ и Ctrl-X
+
+void setUp() {
+    bootFirmware();
+    homeFirmware();
+    runCommand("G1 X3000 Y4000\n");
+}
+
+void tearDown() {
+}
+
+static bool holdStopped() {
+    return StepEngine::holdState() == HOLD_STOPPED;
+}
+
+void test_status_hold_and_resume() {
+    simSerialClearOutput();
+    simSerialInput("G1 X9000\n");
+    simRun(loop, 600000);
+
+    // Отчёт приходит во время движения, строка в очереди не нужна
+    simSerialInput("?");
+    simRun(loop, 1000);
+    TEST_ASSERT_TRUE(simSerialOutput().find("<Run|MPos:") != std::string::npos);
+
+    // Удержание на крейсерской скорости: торможение v^2/2a = 1280 шагов
+    size_t hold_from = simTrace().size();
+    simSerialInput("!");
+    simRun(loop, 2000000UL, 10, holdStopped);
+    long braking = stepsSince(PIN_X_PUL, hold_from);
+    TEST_ASSERT_INT_WITHIN(150, 1280, braking);
+    size_t held_from = simTrace().size();
+    simRun(loop, 200000);
+    TEST_ASSERT_EQUAL(0, stepsSince(PIN_X_PUL, held_from));
+    simSerialClearOutput();
+    simSerialInput("?");
+    simRun(loop, 1000);
+    TEST_ASSERT_TRUE(simSerialOutput().find("<Hold|MPos:") != std::string::npos);
+
+    // Продолжение с того же места до конечной точки
+    simSerialInput("~");
+    simRun(loop, 1000);
+    simRun(loop, 10000000UL, 10, motionDone);
+    simSerialClearOutput();
+    runCommand("M114\n");
+    TEST_ASSERT_TRUE(simSerialOutput().find("X:9000 Y:4000") != std::string::npos);
+}
+
+void test_reset_stops_motion() {
+    // Сброс на ходу: шаги прекращаются сразу, ось теряет калибровку
+    simSerialInput("G1 X9000\n");
+    simRun(loop, 300000);
+    simSerialClearOutput();
+    simSerialInput("\x18");
+    simRun(loop, 100);
+    size_t reset_from = simTrace().size();
+    simRun(loop, 100000);
+    TEST_ASSERT_TRUE(simSerialOutput().find("[RESET]") != std::string::npos);
+    TEST_ASSERT_EQUAL(0, stepsSince(PIN_X_PUL, reset_from));
+    TEST_ASSERT_TRUE(motionDone());
+    runCommand("M119\n");
+    TEST_ASSERT_TRUE(simSerialOutput().find("X: Not calibrated Y: Calibrated") != std::string::npos);
+}
+
+void test_status_waits_for_tx_space() {
+    // Отчёт выводится только целиком: пока не помещается в буфер
+    // передачи, loop() идёт дальше, а запрос ждёт
+    simSerialClearOutput();
+    simSerialSetTxSpace(20);
+    simSerialInput("?");
+    simRun(loop, 1000);
+    TEST_ASSERT_EQUAL(0, simSerialOutput().size());
+    simSerialSetTxSpace(-1);
+    simRun(loop, 1000);
+    std::string out = simSerialOutput();
+    TEST_ASSERT_TRUE(out.find("<Idle|MPos:3000,4000|Q:") == 0);
+    TEST_ASSERT_EQUAL(out.size() - 3, out.find(">\r\n"));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_status_hold_and_resume);
+    RUN_TEST(test_reset_stops_motion);
+    RUN_TEST(test_status_waits_for_tx_space);
+    return UNITY_END();
+}
@@ -0,0 +1,78 @@
+#include "../firmware_sim.h"
+
+// Готовые отрезки с ПК (tools/segc): выполнение без планировщика
+// и без остановок на стыках
+
+void setUp() {
+    bootFirmware();
+    homeFirmware();
+    runCommand("G1 X7000 Y2000\n");
+}
+
+void tearDown() {
+}
+
+// Кадр BINARY_SEGMENT, как его пишет tools/segc
+static void sendSegment(uint8_t seq, int16_t x, int16_t y, uint16_t start_hz, uint16_t end_hz,
+    uint8_t flags = 0) {
+    uint32_t accel = (uint32_t)(ACCEL * STEP_ACCEL_PER_HZ_S + 0.5);
+    uint8_t frame[BINARY_FRAME_SIZE] = { BINARY_SYNC_HOST, seq, BINARY_SEGMENT, flags,
+        (uint8_t)x, (uint8_t)((uint16_t)x >> 8), (uint8_t)y, (uint8_t)((uint16_t)y >> 8),
+        (uint8_t)start_hz, (uint8_t)(start_hz >> 8), (uint8_t)end_hz, (uint8_t)(end_hz >> 8),
+        (uint8_t)accel, (uint8_t)(accel >> 8), (uint8_t)(accel >> 16), (uint8_t)(accel >> 24) };
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 1; i < BINARY_FRAME_SIZE - 2; i++) {
+        crc = BinaryLink::crcUpdate(crc, frame[i]);
+    }
+    frame[BINARY_FRAME_SIZE - 2] = crc & 0xFF;
+    frame[BINARY_FRAME_SIZE - 1] = crc >> 8;
+    simSerialInput(frame, BINARY_FRAME_SIZE);
+}
+
+void test_segment_replay() {
+    runCommand("M870\n");
+    simSerialClearOutput();
+    size_t from = simTrace().size();
+
+    // Та же трапеция, что и у G1 X-4000 Y2000, разбитая на ПК на разгон,
+    // крейсерский участок и торможение (нижняя скорость - sqrt(2a))
+    sendSegment(0, -1279, 640, 179, SPEED_HZ);
+    sendSegment(1, -1442, 720, SPEED_HZ, SPEED_HZ);
+    sendSegment(2, -1279, 640, SPEED_HZ, 179, BINARY_SEGMENT_LAST);
+    simRun(loop, 50000);
+    simRun(loop, 10000000UL, 10, motionDone);
+
+    std::string out = simSerialOutput();
+    TEST_ASSERT_EQUAL(18, out.size());
+    for (uint8_t i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL(i, (uint8_t)out[i * 6 + 1]);
+        TEST_ASSERT_EQUAL(0, (uint8_t)out[i * 6 + 3]);
+    }
+
+    AxisTrace x = analyze(PIN_X_PUL, PIN_X_DIR, from);
+    AxisTrace y = analyze(PIN_Y_PUL, PIN_Y_DIR, from);
+    TEST_ASSERT_EQUAL(-4000, x.position);
+    TEST_ASSERT_EQUAL(2000, y.position);
+    TEST_ASSERT_TRUE(x.min_period_ns >= 1000000000UL / SPEED_HZ - TICK_NS);
+    // Отрезки идут без остановок на стыках: время как у одного блока G1
+    double expected = 2.0 * SPEED_HZ / ACCEL + (4000.0 - (double)SPEED_HZ * SPEED_HZ / ACCEL) / SPEED_HZ;
+    double actual = (x.last_ns - x.first_ns) / 1e9;
+    TEST_ASSERT_DOUBLE_WITHIN(expected * 0.05, expected, actual);
+
+    // Отрезок без шагов не выполняется
+    simSerialClearOutput();
+    sendSegment(3, 0, 0, 0, 0);
+    simRun(loop, 10000);
+    TEST_ASSERT_EQUAL(21, (uint8_t)simSerialOutput()[3]);
+    sendFrame(4, BINARY_TEXT_MODE);
+    simRun(loop, 50000);
+    simSerialClearOutput();
+    runCommand("M114\n");
+    TEST_ASSERT_TRUE(simSerialOutput().find("X:3000 Y:4000") != std::string::npos);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_segment_replay);
+    return UNITY_END();
+}
@@ -0,0 +1,201 @@
+#include <unity.h>
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "Settings.h"
+#include "AxisGroup.h"
+#include "Probe.h"
+
+// Две оси на свободных пинах; двигатели main.cpp не инициализируются.
+// Перезагрузка платы - повторный Settings::begin() с тем же содержимым
+// EEPROM после сброса калибровки.
+static StepperMotor motorX(10, 11, 12, 13, false, 80.0, 1.8);
+static StepperMotor motorY(14, 15, 16, 17, false, 80.0, 1.8);
+
+static const SettingsData defaults = {
+    { 80.0, 40.0 },
+    { 6400, 3200 },
+    { 16000, 8000 },
+    { 10000, 5000 },
+    { 40.0, 40.0 },
+    { 0.1, 0.1 },
+    { SHAPER_NONE, SHAPER_NONE },
+    4800,
+    600,
+    18,
+    0
+};
+
+// Размер записи настроек в EEPROM: версия, номер, данные, CRC16
+static const int RECORD_SIZE = sizeof(SettingsData) + 5;
+
+static void reboot() {
+    motorX.abort(true);
+    motorY.abort(true);
+    Settings::begin(defaults);
+}
+
+void setUp() {
+    simReset();
+    simEepromErase();
+    if (AxisGroup::count() == 0) {
+        AxisGroup::add('X', &motorX, 13, defaults.max_steps[0]);
+        AxisGroup::add('Y', &motorY, 17, defaults.max_steps[1]);
+        AxisGroup::begin();
+    }
+    reboot();
+}
+
+void tearDown() {
+}
+
+void test_defaults_when_eeprom_is_empty() {
+    TEST_ASSERT_EQUAL(6400, motorX.getSpeed());
+    TEST_ASSERT_EQUAL(3200, motorY.getSpeed());
+    TEST_ASSERT_EQUAL(8000, motorY.getAcceleration());
+    TEST_ASSERT_EQUAL(5000, AxisGroup::maxSteps(1));
+    // Пока ничего не менялось, EEPROM не записывается
+    TEST_ASSERT_EQUAL(0, simEepromWrites());
+}
+
+void test_set_is_saved_and_reloaded() {
+    TEST_ASSERT_TRUE(Settings::set(SETTING_SPEED_HZ, 8000 * GCODE_SCALE));
+    TEST_ASSERT_TRUE(Settings::set(SETTING_STEPS_PER_MM + 1, 42500));
+    TEST_ASSERT_EQUAL(8000, motorX.getSpeed());
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, 42.5, motorY.getStepsPerMM());
+
+    // Нет такой настройки, нет такой оси, недопустимое значение
+    TEST_ASSERT_FALSE(Settings::set(99, GCODE_SCALE));
+    TEST_ASSERT_FALSE(Settings::set(SETTING_SPEED_HZ + 2, GCODE_SCALE));
+    TEST_ASSERT_FALSE(Settings::set(SETTING_SPEED_HZ, 0));
+    TEST_ASSERT_FALSE(Settings::set(SETTING_RESUME, 2 * GCODE_SCALE));
+
+    motorX.setSpeed(1000);
+    reboot();
+    TEST_ASSERT_EQUAL(8000, motorX.getSpeed());
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, 42.5, motorY.getStepsPerMM());
+
+    Settings::restoreDefaults();
+    reboot();
+    TEST_ASSERT_EQUAL(6400, motorX.getSpeed());
+}
+
+void test_shaper_slots_are_shared() {
+    // Формирователь берётся из набора StepEngine только включённой осью
+    TEST_ASSERT_TRUE(Settings::set(SETTING_SHAPER_TYPE, SHAPER_ZV * GCODE_SCALE));
+    TEST_ASSERT_EQUAL(STEP_ENGINE_SHAPERS > 1, Settings::set(SETTING_SHAPER_TYPE + 1, SHAPER_ZV * GCODE_SCALE));
+    TEST_ASSERT_TRUE(Settings::set(SETTING_SHAPER_TYPE, SHAPER_NONE));
+    TEST_ASSERT_TRUE(Settings::set(SETTING_SHAPER_TYPE + 1, SHAPER_MZV * GCODE_SCALE));
+    TEST_ASSERT_EQUAL(SHAPER_MZV, Settings::data().shaper_type[1]);
+}
+
+void test_interrupted_write_keeps_previous_record() {
+    // После стирания записи идут в места 0, 1, ...
+    TEST_ASSERT_TRUE(Settings::set(SETTING_SPEED_HZ, 7000 * GCODE_SCALE));
+    TEST_ASSERT_TRUE(Settings::set(SETTING_SPEED_HZ, 7500 * GCODE_SCALE));
+    // Питание пропало посреди второй записи: CRC не сходится
+    EEPROM.write(SETTINGS_EEPROM_START + RECORD_SIZE + 10, EEPROM.read(SETTINGS_EEPROM_START + RECORD_SIZE + 10) ^ 0x55);
+    reboot();
+    TEST_ASSERT_EQUAL(7000, motorX.getSpeed());
+}
+
+void test_writes_rotate_through_slots() {
+    for (int i = 0; i < 4 * SETTINGS_SLOTS; i++) {
+        TEST_ASSERT_TRUE(Settings::set(SETTING_ACCEL, (20000 + i) * GCODE_SCALE));
+    }
+    // Номер записи в каждом месте переписан один раз на круг
+    for (int slot = 0; slot < SETTINGS_SLOTS; slot++) {
+        TEST_ASSERT_EQUAL(4, simEepromWrites(SETTINGS_EEPROM_START + slot * RECORD_SIZE + 1));
+    }
+    reboot();
+    TEST_ASSERT_EQUAL(20000 + 4 * SETTINGS_SLOTS - 1, motorX.getAcceleration());
+}
+
+void test_parked_position_is_restored_once() {
+    // Без калибровки сохранять нечего
+    TEST_ASSERT_FALSE(Settings::park());
+
+    TEST_ASSERT_TRUE(motorX.restorePosition(1234, 10000));
+    TEST_ASSERT_TRUE(Settings::park());
+    TEST_ASSERT_TRUE(Settings::isParked());
+
+    // $1=0: позиция не восстанавливается, но и не остаётся на следующий раз
+    reboot();
+    TEST_ASSERT_FALSE(motorX.isCalibrated());
+    TEST_ASSERT_FALSE(Settings::isParked());
+
+    TEST_ASSERT_TRUE(Settings::set(SETTING_RESUME, GCODE_SCALE));
+    TEST_ASSERT_TRUE(motorX.restorePosition(1234, 10000));
+    TEST_ASSERT_TRUE(Settings::park());
+    reboot();
+    TEST_ASSERT_TRUE(motorX.isCalibrated());
+    TEST_ASSERT_FALSE(motorY.isCalibrated());
+    TEST_ASSERT_EQUAL(1234, motorX.getCurrentPosition());
+    TEST_ASSERT_EQUAL(10000, motorX.getMaxPosition());
+
+    // Перезагрузка без новой парковки - нужна G28
+    reboot();
+    TEST_ASSERT_FALSE(motorX.isCalibrated());
+}
+
+void test_parked_axis_stays_energized_at_boot() {
+    TEST_ASSERT_TRUE(Settings::set(SETTING_RESUME, GCODE_SCALE));
+    TEST_ASSERT_TRUE(motorX.restorePosition(1234, 10000));
+    TEST_ASSERT_TRUE(Settings::park());
+
+    // Включение, как в setup(): настройки, затем пины
+    motorX.abort(true);
+    motorY.abort(true);
+    simReset();
+    Settings::begin(defaults);
+    AxisGroup::begin();
+
+    // ENA X (активный LOW) не поднимался, Y выключен
+    const std::vector<SimEdge>& trace = simTrace();
+    for (size_t i = 0; i < trace.size(); i++) {
+        TEST_ASSERT_FALSE(trace[i].pin == 10 && trace[i].level == HIGH);
+    }
+    TEST_ASSERT_EQUAL(LOW, simPinLevel(10));
+    TEST_ASSERT_EQUAL(HIGH, simPinLevel(14));
+    TEST_ASSERT_TRUE(motorX.isCalibrated());
+}
+
+void test_motion_after_park_clears_position() {
+    TEST_ASSERT_TRUE(Settings::set(SETTING_RESUME, GCODE_SCALE));
+    TEST_ASSERT_TRUE(motorX.restorePosition(500, 10000));
+    TEST_ASSERT_TRUE(Settings::park());
+    // Так делает main.cpp перед каждым перемещением
+    Settings::clearPosition();
+    reboot();
+    TEST_ASSERT_FALSE(motorX.isCalibrated());
+}
+
+void test_probe_pin_not_on_driver_outputs() {
+    // ENA, DIR и PUL осей - не вход щупа: подтяжка сбила бы драйвер
+    TEST_ASSERT_FALSE(Settings::set(SETTING_PROBE_PIN, 10 * GCODE_SCALE));
+    TEST_ASSERT_FALSE(Settings::set(SETTING_PROBE_PIN, 11 * GCODE_SCALE));
+    TEST_ASSERT_FALSE(Settings::set(SETTING_PROBE_PIN, 12 * GCODE_SCALE));
+    TEST_ASSERT_FALSE(Settings::set(SETTING_PROBE_PIN, 16 * GCODE_SCALE));
+    TEST_ASSERT_EQUAL(0, simEepromWrites());
+
+    // Пин концевика оси - можно, и после перезагрузки щуп на нём
+    TEST_ASSERT_TRUE(Settings::set(SETTING_PROBE_PIN, 13 * GCODE_SCALE));
+    reboot();
+    simSetInput(13, LOW);
+    TEST_ASSERT_TRUE(Probe::read());
+    simSetInput(13, -1);
+    TEST_ASSERT_FALSE(Probe::read());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_defaults_when_eeprom_is_empty);
+    RUN_TEST(test_set_is_saved_and_reloaded);
+    RUN_TEST(test_shaper_slots_are_shared);
+    RUN_TEST(test_interrupted_write_keeps_previous_record);
+    RUN_TEST(test_writes_rotate_through_slots);
+    RUN_TEST(test_parked_position_is_restored_once);
+    RUN_TEST(test_parked_axis_stays_energized_at_boot);
+    RUN_TEST(test_motion_after_park_clears_position);
+    RUN_TEST(test_probe_pin_not_on_driver_outputs);
+    return UNITY_END();
+}
@@ -0,0 +1,190 @@
+#include <unity.h>
+#include <Arduino.h>
+#include <math.h>
+#include "InputShaper.h"
+
+// Формирователь без движка: заданные шаги подаются по тактам так же, как
+// их выдаёт Брезенхем StepEngine, выход проверяется по шагам и по
+// колебаниям модели портала - осциллятора, который тянет за собой ось.
+
+const double TICK_S = 1.0 / STEP_ENGINE_TICK_HZ;
+
+struct Profile {
+    double speed_hz; // Крейсерская скорость
+    double accel;    // Ускорение, шаги/с^2
+    long steps;      // Длина перемещения
+};
+
+struct Result {
+    long steps;         // Выходные шаги со знаком
+    long commanded;     // Заданные шаги со знаком
+    long ticks;         // Тактов до остановки выхода
+    long command_ticks; // Тактов до последнего заданного шага
+    long turns;
+    double residual;    // Наибольшее отклонение груза после остановки, шаги
+};
+
+// Осциллятор: y'' = w^2 (u - y) - 2 z w y', u - позиция оси в шагах
+struct Oscillator {
+    double w, z, y, v;
+    void step(double u) {
+        v += (w * w * (u - y) - 2 * z * w * v) * TICK_S;
+        y += v * TICK_S;
+    }
+};
+
+// Трапеция задаётся накопителем скорости, как профиль блока в движке
+static Result run(InputShaper* shaper, const Profile& p, double freq_hz, double damping) {
+    Result r = { 0, 0, 0, 0, 0, 0 };
+    Oscillator osc = { 2 * M_PI * freq_hz, damping, 0, 0 };
+    double accum = 0;
+    double speed = 0;
+    double braking_at = p.steps - p.speed_hz * p.speed_hz / (2 * p.accel);
+    int8_t dir = p.steps >= 0 ? 1 : -1;
+    long target = labs(p.steps);
+    if (shaper != NULL) shaper->setCommandDir(dir);
+    bool pending = false;
+    int8_t out_dir = 0;
+    uint8_t phase = 0;
+    long settle = 0;
+    for (long tick = 0; tick < 40L * STEP_ENGINE_TICK_HZ; tick++) {
+        // Шаг, подготовленный на прошлом такте
+        if (pending) {
+            r.steps += out_dir;
+            pending = false;
+        }
+        if (shaper != NULL && shaper->isActive()) {
+            uint8_t result = shaper->tick(phase == 0);
+            if (result == SHAPER_STEP) {
+                pending = true;
+                out_dir = shaper->direction();
+            } else if (result == SHAPER_TURN) {
+                r.turns++;
+            }
+        }
+        if (++phase == SHAPER_SAMPLE_TICKS) phase = 0;
+
+        long done = labs(r.commanded);
+        if (done < target) {
+            speed = done < braking_at ? speed + p.accel * TICK_S : speed - p.accel * TICK_S;
+            if (speed > p.speed_hz) speed = p.speed_hz;
+            if (speed < 200) speed = 200;
+            accum += speed * TICK_S;
+            if (accum >= 1) {
+                accum -= 1;
+                r.commanded += dir;
+                r.command_ticks = tick;
+                if (shaper != NULL) {
+                    shaper->command();
+                } else {
+                    pending = true;
+                    out_dir = dir;
+                }
+            }
+        }
+
+        osc.step(r.steps);
+        bool moving = labs(r.commanded) < target || pending || (shaper != NULL && shaper->isActive());
+        if (moving) {
+            r.ticks = tick;
+            continue;
+        }
+        // Колебания после остановки - 0.3 с
+        double deviation = fabs(osc.y - r.steps);
+        if (deviation > r.residual) r.residual = deviation;
+        if (++settle > (long)(0.3 * STEP_ENGINE_TICK_HZ)) break;
+    }
+    return r;
+}
+
+// Резкий разгон: груз отстаёт на a / w^2 = 16 шагов
+static const Profile MOVE = { 6400, 1000000, 4000 };
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_configure_limits() {
+    InputShaper shaper;
+    TEST_ASSERT_FALSE(shaper.isEnabled());
+    TEST_ASSERT_TRUE(shaper.configure(SHAPER_ZV, 10, 0));
+    TEST_ASSERT_TRUE(shaper.isEnabled());
+    // EI ждёт целый период - 100 мс не помещаются в историю
+    TEST_ASSERT_FALSE(shaper.configure(SHAPER_EI, 10, 0));
+    TEST_ASSERT_TRUE(shaper.configure(SHAPER_EI, 20, 0.1));
+    TEST_ASSERT_FALSE(shaper.configure(SHAPER_MZV, 40, 1.0));
+    TEST_ASSERT_FALSE(shaper.configure(SHAPER_TYPE_COUNT, 40, 0.1));
+    TEST_ASSERT_TRUE(shaper.configure(SHAPER_NONE, 0, 0));
+    TEST_ASSERT_FALSE(shaper.isEnabled());
+}
+
+void test_steps_are_preserved() {
+    const uint8_t types[3] = { SHAPER_ZV, SHAPER_MZV, SHAPER_EI };
+    for (uint8_t i = 0; i < 3; i++) {
+        InputShaper shaper;
+        TEST_ASSERT_TRUE(shaper.configure(types[i], 37.3, 0.08));
+        Result forward = run(&shaper, MOVE, 40, 0.05);
+        TEST_ASSERT_EQUAL(4000, forward.commanded);
+        TEST_ASSERT_EQUAL(4000, forward.steps);
+        TEST_ASSERT_FALSE(shaper.isActive());
+        // Выход отстаёт не больше чем на наибольшую задержку и выборку
+        double period_ticks = STEP_ENGINE_TICK_HZ / (37.3 * sqrt(1 - 0.08 * 0.08));
+        TEST_ASSERT_TRUE(forward.ticks - forward.command_ticks <= period_ticks + 2 * SHAPER_SAMPLE_TICKS);
+        // Назад, с той же историей: DIR выставляется заново
+        Profile back = { 3000, 500000, -1234 };
+        Result r = run(&shaper, back, 40, 0.05);
+        TEST_ASSERT_EQUAL(-1234, r.steps);
+        TEST_ASSERT_EQUAL(1, r.turns);
+    }
+}
+
+void test_zv_splits_steps_in_half() {
+    // Без затухания ZV - две половины шагов со сдвигом на полпериода:
+    // 25 Гц - 20 мс, ровно 20 выборок
+    InputShaper shaper;
+    TEST_ASSERT_TRUE(shaper.configure(SHAPER_ZV, 25, 0));
+    Profile constant = { 4000, 1e9, 400 }; // 4 шага за выборку, 100 мс
+    Result r = run(&shaper, constant, 40, 0.05);
+    TEST_ASSERT_EQUAL(400, r.steps);
+    // Вторая половина кончается на 20 мс позже заданной; ещё выборка -
+    // на расчёт и до выборки - на неполную последнюю выборку
+    long extra = r.ticks - r.command_ticks;
+    TEST_ASSERT_INT_WITHIN(SHAPER_SAMPLE_TICKS, 22 * SHAPER_SAMPLE_TICKS, extra);
+}
+
+void test_residual_vibration_is_suppressed() {
+    const double freq = 40;
+    const double damping = 0.05;
+    Result plain = run(NULL, MOVE, freq, damping);
+    TEST_ASSERT_EQUAL(4000, plain.steps);
+    TEST_ASSERT_TRUE(plain.residual > 5);
+
+    const uint8_t types[3] = { SHAPER_ZV, SHAPER_MZV, SHAPER_EI };
+    for (uint8_t i = 0; i < 3; i++) {
+        InputShaper shaper;
+        TEST_ASSERT_TRUE(shaper.configure(types[i], freq, damping));
+        Result shaped = run(&shaper, MOVE, freq, damping);
+        // Остаток - дискретность шага, а не колебания
+        TEST_ASSERT_TRUE(shaped.residual < plain.residual / 5);
+        TEST_ASSERT_TRUE(shaped.residual < 1.5);
+    }
+
+    // Ошибка частоты на 15%: EI терпит её лучше ZV
+    InputShaper zv, ei;
+    TEST_ASSERT_TRUE(zv.configure(SHAPER_ZV, freq, damping));
+    TEST_ASSERT_TRUE(ei.configure(SHAPER_EI, freq, damping));
+    Result zv_off = run(&zv, MOVE, freq * 1.15, damping);
+    Result ei_off = run(&ei, MOVE, freq * 1.15, damping);
+    TEST_ASSERT_TRUE(ei_off.residual < zv_off.residual);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_configure_limits);
+    RUN_TEST(test_steps_are_preserved);
+    RUN_TEST(test_zv_splits_steps_in_half);
+    RUN_TEST(test_residual_vibration_is_suppressed);
+    return UNITY_END();
+}
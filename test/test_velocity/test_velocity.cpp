@@ -0,0 +1,146 @@
+#include <unity.h>
+#include <Arduino.h>
+#include "StepperMotor.h"
+
+// Колесо на свободных пинах; двигатели main.cpp не инициализируются,
+// поэтому колесо - единственная ось движка
+const uint8_t PIN_ENA = 10;
+const uint8_t PIN_DIR = 11;
+const uint8_t PIN_PUL = 12;
+
+const long ACCEL = 10000;
+
+static StepperMotor wheel(PIN_ENA, PIN_DIR, PIN_PUL, false, 80.0, 1.8);
+
+static void wheelLoop() {
+    wheel.update();
+}
+
+static bool wheelStopped() {
+    return !wheel.isBusy();
+}
+
+// Интервалы между фронтами PUL начиная с элемента трассы from
+static std::vector<uint64_t> stepPeriods(size_t from) {
+    std::vector<uint64_t> periods;
+    const std::vector<SimEdge>& trace = simTrace();
+    uint64_t last = 0;
+    for (size_t i = from; i < trace.size(); i++) {
+        if (trace[i].pin != PIN_PUL || trace[i].level != HIGH) continue;
+        if (last != 0) periods.push_back(trace[i].time_ns - last);
+        last = trace[i].time_ns;
+    }
+    return periods;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_axis_rejects_velocity() {
+    simReset();
+    wheel.begin();
+    wheel.setAcceleration(ACCEL);
+    TEST_ASSERT_FALSE(wheel.setVelocity(1000));
+    wheel.setMotorType(WHEEL);
+    TEST_ASSERT_EQUAL(WHEEL, wheel.getMotorType());
+}
+
+void test_speed_change_without_stop() {
+    // Без калибровки: у колеса нет концевика и пределов
+    TEST_ASSERT_TRUE(wheel.setVelocity(2000));
+    simRun(wheelLoop, 500000);
+    size_t from = simTrace().size();
+    simRun(wheelLoop, 100000);
+    std::vector<uint64_t> cruise = stepPeriods(from);
+    TEST_ASSERT_INT_WITHIN(30000, 500000, cruise.back());
+
+    // Разгон до 4000 Гц на ходу: интервал только уменьшается
+    from = simTrace().size();
+    TEST_ASSERT_TRUE(wheel.setVelocity(4000));
+    simRun(wheelLoop, 400000);
+    std::vector<uint64_t> periods = stepPeriods(from);
+    for (size_t i = 0; i < periods.size(); i++) {
+        TEST_ASSERT_TRUE(periods[i] <= 500000 + 25000);
+    }
+    TEST_ASSERT_INT_WITHIN(30000, 250000, periods.back());
+
+    // Торможение до 1000 Гц без остановки
+    from = simTrace().size();
+    TEST_ASSERT_TRUE(wheel.setVelocity(1000));
+    simRun(wheelLoop, 500000);
+    periods = stepPeriods(from);
+    for (size_t i = 0; i < periods.size(); i++) {
+        TEST_ASSERT_TRUE(periods[i] <= 1000000 + 25000);
+    }
+    TEST_ASSERT_INT_WITHIN(30000, 1000000, periods.back());
+    TEST_ASSERT_TRUE(wheel.getCurrentPosition() > 0);
+}
+
+void test_reverse_and_stop() {
+    long before = wheel.getCurrentPosition();
+    TEST_ASSERT_TRUE(wheel.setVelocity(-2000));
+    simRun(wheelLoop, 600000);
+    TEST_ASSERT_TRUE(wheel.isBusy());
+    TEST_ASSERT_TRUE(wheel.getCurrentPosition() < before);
+
+    TEST_ASSERT_TRUE(wheel.setVelocity(0));
+    simRun(wheelLoop, 1000000, 10, wheelStopped);
+    TEST_ASSERT_FALSE(wheel.isBusy());
+    long stopped = wheel.getCurrentPosition();
+    simRun(wheelLoop, 100000);
+    TEST_ASSERT_EQUAL(stopped, wheel.getCurrentPosition());
+}
+
+void test_step_times_are_quantized_to_ticks() {
+    // 30 кГц - 1.33 такта на шаг: интервалы в один и два такта
+    wheel.setAcceleration(400000);
+    TEST_ASSERT_TRUE(wheel.setVelocity(30000));
+    simRun(wheelLoop, 200000);
+    size_t from = simTrace().size();
+    simRun(wheelLoop, 30000);
+    std::vector<uint64_t> periods = stepPeriods(from);
+    TEST_ASSERT_TRUE(periods.size() > 100);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < periods.size(); i++) {
+        TEST_ASSERT_TRUE(periods[i] == 25000 || periods[i] == 50000);
+        sum += periods[i];
+    }
+    TEST_ASSERT_INT_WITHIN(300, 33333, sum / periods.size());
+
+    // Импульс держится до следующего такта и опускается перед новым фронтом
+    const std::vector<SimEdge>& trace = simTrace();
+    int level = -1;
+    uint64_t rise = 0;
+    long falls = 0;
+    for (size_t i = from; i < trace.size(); i++) {
+        if (trace[i].pin != PIN_PUL) continue;
+        TEST_ASSERT_TRUE(trace[i].level != level);
+        if (trace[i].level == HIGH) {
+            rise = trace[i].time_ns;
+        } else if (rise != 0) {
+            TEST_ASSERT_EQUAL(25000, (long)(trace[i].time_ns - rise));
+            falls++;
+        }
+        level = trace[i].level;
+    }
+    TEST_ASSERT_INT_WITHIN(1, periods.size(), falls);
+
+    TEST_ASSERT_TRUE(wheel.setVelocity(0));
+    simRun(wheelLoop, 1000000, 10, wheelStopped);
+    TEST_ASSERT_FALSE(wheel.isBusy());
+    simRun(wheelLoop, 100);
+    TEST_ASSERT_EQUAL(LOW, simPinLevel(PIN_PUL));
+    wheel.setAcceleration(ACCEL);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_axis_rejects_velocity);
+    RUN_TEST(test_speed_change_without_stop);
+    RUN_TEST(test_reverse_and_stop);
+    RUN_TEST(test_step_times_are_quantized_to_ticks);
+    return UNITY_END();
+}
@@ -0,0 +1,421 @@
+// avrbench - прогон прошивки [env:bench] под simavr с подсчётом тактов.
+//
+// Прошивка для ATmega328P (16 МГц) выполняется в simavr без платы:
+// сценарий G-code подаётся в UART построчно, каждая следующая строка -
+// после "ok"/"error" на предыдущую. Концевики имитируются по шагам
+// PUL/DIR: ось стартует в позиции -s и замыкает концевик в нуле, поэтому
+// G28 в начале сценария выполняется как на станке.
+//
+// Такты считаются по меткам src/Bench.h (записи в GPIOR0-2). Длительность
+// участков loop() - без вложенных тактов прерывания. Вход и выход из
+// прерывания (сохранение регистров, около 50 тактов) в такт движка
+// не входят.
+//
+// Сборка из корня проекта (нужны libsimavr и libelf):
+//   pio run -e bench
+//   g++ -std=gnu++11 -O2 -Isrc -o avrbench tools/bench/avrbench.cpp
+//       -lsimavr -lelf
+//
+// Использование:
+//   avrbench [параметры] .pio/build/bench/firmware.elf сценарий.gcode
+//     -n имя    имя сценария в первом столбце (по умолчанию - файл)
+//     -s X,Y    позиция осей при включении, шаги (400,400)
+//     -t с      предел модельного времени (60)
+//     -b такты  бюджет такта движка (F_CPU / STEP_ENGINE_TICK_HZ = 400)
+//
+// Результат - строки "сценарий<TAB>метрика<TAB>значение" (целые числа),
+// удобные для сравнения прогонов (tools/bench/compare.sh). Метрики:
+//   cycles                  тактов от первой строки до остановки осей
+//   commands, errors        строк с ответом ok / error
+//   <участок>_count/_avg/_max  число и длительность участков в тактах;
+//                           loop - период итераций loop() с прерываниями
+//   parse_per_command       тактов разбора на одну строку
+//   cycles_per_step         тактов прерывания движка на один шаг
+//   isr_load_permille       доля тактов в прерывании движка, 1/1000
+//   ticks_over_budget       тактов движка длиннее бюджета
+//   steps_x, steps_y        выданные шаги
+//   step_rate_max_hz        наибольшая частота шагов оси за окно 10 мс
+//   sram_static, stack_max, sram_peak, sram_free_min  ОЗУ в байтах:
+//                           .data+.bss, наибольшая глубина стека, сумма
+//                           и остаток (куча не учитывается - malloc не
+//                           используется)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/avr_uart.h>
+#include <simavr/avr_ioport.h>
+#include "Bench.h"
+
+// Частота процессора платы nanoatmega328
+#define BENCH_F_CPU 16000000ULL
+
+// Адреса GPIOR0-2 в пространстве данных ATmega328P
+#define ADDR_GPIOR0 0x3E
+#define ADDR_GPIOR1 0x4A
+#define ADDR_GPIOR2 0x4B
+
+// PORTD: пины PUL и DIR обеих осей (см. настройки в src/main.cpp)
+#define ADDR_PORTD 0x2B
+
+// Окно измерения частоты шагов
+#define RATE_WINDOW_CYCLES (BENCH_F_CPU / 100)
+
+// Опрос "?" в конце сценария
+#define IDLE_POLL_CYCLES (BENCH_F_CPU / 200)
+
+#define STACK_DEPTH 16
+
+static const char* const mark_names[BENCH_MARK_COUNT] = {
+    NULL, "loop", "tick", "tick_step", "motor_update", "planner_update",
+    "parse_byte", "parse_line", "execute"
+};
+
+struct Stat {
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+};
+
+struct Region {
+    uint64_t start;
+    uint64_t nested; // Тактов во вложенных участках (прерываниях)
+};
+
+// Имитация оси: позиция по шагам, концевик замкнут в нуле и ниже
+struct Axis {
+    uint8_t pul_bit;
+    uint8_t dir_bit;
+    avr_irq_t* endstop;
+    long position;
+    uint32_t level;
+    int endstop_level;
+    uint64_t steps;
+    uint64_t window;
+    uint32_t window_steps;
+    uint32_t window_max;
+};
+
+enum Phase {
+    PHASE_BOOT,     // Ждём конца приветствия
+    PHASE_SCRIPT,   // Передаём сценарий
+    PHASE_FINISH,   // Ждём остановки осей
+    PHASE_DONE
+};
+
+static avr_t* avr;
+static Stat stats[BENCH_MARK_COUNT];
+static uint64_t last_mark[BENCH_MARK_COUNT];
+static Region regions[STACK_DEPTH];
+static int depth = 0;
+static uint64_t tick_budget = BENCH_F_CPU / 40000;
+static uint64_t over_budget = 0;
+static Axis axes[2];
+
+static avr_irq_t* uart_in;
+static bool xon = true;
+static std::string tx;
+static std::string rx_line;
+static Phase phase = PHASE_BOOT;
+static bool waiting = false; // Строка отправлена, ответа ещё нет
+static bool idle = false;
+static uint64_t commands = 0;
+static uint64_t errors = 0;
+
+static void record(uint8_t id, uint64_t cycles) {
+    if (id == 0 || id >= BENCH_MARK_COUNT) return;
+    Stat& s = stats[id];
+    s.count++;
+    s.total += cycles;
+    if (cycles > s.max) s.max = cycles;
+}
+
+static void resetStats() {
+    memset(stats, 0, sizeof(stats));
+    memset(last_mark, 0, sizeof(last_mark));
+    over_budget = 0;
+    for (int i = 0; i < 2; i++) {
+        axes[i].steps = 0;
+        axes[i].window_steps = 0;
+        axes[i].window_max = 0;
+    }
+}
+
+static void onMark(avr_t* avr, avr_io_addr_t addr, uint8_t v, void* param) {
+    if (v < BENCH_MARK_COUNT && last_mark[v] != 0) {
+        record(v, avr->cycle - last_mark[v]);
+    }
+    if (v < BENCH_MARK_COUNT) last_mark[v] = avr->cycle;
+}
+
+static void onBegin(avr_t* avr, avr_io_addr_t addr, uint8_t v, void* param) {
+    if (depth >= STACK_DEPTH) {
+        fprintf(stderr, "avrbench: вложенность меток больше %d\n", STACK_DEPTH);
+        exit(1);
+    }
+    regions[depth].start = avr->cycle;
+    regions[depth].nested = 0;
+    depth++;
+}
+
+static void onEnd(avr_t* avr, avr_io_addr_t addr, uint8_t v, void* param) {
+    if (depth == 0) return; // Начало было до сброса статистики
+    depth--;
+    uint64_t elapsed = avr->cycle - regions[depth].start;
+    uint64_t own = elapsed - regions[depth].nested;
+    record(v, own);
+    if ((v == BENCH_TICK || v == BENCH_TICK_STEP) && own > tick_budget) {
+        over_budget++;
+    }
+    if (depth > 0) regions[depth - 1].nested += elapsed;
+}
+
+static void onPul(avr_irq_t* irq, uint32_t value, void* param) {
+    Axis& axis = *(Axis*)param;
+    bool rising = value && !axis.level;
+    axis.level = value;
+    if (!rising) return;
+    axis.position += (avr->data[ADDR_PORTD] & (1 << axis.dir_bit)) ? 1 : -1;
+    axis.steps++;
+    uint64_t window = avr->cycle / RATE_WINDOW_CYCLES;
+    if (window != axis.window) {
+        axis.window = window;
+        axis.window_steps = 0;
+    }
+    if (++axis.window_steps > axis.window_max) axis.window_max = axis.window_steps;
+    int level = axis.position <= 0 ? 0 : 1;
+    if (level != axis.endstop_level) {
+        axis.endstop_level = level;
+        avr_raise_irq(axis.endstop, level);
+    }
+}
+
+static void onLine(const std::string& line) {
+    if (phase == PHASE_BOOT && line.compare(0, 5, "-----") == 0) {
+        // Приветствие закончено: замеры - с первой строки сценария
+        phase = PHASE_SCRIPT;
+        resetStats();
+        return;
+    }
+    if (line.compare(0, 2, "ok") == 0) {
+        commands++;
+        waiting = false;
+    } else if (line.compare(0, 6, "error:") == 0) {
+        fprintf(stderr, "avrbench: %s\n", line.c_str());
+        errors++;
+        waiting = false;
+    } else if (line.compare(0, 5, "<Idle") == 0) {
+        idle = true;
+    }
+}
+
+static void onUartOut(avr_irq_t* irq, uint32_t value, void* param) {
+    char c = (char)value;
+    if (c == '\n') {
+        if (!rx_line.empty() && rx_line[rx_line.size() - 1] == '\r') {
+            rx_line.erase(rx_line.size() - 1);
+        }
+        onLine(rx_line);
+        rx_line.clear();
+    } else {
+        rx_line += c;
+    }
+}
+
+static void onXon(avr_irq_t* irq, uint32_t value, void* param) {
+    xon = true;
+}
+
+static void onXoff(avr_irq_t* irq, uint32_t value, void* param) {
+    xon = false;
+}
+
+static bool parsePair(const char* text, long out[2]) {
+    char* end;
+    out[0] = strtol(text, &end, 10);
+    if (*end != ',') return false;
+    out[1] = strtol(end + 1, &end, 10);
+    return *end == '\0';
+}
+
+static void usage() {
+    fprintf(stderr, "usage: avrbench [-n name] [-s X,Y] [-t seconds] [-b cycles] firmware.elf file.gcode\n");
+    exit(2);
+}
+
+static void print(const char* name, const char* metric, uint64_t value) {
+    printf("%s\t%s\t%llu\n", name, metric, (unsigned long long)value);
+}
+
+int main(int argc, char** argv) {
+    const char* name = NULL;
+    long start[2] = { 400, 400 };
+    double limit_s = 60;
+    const char* paths[2] = { NULL, NULL };
+    int path_count = 0;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-' && argv[i][1] != '\0' && argv[i][2] == '\0' && i + 1 < argc) {
+            const char* value = argv[++i];
+            switch (argv[i - 1][1]) {
+                case 'n': name = value; break;
+                case 's': if (!parsePair(value, start)) usage(); break;
+                case 't': limit_s = atof(value); break;
+                case 'b': tick_budget = strtoull(value, NULL, 10); break;
+                default: usage();
+            }
+        } else if (path_count < 2) {
+            paths[path_count++] = argv[i];
+        } else {
+            usage();
+        }
+    }
+    if (path_count != 2 || limit_s <= 0 || start[0] <= 0 || start[1] <= 0) {
+        usage();
+    }
+    if (name == NULL) {
+        const char* base = strrchr(paths[1], '/');
+        name = base ? base + 1 : paths[1];
+    }
+
+    // Сценарий: строки без пустых, в порядке файла
+    FILE* input = fopen(paths[1], "r");
+    if (input == NULL) {
+        perror(paths[1]);
+        return 1;
+    }
+    std::vector<std::string> script;
+    char buffer[256];
+    while (fgets(buffer, sizeof(buffer), input) != NULL) {
+        std::string line(buffer);
+        while (!line.empty() && (line[line.size() - 1] == '\n' || line[line.size() - 1] == '\r')) {
+            line.erase(line.size() - 1);
+        }
+        if (!line.empty()) script.push_back(line + "\n");
+    }
+    fclose(input);
+
+    elf_firmware_t firmware;
+    memset(&firmware, 0, sizeof(firmware));
+    if (elf_read_firmware(paths[0], &firmware) != 0) {
+        fprintf(stderr, "avrbench: не удалось прочитать %s\n", paths[0]);
+        return 1;
+    }
+    avr = avr_make_mcu_by_name("atmega328p");
+    if (avr == NULL) {
+        fprintf(stderr, "avrbench: simavr без поддержки atmega328p\n");
+        return 1;
+    }
+    avr_init(avr);
+    avr_load_firmware(avr, &firmware);
+    avr->frequency = BENCH_F_CPU;
+
+    avr_register_io_write(avr, ADDR_GPIOR0, onMark, NULL);
+    avr_register_io_write(avr, ADDR_GPIOR1, onBegin, NULL);
+    avr_register_io_write(avr, ADDR_GPIOR2, onEnd, NULL);
+
+    // UART: вывод прошивки - в разбор ответов, а не в терминал
+    uint32_t flags = 0;
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), onUartOut, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUT_XON), onXon, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUT_XOFF), onXoff, NULL);
+    uart_in = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+
+    // X: PUL D4, DIR D3, концевик D8 (PB0); Y: PUL D7, DIR D6, концевик D9 (PB1)
+    const uint8_t pul_bits[2] = { 4, 7 };
+    const uint8_t dir_bits[2] = { 3, 6 };
+    for (int i = 0; i < 2; i++) {
+        Axis& axis = axes[i];
+        memset(&axis, 0, sizeof(axis));
+        axis.pul_bit = pul_bits[i];
+        axis.dir_bit = dir_bits[i];
+        axis.position = start[i];
+        axis.endstop = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), i);
+        axis.endstop_level = 1;
+        avr_raise_irq(axis.endstop, 1);
+        avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), axis.pul_bit), onPul, &axis);
+    }
+
+    const uint64_t limit = (uint64_t)(limit_s * BENCH_F_CPU);
+    const uint16_t ramend = avr->ramend;
+    uint16_t sp_min = ramend;
+    uint64_t script_start = 0;
+    uint64_t poll_at = 0;
+    size_t next = 0;
+    while (phase != PHASE_DONE) {
+        int state = avr_run(avr);
+        if (state == cpu_Done || state == cpu_Crashed) {
+            fprintf(stderr, "avrbench: %s: процессор остановлен\n", name);
+            return 1;
+        }
+        if (avr->cycle > limit) {
+            fprintf(stderr, "avrbench: %s: превышено время %.0f с\n", name, limit_s);
+            return 1;
+        }
+        uint16_t sp = avr->data[R_SPL] | (avr->data[R_SPH] << 8);
+        if (sp < sp_min) sp_min = sp;
+
+        if (phase == PHASE_SCRIPT) {
+            if (script_start == 0) script_start = avr->cycle;
+            if (!waiting && tx.empty()) {
+                if (next < script.size()) {
+                    tx = script[next++];
+                    waiting = true;
+                } else {
+                    phase = PHASE_FINISH;
+                }
+            }
+        } else if (phase == PHASE_FINISH) {
+            if (idle) {
+                phase = PHASE_DONE;
+            } else if (avr->cycle >= poll_at && tx.empty()) {
+                tx = "?";
+                poll_at = avr->cycle + IDLE_POLL_CYCLES;
+            }
+        }
+        while (xon && !tx.empty()) {
+            avr_raise_irq(uart_in, (uint8_t)tx[0]);
+            tx.erase(0, 1);
+        }
+    }
+    uint64_t cycles = avr->cycle - script_start;
+
+    print(name, "cycles", cycles);
+    print(name, "commands", commands);
+    print(name, "errors", errors);
+    for (uint8_t id = 1; id < BENCH_MARK_COUNT; id++) {
+        const Stat& s = stats[id];
+        std::string metric(mark_names[id]);
+        print(name, (metric + "_count").c_str(), s.count);
+        print(name, (metric + "_avg").c_str(), s.count ? s.total / s.count : 0);
+        print(name, (metric + "_max").c_str(), s.max);
+    }
+    const Stat& byte = stats[BENCH_PARSE_BYTE];
+    const Stat& line = stats[BENCH_PARSE_LINE];
+    print(name, "parse_per_command", line.count ? (byte.total + line.total) / line.count : 0);
+    uint64_t isr = stats[BENCH_TICK].total + stats[BENCH_TICK_STEP].total;
+    uint64_t steps = axes[0].steps + axes[1].steps;
+    print(name, "cycles_per_step", steps ? isr / steps : 0);
+    print(name, "isr_load_permille", cycles ? isr * 1000 / cycles : 0);
+    print(name, "ticks_over_budget", over_budget);
+    print(name, "steps_x", axes[0].steps);
+    print(name, "steps_y", axes[1].steps);
+    uint32_t window_max = axes[0].window_max > axes[1].window_max ? axes[0].window_max : axes[1].window_max;
+    print(name, "step_rate_max_hz", window_max * (BENCH_F_CPU / RATE_WINDOW_CYCLES));
+
+    // ОЗУ ATmega328P: 0x100..RAMEND, стек растёт вниз от RAMEND
+    uint64_t sram = ramend - 0x100 + 1;
+    uint64_t stat = firmware.datasize + firmware.bsssize;
+    uint64_t stack = ramend - sp_min;
+    print(name, "sram_static", stat);
+    print(name, "stack_max", stack);
+    print(name, "sram_peak", stat + stack);
+    print(name, "sram_free_min", sram > stat + stack ? sram - stat - stack : 0);
+    return errors == 0 ? 0 : 1;
+}
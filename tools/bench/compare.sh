@@ -0,0 +1,29 @@
+#!/bin/sh
+# Сравнение двух прогонов tools/bench/run.sh:
+#   tools/bench/compare.sh было.tsv стало.tsv [порог, %]
+# Печатает метрики, изменившиеся больше порога (по умолчанию 2%).
+# Код выхода 1, если хоть одна метрика ухудшилась: выросли такты,
+# стек или ОЗУ, упала частота шагов или остаток ОЗУ. Счётчики
+# (_count, steps_*, cycles) показываются, но регрессией не считаются.
+
+[ $# -ge 2 ] || { echo "usage: compare.sh old.tsv new.tsv [percent]" >&2; exit 2; }
+
+awk -F'\t' -v limit="${3:-2}" '
+    NR == FNR { old[$1 FS $2] = $3; next }
+    !(($1 FS $2) in old) { next }
+    {
+        was = old[$1 FS $2]; now = $3
+        if (was == now) next
+        change = was != 0 ? (now - was) * 100 / was : 100
+        if (change < limit && -change < limit) next
+        higher_worse = $2 ~ /_avg$|_max$|per_command$|per_step$|permille$|over_budget$|^errors$|^stack_max$|^sram_peak$|^sram_static$/
+        lower_worse = $2 ~ /rate_hz$|free_min$/
+        mark = ""
+        if ((higher_worse && now > was) || (lower_worse && now < was)) {
+            mark = "  <- хуже"
+            worse = 1
+        }
+        printf "%s\t%s\t%s -> %s (%+.1f%%)%s\n", $1, $2, was, now, change, mark
+    }
+    END { exit worse }
+' "$1" "$2"
@@ -0,0 +1,49 @@
+#!/bin/sh
+# Замеры прошивки под simavr: сборка [env:bench], прогон сценариев
+# tools/bench/scenarios/*.gcode и поиск наибольшей частоты шагов.
+#
+#   tools/bench/run.sh > bench.tsv
+#   tools/bench/compare.sh было.tsv bench.tsv
+#
+# В stdout - только строки "сценарий<TAB>метрика<TAB>значение"
+# (см. tools/bench/avrbench.cpp), сборка и ошибки - в stderr.
+# Последняя строка - sweep max_step_rate_hz: наибольшая частота шагов
+# по диагонали (обе оси шагают одновременно), которую прошивка держит
+# без тактов движка длиннее бюджета и с отставанием не больше 2%.
+#
+# Базовых замеров в репозитории пока нет: run.sh ещё не прогонялся на
+# машине с avr-gcc (PlatformIO) и libsimavr. Первый прогон сохраняется
+# как tools/bench/baseline.tsv, дальше изменения сравниваются с ним
+# через compare.sh.
+
+set -e
+cd "$(dirname "$0")/../.."
+
+ELF=.pio/build/bench/firmware.elf
+BENCH=.pio/avrbench
+RATES="${BENCH_RATES:-5000 10000 15000 20000 25000 30000 35000 39000}"
+
+pio run -e bench >&2
+g++ -std=gnu++11 -O2 -Isrc -o "$BENCH" tools/bench/avrbench.cpp -lsimavr -lelf >&2
+
+for scenario in tools/bench/scenarios/*.gcode; do
+    "$BENCH" -n "$(basename "$scenario" .gcode)" "$ELF" "$scenario"
+done
+
+# Скорость ведущей оси по диагонали - подача / 60 / sqrt(2)
+sweep=$(mktemp)
+trap 'rm -f "$sweep"' EXIT
+best=0
+for rate in $RATES; do
+    feed=$(awk -v r="$rate" 'BEGIN { printf "%d", r * 60 * 1.41421356 + 0.5 }')
+    printf 'G28\nG1 X1000 Y1000 F%s\nG1 X9000 Y9000\nG1 X1000 Y1000\n' "$feed" > "$sweep"
+    result=$("$BENCH" -n "sweep_$rate" "$ELF" "$sweep")
+    echo "$result"
+    if echo "$result" | awk -F'\t' -v r="$rate" '
+            $2 == "step_rate_max_hz" { rate = $3 }
+            $2 == "ticks_over_budget" { over = $3 }
+            END { exit !(over == 0 && rate * 100 >= r * 98) }'; then
+        best=$rate
+    fi
+done
+printf 'sweep\tmax_step_rate_hz\t%s\n' "$best"
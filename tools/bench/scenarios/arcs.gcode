@@ -0,0 +1,8 @@
+; Дуги G2/G3: хорды строятся на контроллере
+G28
+G1 X3000 Y3000 F240000
+G2 X5000 Y3000 I1000 J0
+G3 X7000 Y3000 I1000 J0
+G2 X5000 Y5000 R2000
+G3 X3000 Y3000 R2000
+G1 X0 Y0
@@ -0,0 +1,27 @@
+; Ломаная из коротких G1: планировщик, стыки, тактовая часть
+G28
+G1 X2000 Y0 F240000
+G1 X2500 Y500
+G1 X3000 Y300
+G1 X3600 Y900
+G1 X4000 Y700
+G1 X4600 Y1500
+G1 X5000 Y1200
+G1 X5600 Y2000
+G1 X6000 Y1800
+G1 X6500 Y2600
+G1 X7000 Y2300
+G1 X7400 Y3000
+G1 X7000 Y3500
+G1 X6400 Y3300
+G1 X6000 Y4000
+G1 X5400 Y3700
+G1 X5000 Y4400
+G1 X4400 Y4200
+G1 X4000 Y5000
+G1 X3000 Y5000
+G21
+G1 X10.5 Y10.25
+G1 X20 Y15.75
+G22
+G1 X0 Y0
@@ -0,0 +1,13 @@
+; Разбор без движения: G1 без осей меняет только подачу
+G22
+G1 F6000
+G1 F12000 ; комментарий
+G1 F3000 (комментарий в скобках)
+G21
+G1 F600.5
+G1 F1200.25 ; мм/мин
+G22
+M114
+M119
+G1 F6000
+M872 S2 P0
@@ -0,0 +1,461 @@
+// segc - компилятор G-code в готовые отрезки для SegmentReplay.
+//
+// Вся математика перемещений выполняется на ПК: разбор G-code тем же
+// GCodeParser, что и в прошивке, дуги G2/G3, стыки по допуску отклонения
+// и разгоны с просмотром всей программы вперёд. На выходе - кадры
+// BINARY_SEGMENT (см. src/BinaryLink.h): каждый отрезок - одна фаза
+// профиля (разгон, крейсерский участок или торможение), которую движок
+// выполняет без вычислений с плавающей точкой.
+//
+// Сборка из корня проекта (Arduino API - из lib/ArduinoSim):
+//   g++ -std=gnu++11 -O2 -DARDUINO_SIM -Ilib/ArduinoSim -Isrc -o segc
+//       tools/segc/segc.cpp src/GCodeParser.cpp src/BinaryLink.cpp
+//       lib/ArduinoSim/ArduinoSim.cpp
+//
+// Использование:
+//   segc [параметры] программа.gcode > программа.bin
+//     -s X,Y    позиция в начале программы, шаги (по умолчанию 0,0)
+//     -m X,Y    шагов на мм (80,80)
+//     -l X,Y    длина реек, шаги (10000,10000)
+//     -v Гц     максимальная скорость осей (6400)
+//     -a Гц/с   ускорение осей (16000)
+//     -d шаги   допуск отклонения на стыках (PLANNER_JUNCTION_DEVIATION)
+//     -t        вместо кадров - таблица отрезков в текстовом виде
+//
+// Кадры нумеруются с 0: перед передачей прошивку переводят в двоичный
+// режим (M870), оси должны быть откалиброваны (G28 в начале программы
+// только обнуляет позицию для расчёта). Хост отправляет следующий кадр
+// после ACK предыдущего, как и для остальных кадров протокола.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "GCodeParser.h"
+#include "BinaryLink.h"
+#include "StepEngine.h"
+#include "Planner.h"
+#include "Arc.h"
+
+// Ограничения кадра BINARY_SEGMENT
+#define SEGMENT_MAX_STEPS 32767
+#define SEGMENT_MAX_HZ 65535
+
+struct Config {
+    long start[2];
+    double steps_per_mm[2];
+    long max_steps[2];
+    double speed;     // Гц каждой оси
+    double accel;     // Гц/с каждой оси
+    double deviation; // Шаги
+    bool text;
+};
+
+// Прямолинейный блок - как PlannerBlock, но с двойной точностью
+// и без ограничения длины очереди
+struct Block {
+    long delta[2];
+    long events;              // Шагов ведущей оси
+    double length;            // Длина в шагах
+    double k;                 // Шагов ведущей оси на шаг траектории
+    double accel;             // Ускорение вдоль траектории
+    double nominal_sqr;
+    double max_entry_sqr;
+    double entry_sqr;
+    double unit[2];
+};
+
+// Готовый отрезок
+struct Segment {
+    long steps[2];
+    double start_hz;
+    double end_hz;
+    double accel_hz; // Ускорение ведущей оси, Гц/с
+};
+
+static Config config;
+static std::vector<Block> blocks;
+static long position[2];
+static long feed_rate = 0;
+static bool feed_mm = false;
+static bool units_mm = false;
+
+static bool parsePair(const char* text, double out[2]) {
+    char* end;
+    out[0] = strtod(text, &end);
+    if (*end != ',') return false;
+    out[1] = strtod(end + 1, &end);
+    return *end == '\0';
+}
+
+static void usage() {
+    fprintf(stderr, "usage: segc [-s X,Y] [-m X,Y] [-l X,Y] [-v hz] [-a hz/s] [-d steps] [-t] file.gcode\n");
+    exit(2);
+}
+
+// Блок в абсолютную позицию target. Расчёт скоростей и угла на стыке
+// повторяет Planner::planBlock() и Planner::line().
+static void addLine(const long target_in[2]) {
+    long target[2];
+    Block block;
+    block.events = 0;
+    double length_sq = 0;
+    for (int i = 0; i < 2; i++) {
+        target[i] = target_in[i];
+        if (target[i] < 0) target[i] = 0;
+        if (target[i] > config.max_steps[i]) target[i] = config.max_steps[i];
+        block.delta[i] = target[i] - position[i];
+        if (labs(block.delta[i]) > block.events) block.events = labs(block.delta[i]);
+        length_sq += (double)block.delta[i] * block.delta[i];
+    }
+    if (block.events == 0) return;
+    block.length = sqrt(length_sq);
+    block.k = block.events / block.length;
+
+    double feed_length = block.length;
+    if (feed_mm) {
+        double mm_sq = 0;
+        for (int i = 0; i < 2; i++) {
+            double mm = block.delta[i] / config.steps_per_mm[i];
+            mm_sq += mm * mm;
+        }
+        feed_length = sqrt(mm_sq);
+    }
+    double speed = feed_rate > 0 ? feed_rate / 60.0 * block.events / feed_length : 1e9;
+    double accel = 1e9;
+    for (int i = 0; i < 2; i++) {
+        if (block.delta[i] == 0) continue;
+        double scale = (double)block.events / labs(block.delta[i]);
+        if (config.speed * scale < speed) speed = config.speed * scale;
+        if (config.accel * scale < accel) accel = config.accel * scale;
+    }
+    if (speed < 1) speed = 1;
+    speed /= block.k;
+    block.nominal_sqr = speed * speed;
+    block.accel = accel / block.k;
+
+    double cos_theta = 0;
+    for (int i = 0; i < 2; i++) {
+        block.unit[i] = block.delta[i] / block.length;
+        if (!blocks.empty()) cos_theta -= blocks.back().unit[i] * block.unit[i];
+    }
+    double junction_sqr = 0;
+    if (!blocks.empty() && cos_theta < 0.999999) {
+        if (cos_theta > -0.999999) {
+            double sin_half = sqrt(0.5 * (1.0 - cos_theta));
+            junction_sqr = block.accel * config.deviation * sin_half / (1.0 - sin_half);
+        } else {
+            junction_sqr = block.nominal_sqr;
+        }
+        if (junction_sqr > block.nominal_sqr) junction_sqr = block.nominal_sqr;
+        if (junction_sqr > blocks.back().nominal_sqr) junction_sqr = blocks.back().nominal_sqr;
+    }
+    block.max_entry_sqr = junction_sqr;
+    block.entry_sqr = 0;
+    blocks.push_back(block);
+    position[0] = target[0];
+    position[1] = target[1];
+}
+
+// Дуга хордами с точными sin/cos. Число хорд - как в Arc::start().
+static bool addArc(const long target[2], const double scale[2], double offset[2], bool clockwise) {
+    double center[2], start[2];
+    for (int i = 0; i < 2; i++) {
+        center[i] = position[i] / scale[i] + offset[i];
+        start[i] = -offset[i];
+    }
+    double radius = sqrt(offset[0] * offset[0] + offset[1] * offset[1]);
+    if (radius == 0) return false;
+    double end0 = target[0] / scale[0] - center[0];
+    double end1 = target[1] / scale[1] - center[1];
+    double travel = atan2(start[0] * end1 - start[1] * end0, start[0] * end0 + start[1] * end1);
+    if (clockwise) {
+        if (travel >= -1e-6) travel -= 2 * M_PI;
+    } else {
+        if (travel <= 1e-6) travel += 2 * M_PI;
+    }
+    double min_scale = scale[0] < scale[1] ? scale[0] : scale[1];
+    double tolerance = ARC_TOLERANCE_STEPS / min_scale;
+    long segments = 1;
+    if (radius > tolerance) {
+        segments = (long)floor(fabs(0.5 * travel * radius) / sqrt(tolerance * (2 * radius - tolerance)));
+    }
+    if (segments < 1) segments = 1;
+    double start_angle = atan2(start[1], start[0]);
+    for (long n = 1; n < segments; n++) {
+        double angle = start_angle + travel * n / segments;
+        long point[2] = {
+            lround((center[0] + radius * cos(angle)) * scale[0]),
+            lround((center[1] + radius * sin(angle)) * scale[1])
+        };
+        addLine(point);
+    }
+    addLine(target);
+    return true;
+}
+
+// Строка G-code с теми же командами и модальностью, что в main.cpp
+static bool execute(const GCodeCommand& cmd, long line) {
+    long target[2];
+    double scale[2] = { 1, 1 };
+    for (int i = 0; i < 2; i++) {
+        char letter = "XY"[i];
+        target[i] = position[i];
+        if (units_mm) scale[i] = config.steps_per_mm[i];
+        if (!cmd.has(letter)) continue;
+        target[i] = units_mm ? lround(cmd.value(letter) * scale[i] / GCODE_SCALE) : cmd.integer(letter);
+    }
+
+    if (cmd.isCode('G', 28)) {
+        // Отрезки не прерываются калибровкой: G28 допустим только в начале
+        if (!blocks.empty()) {
+            fprintf(stderr, "segc: строка %ld: G28 после перемещений не поддерживается\n", line);
+            return false;
+        }
+        if (!cmd.has('X') && !cmd.has('Y')) {
+            position[0] = position[1] = 0;
+        }
+        if (cmd.has('X')) position[0] = 0;
+        if (cmd.has('Y')) position[1] = 0;
+        return true;
+    }
+    if (cmd.isCode('G', 1) || cmd.isCode('G', 2) || cmd.isCode('G', 3)) {
+        if (cmd.has('F')) {
+            feed_rate = cmd.integer('F');
+            feed_mm = units_mm;
+        }
+        if (cmd.isCode('G', 1)) {
+            if (cmd.has('X') || cmd.has('Y')) addLine(target);
+            return true;
+        }
+        bool clockwise = cmd.isCode('G', 2);
+        double offset[2];
+        if (cmd.has('R')) {
+            double x = (target[0] - position[0]) / scale[0];
+            double y = (target[1] - position[1]) / scale[1];
+            double radius = (double)cmd.value('R') / GCODE_SCALE;
+            double chord = sqrt(x * x + y * y);
+            double h = 4.0 * radius * radius - x * x - y * y;
+            if (chord == 0 || h < 0) {
+                fprintf(stderr, "segc: строка %ld: радиус меньше половины расстояния до цели\n", line);
+                return false;
+            }
+            h = sqrt(h) / chord;
+            if (clockwise) h = -h;
+            if (radius < 0) h = -h;
+            offset[0] = 0.5 * (x - y * h);
+            offset[1] = 0.5 * (y + x * h);
+        } else if (cmd.has('I') || cmd.has('J')) {
+            offset[0] = (double)cmd.value('I') / GCODE_SCALE;
+            offset[1] = (double)cmd.value('J') / GCODE_SCALE;
+        } else {
+            fprintf(stderr, "segc: строка %ld: для дуги нужен центр I/J или радиус R\n", line);
+            return false;
+        }
+        if (!addArc(target, scale, offset, clockwise)) {
+            fprintf(stderr, "segc: строка %ld: дуга нулевого радиуса\n", line);
+            return false;
+        }
+        return true;
+    }
+    if (cmd.isCode('G', 21) || cmd.isCode('G', 22)) {
+        units_mm = cmd.isCode('G', 21);
+        return true;
+    }
+    fprintf(stderr, "segc: строка %ld: команда не поддерживается\n", line);
+    return false;
+}
+
+// Согласование скоростей по всей программе: проход назад от остановки
+// в конце, затем вперёд от остановки в начале
+static void plan() {
+    double next_entry_sqr = 0;
+    for (size_t n = blocks.size(); n-- > 0;) {
+        Block& block = blocks[n];
+        double entry_sqr = next_entry_sqr + 2.0 * block.accel * block.length;
+        if (entry_sqr > block.max_entry_sqr) entry_sqr = block.max_entry_sqr;
+        block.entry_sqr = entry_sqr;
+        next_entry_sqr = entry_sqr;
+    }
+    for (size_t n = 1; n < blocks.size(); n++) {
+        const Block& prev = blocks[n - 1];
+        double reachable_sqr = prev.entry_sqr + 2.0 * prev.accel * prev.length;
+        if (blocks[n].entry_sqr > reachable_sqr) blocks[n].entry_sqr = reachable_sqr;
+    }
+}
+
+// Фаза профиля блока от шага from до шага to ведущей оси. Длинная фаза
+// делится на части по SEGMENT_MAX_STEPS, квадрат скорости линеен по пути.
+static void addPhase(std::vector<Segment>& out, const Block& block, long from, long to,
+    double start_hz, double end_hz, double accel_hz) {
+    long parts = (to - from + SEGMENT_MAX_STEPS - 1) / SEGMENT_MAX_STEPS;
+    for (long p = 0; p < parts; p++) {
+        long a = from + (to - from) * p / parts;
+        long b = from + (to - from) * (p + 1) / parts;
+        Segment segment;
+        for (int i = 0; i < 2; i++) {
+            // Округление от абсолютного шага - ошибка не накапливается
+            segment.steps[i] = lround((double)block.delta[i] * b / block.events) -
+                lround((double)block.delta[i] * a / block.events);
+        }
+        double fa = (double)(a - from) / (to - from);
+        double fb = (double)(b - from) / (to - from);
+        segment.start_hz = sqrt(start_hz * start_hz + (end_hz * end_hz - start_hz * start_hz) * fa);
+        segment.end_hz = sqrt(start_hz * start_hz + (end_hz * end_hz - start_hz * start_hz) * fb);
+        segment.accel_hz = accel_hz;
+        out.push_back(segment);
+    }
+}
+
+// Разбиение блока на разгон, крейсерский участок и торможение - та же
+// трапеция, что строит Planner::blockRates()
+static void splitBlock(std::vector<Segment>& out, const Block& block, double exit_sqr) {
+    double k = block.k;
+    double cruise = sqrt(block.nominal_sqr) * k;
+    double floor_rate = sqrt(2.0 * block.accel * k);
+    if (floor_rate > cruise) floor_rate = cruise;
+    double entry = sqrt(block.entry_sqr) * k;
+    double exit = sqrt(exit_sqr) * k;
+    if (entry < floor_rate) entry = floor_rate;
+    if (exit < floor_rate) exit = floor_rate;
+
+    double decel = (block.nominal_sqr - exit_sqr) / (2.0 * block.accel);
+    double accel_len = (block.nominal_sqr - block.entry_sqr) / (2.0 * block.accel);
+    if (accel_len + decel > block.length) {
+        decel = (2.0 * block.accel * block.length + block.entry_sqr - exit_sqr) / (4.0 * block.accel);
+        if (decel < 0) decel = 0;
+        if (decel > block.length) decel = block.length;
+        accel_len = block.length - decel;
+        cruise = sqrt(block.entry_sqr + 2.0 * block.accel * accel_len) * k;
+        if (cruise < entry) cruise = entry;
+    }
+    long decel_steps = lround(decel * k);
+    long accel_steps = lround(accel_len * k);
+    if (decel_steps > block.events) decel_steps = block.events;
+    if (accel_steps > block.events - decel_steps) accel_steps = block.events - decel_steps;
+    if (accel_steps < 0) accel_steps = 0;
+
+    double accel_hz = block.accel * k;
+    long cruise_end = block.events - decel_steps;
+    if (accel_steps > 0) addPhase(out, block, 0, accel_steps, entry, cruise, accel_hz);
+    else cruise = entry;
+    if (cruise_end > accel_steps) addPhase(out, block, accel_steps, cruise_end, cruise, cruise, accel_hz);
+    if (decel_steps > 0) addPhase(out, block, cruise_end, block.events, cruise, exit, accel_hz);
+}
+
+static void writeFrame(uint8_t seq, const Segment& segment, bool last) {
+    uint16_t start_hz = (uint16_t)lround(segment.start_hz);
+    uint16_t end_hz = (uint16_t)lround(segment.end_hz);
+    uint32_t accel = (uint32_t)(segment.accel_hz * STEP_ACCEL_PER_HZ_S);
+    uint8_t frame[BINARY_FRAME_SIZE] = {
+        BINARY_SYNC_HOST, seq, BINARY_SEGMENT, (uint8_t)(last ? BINARY_SEGMENT_LAST : 0),
+        (uint8_t)segment.steps[0], (uint8_t)((uint16_t)segment.steps[0] >> 8),
+        (uint8_t)segment.steps[1], (uint8_t)((uint16_t)segment.steps[1] >> 8),
+        (uint8_t)start_hz, (uint8_t)(start_hz >> 8), (uint8_t)end_hz, (uint8_t)(end_hz >> 8),
+        (uint8_t)accel, (uint8_t)(accel >> 8), (uint8_t)(accel >> 16), (uint8_t)(accel >> 24)
+    };
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 1; i < BINARY_FRAME_SIZE - 2; i++) {
+        crc = BinaryLink::crcUpdate(crc, frame[i]);
+    }
+    frame[BINARY_FRAME_SIZE - 2] = crc & 0xFF;
+    frame[BINARY_FRAME_SIZE - 1] = crc >> 8;
+    fwrite(frame, 1, BINARY_FRAME_SIZE, stdout);
+}
+
+int main(int argc, char** argv) {
+    config.start[0] = config.start[1] = 0;
+    config.steps_per_mm[0] = config.steps_per_mm[1] = 80;
+    config.max_steps[0] = config.max_steps[1] = 10000;
+    config.speed = 6400;
+    config.accel = 16000;
+    config.deviation = PLANNER_JUNCTION_DEVIATION;
+    config.text = false;
+
+    const char* path = NULL;
+    for (int i = 1; i < argc; i++) {
+        double pair[2];
+        if (strcmp(argv[i], "-t") == 0) {
+            config.text = true;
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0' && argv[i][2] == '\0' && i + 1 < argc) {
+            const char* value = argv[++i];
+            switch (argv[i - 1][1]) {
+                case 's':
+                    if (!parsePair(value, pair)) usage();
+                    config.start[0] = lround(pair[0]);
+                    config.start[1] = lround(pair[1]);
+                    break;
+                case 'm':
+                    if (!parsePair(value, config.steps_per_mm)) usage();
+                    break;
+                case 'l':
+                    if (!parsePair(value, pair)) usage();
+                    config.max_steps[0] = lround(pair[0]);
+                    config.max_steps[1] = lround(pair[1]);
+                    break;
+                case 'v': config.speed = atof(value); break;
+                case 'a': config.accel = atof(value); break;
+                case 'd': config.deviation = atof(value); break;
+                default: usage();
+            }
+        } else if (path == NULL) {
+            path = argv[i];
+        } else {
+            usage();
+        }
+    }
+    if (path == NULL || config.speed <= 0 || config.speed > SEGMENT_MAX_HZ || config.accel <= 0) {
+        usage();
+    }
+
+    FILE* input = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (input == NULL) {
+        perror(path);
+        return 1;
+    }
+    position[0] = config.start[0];
+    position[1] = config.start[1];
+    GCodeCommand command;
+    GCodeParser parser(command);
+    long line = 1;
+    int c;
+    bool ok = true;
+    while ((c = fgetc(input)) != EOF) {
+        if (!parser.feed((char)c)) continue;
+        if (parser.status() != GCODE_OK) {
+            fprintf(stderr, "segc: строка %ld: ошибка разбора %u\n", line, parser.status());
+            ok = false;
+        } else if (parser.command().words != 0 && !execute(parser.command(), line)) {
+            ok = false;
+        }
+        if (c == '\n') line++;
+    }
+    if (parser.feed('\n') && parser.command().words != 0) {
+        ok = parser.status() == GCODE_OK && execute(parser.command(), line) && ok;
+    }
+    if (input != stdin) fclose(input);
+    if (!ok) return 1;
+
+    plan();
+    std::vector<Segment> segments;
+    for (size_t n = 0; n < blocks.size(); n++) {
+        double exit_sqr = n + 1 < blocks.size() ? blocks[n + 1].entry_sqr : 0;
+        splitBlock(segments, blocks[n], exit_sqr);
+    }
+
+    double duration = 0;
+    for (size_t n = 0; n < segments.size(); n++) {
+        const Segment& s = segments[n];
+        long events = labs(s.steps[0]) > labs(s.steps[1]) ? labs(s.steps[0]) : labs(s.steps[1]);
+        duration += 2.0 * events / (s.start_hz + s.end_hz);
+        if (config.text) {
+            printf("%ld %ld %.0f %.0f %.0f\n", s.steps[0], s.steps[1], s.start_hz, s.end_hz, s.accel_hz);
+        } else {
+            writeFrame((uint8_t)n, s, n + 1 == segments.size());
+        }
+    }
+    fprintf(stderr, "segc: блоков %lu, отрезков %lu, время %.3f с, конец X=%ld Y=%ld\n",
+        (unsigned long)blocks.size(), (unsigned long)segments.size(), duration, position[0], position[1]);
+    return 0;
+}
@@ -0,0 +1,226 @@
+// shapecheck - проверка подавления резонанса (InputShaper) без станка.
+//
+// Прошивка из src/ целиком работает в виртуальном времени ArduinoSim, как
+// в тестах [env:native]; программа G-code передаётся построчно с ожиданием
+// "ok". Шаги осей с пинов PUL/DIR двигают модель портала - груз на пружине
+// с резонансом -f и затуханием -z, - и по ней считается, насколько груз
+// отклоняется от оси после остановок. Формирователь включается строками
+// самой программы ($140=3 $150=40 ...), поэтому один и тот же файл можно
+// прогнать с разными настройками и сравнить.
+//
+// Сборка из корня проекта (формирователи на обеих осях сразу):
+//   g++ -std=gnu++11 -O2 -DARDUINO_SIM -DSERIAL_RX_BUFFER_SIZE=128
+//       -DSTEP_ENGINE_SHAPERS=2 -Ilib/ArduinoSim -Isrc -o shapecheck
+//       tools/shaper/shapecheck.cpp src/*.cpp lib/ArduinoSim/*.cpp
+//
+// Использование:
+//   shapecheck [параметры] программа.gcode
+//     -f Гц     резонанс модели (40)
+//     -z доля   затухание модели (0.05)
+//     -t        перед итогом - по строке на миллисекунду:
+//               время, позиция и груз каждой оси
+//
+// Перед программой станок калибруется (G28, концевики срабатывают в
+// модели, как в test/firmware_sim.h); метрики считаются с начала программы.
+// В stdout - строки "ось<TAB>метрика<TAB>значение":
+//   residual_steps - наибольшее отклонение груза после остановок оси
+//   peak_steps     - наибольшее отклонение за всё время
+//   steps          - шагов оси
+// и "all<TAB>time_ms<TAB>..." - время программы до остановки всех осей.
+// Формирователь сглаживает развороты: шагов может быть на несколько
+// меньше, чем без него, конечная позиция та же.
+// Подбор частоты - прогоном с разными $150 в цикле оболочки.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <Arduino.h>
+#include "StepEngine.h"
+#include "AxisGroup.h"
+#include "Planner.h"
+
+void setup();
+void loop();
+
+// Пины из main.cpp
+static const uint8_t PIN_DIR[2] = { 3, 6 };
+static const uint8_t PIN_PUL[2] = { 4, 7 };
+static const uint8_t PIN_ENDSTOP[2] = { 8, 9 };
+static const char LETTER[2] = { 'X', 'Y' };
+
+// Концевики в модели - на этой позиции от включения
+static const long SWITCH_AT = -500;
+
+// Ось стоит, если шагов не было столько времени
+static const uint64_t STOPPED_NS = 5000000ULL;
+
+// После программы - время на затухание колебаний
+static const uint32_t SETTLE_US = 300000;
+
+static const double DT_S = 10e-6;
+
+struct Axis {
+    long position;     // Шаги с пинов от включения
+    int dir;
+    long steps;
+    uint64_t last_step_ns;
+    double load;       // Груз, шаги
+    double load_speed;
+    double residual;
+    double peak;
+};
+
+static Axis axes[2];
+static double omega = 2 * M_PI * 40;
+static double damping = 0.05;
+static bool series = false;
+static uint64_t model_ns = 0;
+static uint64_t next_series_ns = 0;
+
+static void usage() {
+    fprintf(stderr, "usage: shapecheck [-f hz] [-z damping] [-t] file.gcode\n");
+    exit(2);
+}
+
+// Груз догоняет ось: y'' = w^2 (x - y) - 2 z w y'
+static void integrate(uint64_t to_ns) {
+    while (model_ns + (uint64_t)(DT_S * 1e9) <= to_ns) {
+        model_ns += (uint64_t)(DT_S * 1e9);
+        for (int i = 0; i < 2; i++) {
+            Axis& a = axes[i];
+            a.load_speed += (omega * omega * (a.position - a.load) - 2 * damping * omega * a.load_speed) * DT_S;
+            a.load += a.load_speed * DT_S;
+            double deviation = fabs(a.load - a.position);
+            if (deviation > a.peak) a.peak = deviation;
+            if (a.steps > 0 && model_ns - a.last_step_ns > STOPPED_NS && deviation > a.residual) {
+                a.residual = deviation;
+            }
+        }
+        if (series && model_ns >= next_series_ns) {
+            next_series_ns += 1000000ULL;
+            printf("%.0f\t%ld\t%.2f\t%ld\t%.2f\n", model_ns / 1e6,
+                axes[0].position, axes[0].load, axes[1].position, axes[1].load);
+        }
+    }
+}
+
+// Фронты с пинов - в модель, концевики - по позиции
+static void machineLoop() {
+    const std::vector<SimEdge>& trace = simTrace();
+    for (size_t e = 0; e < trace.size(); e++) {
+        const SimEdge& edge = trace[e];
+        integrate(edge.time_ns);
+        for (int i = 0; i < 2; i++) {
+            Axis& a = axes[i];
+            if (edge.pin == PIN_DIR[i]) a.dir = edge.level;
+            if (edge.pin == PIN_PUL[i] && edge.level == HIGH) {
+                a.position += a.dir ? 1 : -1;
+                a.steps++;
+                a.last_step_ns = edge.time_ns;
+            }
+        }
+    }
+    simClearTrace();
+    integrate(simNanos());
+    for (int i = 0; i < 2; i++) {
+        simSetInput(PIN_ENDSTOP[i], axes[i].position <= SWITCH_AT ? LOW : -1);
+    }
+    loop();
+}
+
+static bool idle() {
+    return !Planner::isBusy() && !StepEngine::lineBusy() && !AxisGroup::isBusy();
+}
+
+static bool homed() {
+    return idle() && simSerialOutput().find("ok") != std::string::npos;
+}
+
+// Строка передаётся, когда на предыдущую пришёл ответ
+static bool answered() {
+    std::string out = simSerialOutput();
+    return out.find("ok") != std::string::npos || out.find("error:") != std::string::npos;
+}
+
+int main(int argc, char** argv) {
+    const char* path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0) {
+            series = true;
+        } else if ((strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "-z") == 0) && i + 1 < argc) {
+            double value = atof(argv[i + 1]);
+            if (argv[i][1] == 'f') omega = 2 * M_PI * value;
+            else damping = value;
+            i++;
+        } else if (path == NULL) {
+            path = argv[i];
+        } else {
+            usage();
+        }
+    }
+    if (path == NULL || omega <= 0 || damping < 0 || damping >= 1) {
+        usage();
+    }
+    FILE* input = fopen(path, "r");
+    if (input == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    simReset();
+    setup();
+    simSerialClearOutput();
+    simSerialInput("G28\n");
+    simRun(machineLoop, 60000000UL, 100, homed);
+    if (simSerialOutput().find("ok") == std::string::npos) {
+        fprintf(stderr, "shapecheck: калибровка не завершилась\n");
+        return 1;
+    }
+    simSerialClearOutput();
+    uint64_t start_ns = simNanos();
+    for (int i = 0; i < 2; i++) {
+        axes[i].steps = 0;
+        axes[i].last_step_ns = 0;
+        axes[i].residual = 0;
+        axes[i].peak = 0;
+    }
+
+    char line[256];
+    long number = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), input) != NULL) {
+        number++;
+        size_t length = strlen(line);
+        if (length == 0 || line[length - 1] != '\n') {
+            if (length + 1 < sizeof(line)) {
+                line[length++] = '\n';
+                line[length] = '\0';
+            }
+        }
+        simSerialInput(line);
+        simRun(machineLoop, 60000000UL, 100, answered);
+        std::string out = simSerialOutput();
+        if (out.find("error:") != std::string::npos) {
+            fprintf(stderr, "shapecheck: строка %ld: %s", number, out.c_str());
+            ok = false;
+        }
+        simSerialClearOutput();
+    }
+    fclose(input);
+    simRun(machineLoop, 600000000UL, 100, idle);
+    uint64_t done_ns = start_ns;
+    for (int i = 0; i < 2; i++) {
+        if (axes[i].last_step_ns > done_ns) done_ns = axes[i].last_step_ns;
+    }
+    simRun(machineLoop, SETTLE_US, 100);
+
+    for (int i = 0; i < 2; i++) {
+        printf("%c\tresidual_steps\t%.3f\n", LETTER[i], axes[i].residual);
+        printf("%c\tpeak_steps\t%.3f\n", LETTER[i], axes[i].peak);
+        printf("%c\tsteps\t%ld\n", LETTER[i], axes[i].steps);
+    }
+    printf("all\ttime_ms\t%.1f\n", (done_ns - start_ns) / 1e6);
+    return ok ? 0 : 1;
+}